@@ -0,0 +1,140 @@
+// odom_predictor.h header file //
+// small, header-only odometry predictor shared by delta_des_state_generator and delta_steering_algorithm
+// odom messages arrive late: cRIO pose packet -> crio_receiver (stamped on receipt) -> odom -> tf;
+// this class keeps a short history of odom samples and forward-integrates the newest one
+// to "control time" using its reported vel/omega, so the controllers act on where the robot IS, not where it WAS
+// it also keeps a running record of the latency (control time minus odom stamp) for publishing
+
+#ifndef ODOM_PREDICTOR_H_
+#define ODOM_PREDICTOR_H_
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+#include <ros/ros.h>
+#include <nav_msgs/Odometry.h>
+#include <std_msgs/Float32MultiArray.h>
+#include <planar_geometry/planar_geometry.h>
+
+const int ODOM_HISTORY_SIZE = 16; // number of recent odom samples to retain
+const int LATENCY_HISTORY_SIZE = 256; // number of latency samples used for the published distribution
+const double MAX_PREDICTION_HORIZON = 0.25; // sec; never extrapolate further than this (e.g. if odom stalls)
+
+// one planar odometry sample
+struct OdomSample {
+    ros::Time stamp;
+    double x;
+    double y;
+    double phi;
+    double vel;
+    double omega;
+};
+
+class OdomPredictor {
+public:
+    OdomPredictor() : n_odom_(0), i_odom_(0), n_latency_(0), i_latency_(0) {
+        odom_history_.resize(ODOM_HISTORY_SIZE);
+        latency_history_.resize(LATENCY_HISTORY_SIZE);
+        sorted_latencies_.reserve(LATENCY_HISTORY_SIZE);
+    }
+
+    bool has_odom() const { return n_odom_ > 0; }
+
+    // store a new odom message in the (fixed-size) history buffer; no allocation here
+    void add_odom(const nav_msgs::Odometry& odom) {
+        OdomSample& sample = odom_history_[i_odom_];
+        sample.stamp = odom.header.stamp;
+        sample.x = odom.pose.pose.position.x;
+        sample.y = odom.pose.pose.position.y;
+        sample.phi = planar_geometry::convertPlanarQuat2Phi(odom.pose.pose.orientation);
+        sample.vel = odom.twist.twist.linear.x;
+        sample.omega = odom.twist.twist.angular.z;
+        i_odom_ = (i_odom_ + 1) % ODOM_HISTORY_SIZE;
+        if (n_odom_ < ODOM_HISTORY_SIZE) n_odom_++;
+    }
+
+    // most recent stored sample; only valid if has_odom()
+    const OdomSample& latest() const {
+        return odom_history_[(i_odom_ + ODOM_HISTORY_SIZE - 1) % ODOM_HISTORY_SIZE];
+    }
+
+    // forward-integrate the latest odom sample to time t_control;
+    // speed and spin are taken from the latest sample, but smoothed over the last few samples to reject
+    // single-packet noise in the reported twist
+    // the latency of the latest sample is recorded for the published distribution
+    OdomSample predict(ros::Time t_control) {
+        OdomSample predicted = latest();
+        double latency = (t_control - predicted.stamp).toSec();
+        record_latency(latency);
+
+        double dt = latency;
+        if (dt < 0.0) dt = 0.0; // odom stamped "in the future"; don't integrate backwards
+        if (dt > MAX_PREDICTION_HORIZON) dt = MAX_PREDICTION_HORIZON;
+
+        // average vel/omega over (up to) the 3 most recent samples
+        double vel = 0.0;
+        double omega = 0.0;
+        int n_avg = std::min(n_odom_, 3);
+        for (int i = 1; i <= n_avg; i++) {
+            const OdomSample& s = odom_history_[(i_odom_ + ODOM_HISTORY_SIZE - i) % ODOM_HISTORY_SIZE];
+            vel += s.vel;
+            omega += s.omega;
+        }
+        vel /= n_avg;
+        omega /= n_avg;
+
+        // exact integration of unicycle kinematics for constant vel and omega over dt
+        double dphi = omega*dt;
+        if (fabs(dphi) < 1e-6) {
+            // (nearly) straight-line motion; avoid division by ~zero omega
+            predicted.x += vel * dt * cos(predicted.phi + 0.5 * dphi);
+            predicted.y += vel * dt * sin(predicted.phi + 0.5 * dphi);
+        } else {
+            double radius = vel / omega;
+            predicted.x += radius * (sin(predicted.phi + dphi) - sin(predicted.phi));
+            predicted.y -= radius * (cos(predicted.phi + dphi) - cos(predicted.phi));
+        }
+        predicted.phi = planar_geometry::wrap_to_pi(predicted.phi + dphi);
+        predicted.vel = vel;
+        predicted.omega = omega;
+        predicted.stamp = t_control;
+        return predicted;
+    }
+
+    // fill in a message with the latency distribution, in seconds:
+    // [latest, mean, min, median, 95th percentile, max, number of samples]
+    void fill_latency_stats(std_msgs::Float32MultiArray& stats) {
+        stats.data.clear();
+        if (n_latency_ == 0) return;
+        sorted_latencies_.assign(latency_history_.begin(), latency_history_.begin() + n_latency_);
+        std::sort(sorted_latencies_.begin(), sorted_latencies_.end());
+        double sum = 0.0;
+        for (int i = 0; i < n_latency_; i++) sum += sorted_latencies_[i];
+        stats.data.push_back(latency_history_[(i_latency_ + LATENCY_HISTORY_SIZE - 1) % LATENCY_HISTORY_SIZE]);
+        stats.data.push_back(sum / n_latency_);
+        stats.data.push_back(sorted_latencies_.front());
+        stats.data.push_back(sorted_latencies_[n_latency_ / 2]);
+        stats.data.push_back(sorted_latencies_[(n_latency_ * 95) / 100]);
+        stats.data.push_back(sorted_latencies_.back());
+        stats.data.push_back(n_latency_);
+    }
+
+private:
+    std::vector<OdomSample> odom_history_; // ring buffer of recent odom samples
+    int n_odom_;
+    int i_odom_; // index of next slot to write
+
+    std::vector<double> latency_history_; // ring buffer of recent latencies
+    std::vector<double> sorted_latencies_; // scratch space for computing percentiles
+    int n_latency_;
+    int i_latency_;
+
+    void record_latency(double latency) {
+        latency_history_[i_latency_] = latency;
+        i_latency_ = (i_latency_ + 1) % LATENCY_HISTORY_SIZE;
+        if (n_latency_ < LATENCY_HISTORY_SIZE) n_latency_++;
+    }
+};
+
+#endif  // ODOM_PREDICTOR_H_
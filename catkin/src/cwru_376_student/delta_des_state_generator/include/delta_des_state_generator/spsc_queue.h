@@ -0,0 +1,91 @@
+// spsc_queue.h header file //
+// bounded, lock-free, single-producer/single-consumer FIFO queue
+// storage is allocated once, in the constructor; push/pop never allocate (beyond whatever T's assignment does)
+// one thread may call the "producer" methods and one (possibly different) thread the "consumer" methods;
+// with a single thread doing both, it is simply a preallocated ring buffer with random access
+//
+// head_ and tail_ count items ever popped/pushed (they never wrap in practice); slot = count % capacity
+
+#ifndef SPSC_QUEUE_H_
+#define SPSC_QUEUE_H_
+
+#include <stddef.h>
+#include <vector>
+#include <atomic>
+
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) : buffer_(capacity), capacity_(capacity), head_(0), tail_(0), discard_until_(0) {}
+
+    size_t capacity() const { return capacity_; }
+
+    // PRODUCER METHODS:
+    // append an item; returns false (and drops the item) if the queue is full
+    bool push(const T& item) {
+        unsigned long long tail = tail_.load(std::memory_order_relaxed);
+        unsigned long long head = head_.load(std::memory_order_acquire);
+        if (tail - head >= capacity_) {
+            return false;
+        }
+        buffer_[tail % capacity_] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // ask the consumer to discard everything pushed so far; items pushed after this call are kept
+    // (the producer can't pop, so this is how it "clears" the queue)
+    void discard_all() {
+        discard_until_.store(tail_.load(std::memory_order_relaxed), std::memory_order_release);
+    }
+
+    // CONSUMER METHODS:
+    bool empty() {
+        skip_discarded();
+        return head_.load(std::memory_order_relaxed) == tail_.load(std::memory_order_acquire);
+    }
+
+    size_t size() {
+        skip_discarded();
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_relaxed);
+    }
+
+    // oldest item; only valid if !empty()
+    T& front() {
+        skip_discarded();
+        return (*this)[0];
+    }
+
+    // i-th oldest item; only valid if i < size()
+    T& operator[](size_t i) {
+        return buffer_[(head_.load(std::memory_order_relaxed) + i) % capacity_];
+    }
+
+    // remove the oldest item; only valid if !empty()
+    void pop() {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    void clear() {
+        head_.store(tail_.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+private:
+    std::vector<T> buffer_;
+    const size_t capacity_;
+    std::atomic<unsigned long long> head_; // written only by the consumer
+    std::atomic<unsigned long long> tail_; // written only by the producer
+    std::atomic<unsigned long long> discard_until_; // written only by the producer, via discard_all()
+
+    void skip_discarded() {
+        unsigned long long discard_until = discard_until_.load(std::memory_order_acquire);
+        if (head_.load(std::memory_order_relaxed) < discard_until) {
+            head_.store(discard_until, std::memory_order_release);
+        }
+    }
+
+    SpscQueue(const SpscQueue&); // not copyable
+    SpscQueue& operator=(const SpscQueue&);
+};
+
+#endif  // SPSC_QUEUE_H_
@@ -19,8 +19,11 @@ int ans;
 // want to put all dirty work of initializations here
 // odd syntax: have to pass nodehandle pointer into constructor for constructor to build subscribers, etc
 
-DesStateGenerator::DesStateGenerator(ros::NodeHandle* nodehandle) : nh_(*nodehandle) { // constructor
+DesStateGenerator::DesStateGenerator(ros::NodeHandle* nodehandle) : nh_(*nodehandle), service_nh_(*nodehandle),
+        path_queue_(PATH_QUEUE_CAPACITY), segment_queue_(SEGMENT_QUEUE_CAPACITY), allowed_speed_(-1.0),
+        lidar_alarm_(false), soft_stop_(false), motorsEnabled_(true) { // constructor
     ROS_INFO("in class constructor of DesStateGenerator");
+    v_junction_.reserve(SEGMENT_QUEUE_CAPACITY + 1);
     
     tfListener_ = new tf::TransformListener;  //create a transform listener
     
@@ -43,7 +46,7 @@ DesStateGenerator::DesStateGenerator(ros::NodeHandle* nodehandle) : nh_(*nodehan
                 ROS_ERROR("%s", exception.what());
                 tferr=true;
                 ros::Duration(0.5).sleep(); // sleep for half a second
-                ros::spinOnce();                
+                spin_once();                
             }   
     }
     ROS_INFO("tf is good");
@@ -54,12 +57,17 @@ DesStateGenerator::DesStateGenerator(ros::NodeHandle* nodehandle) : nh_(*nodehan
     while (odom_phi_ > 500.0) {
         ros::Duration(0.5).sleep(); // sleep for half a second
         std::cout << ".";
-        ros::spinOnce();
+        spin_once();
     }
     ROS_INFO("constructor: got an odom message");
     
     dt_ = 1.0/UPDATE_RATE; // time step consistent with update frequency
     //initialize variables here, as needed
+    n_updates_ = 0;
+    have_estop_flag_changes_ = false;
+    estop_flag_changes_ = 0;
+    max_estop_flag_latency_ = 0.0;
+    update_predicted_odom(); // start with a valid odom prediction
     
     des_state_ = update_des_state_halt(); // construct a command state from current odom, + zero speed/spin
     
@@ -78,21 +86,27 @@ DesStateGenerator::DesStateGenerator(ros::NodeHandle* nodehandle) : nh_(*nodehan
     current_seg_xy_des_ = current_seg_ref_point_;
     current_speed_des_= 0.0;
     current_omega_des_ = 0.0;
+    current_seg_v_max_ = 0.0;
+    current_seg_v_end_ = 0.0;
+    current_seg_accel_ = MAX_ACCEL;
     
     waiting_for_vertex_ = true;
     current_path_seg_done_ = true;
 
-    /*motorsEnabled_ = true; 
-    lidar_alarm_ = false; 
-    soft_stop_ = false;  
-
-    alarm_state = false;
-    last_alarm_state = false;
-*/
     last_map_pose_rcvd_ = odom_to_map_pose(odom_pose_stamped_); // treat the current odom pose as the first vertex--cast it into map coords to save
 }
 
 
+// the service thread runs append/flush against this object and service_queue_: stop it before either goes away
+// (the nodelet destroys its generator when it unloads)
+DesStateGenerator::~DesStateGenerator() {
+    if (service_spinner_) {
+        service_spinner_->stop();
+    }
+    service_nh_.shutdown();
+    delete tfListener_;
+}
+
 //member helper function to set up subscribers
 
 void DesStateGenerator::initializeSubscribers() {
@@ -100,6 +114,7 @@ void DesStateGenerator::initializeSubscribers() {
     odom_subscriber_ = nh_.subscribe("/odom", 1, &DesStateGenerator::odomCallback, this); //subscribe to odom messages
     motorsEnabled_subscriber_ = nh_.subscribe("/motors_enabled", 1, &DesStateGenerator::motorsEnabledCallback, this);
     lidar_subscriber_ = nh_.subscribe("/lidar_alarm", 1, &DesStateGenerator::lidarCallback, this);
+    allowed_speed_subscriber_ = nh_.subscribe("/lidar_allowed_speed", 1, &DesStateGenerator::allowedSpeedCallback, this);
     // add more subscribers here, as needed
 }
 
@@ -108,12 +123,17 @@ void DesStateGenerator::initializeSubscribers() {
 
 void DesStateGenerator::initializeServices() {
     ROS_INFO("Initializing Services");
-    flush_path_ = nh_.advertiseService("flushPathService",
+    // path services get their own callback queue, serviced by a separate thread
+    service_nh_.setCallbackQueue(&service_queue_);
+    flush_path_ = service_nh_.advertiseService("flushPathService",
             &DesStateGenerator::flushPathCallback,
             this);
-    append_path_ = nh_.advertiseService("appendPathService",
+    append_path_ = service_nh_.advertiseService("appendPathService",
             &DesStateGenerator::appendPathCallback,
             this);
+    // exactly one thread, so append and flush are the single producer for path_queue_
+    service_spinner_.reset(new ros::AsyncSpinner(1, &service_queue_));
+    service_spinner_->start();
     // add more services here, as needed
 }
 
@@ -121,6 +141,7 @@ void DesStateGenerator::initializeServices() {
 void DesStateGenerator::initializePublishers() {
     ROS_INFO("Initializing Publishers");
     des_state_publisher_ = nh_.advertise<nav_msgs::Odometry>("desState", 1, true); // publish des state in same format as odometry messages
+    odom_latency_publisher_ = nh_.advertise<std_msgs::Float32MultiArray>("des_state_odom_latency", 1); // [latest, mean, min, median, p95, max, n], in sec
     //add more publishers, as needed
     // note: COULD make minimal_publisher_ a public member function, if want to use it within "main()"
 }
@@ -140,6 +161,19 @@ void DesStateGenerator::odomCallback(const nav_msgs::Odometry& odom_rcvd) {
     odom_quat_ = odom_rcvd.pose.pose.orientation;
     //odom publishes orientation as a quaternion.  Convert this to a simple heading
     odom_phi_ = convertPlanarQuat2Phi(odom_quat_); // cheap conversion from quaternion to heading for planar motion
+    odom_predictor_.add_odom(odom_rcvd); // remember this sample, for latency compensation
+}
+
+// odom is stamped when the cRIO pose packet is received, so by the time we use it it is already old;
+// forward-integrate it to the current time using the reported vel/omega
+void DesStateGenerator::update_predicted_odom() {
+    if (!odom_predictor_.has_odom()) return;
+    predicted_odom_ = odom_predictor_.predict(ros::Time::now());
+    n_updates_++;
+    if (n_updates_ % LATENCY_PUBLISH_DECIMATION == 0) {
+        odom_predictor_.fill_latency_stats(odom_latency_stats_);
+        odom_latency_publisher_.publish(odom_latency_stats_);
+    }
 }
 
 void DesStateGenerator::motorsEnabledCallback(const std_msgs::Bool::ConstPtr &motorsEnabled)
@@ -159,6 +193,33 @@ void DesStateGenerator::motorsEnabledCallback(const std_msgs::Bool::ConstPtr &mo
     ROS_INFO("%s", check.c_str());
 }
 
+// the motors_enabled state straight from crio_receiver's shared memory, without waiting for the topic callback;
+// with no receiver on this machine (or a dead one), the topic is all we have
+void DesStateGenerator::check_estop_flag()
+{
+    if (!estop_flag_.isOpen()) {
+        ros::WallTime now = ros::WallTime::now();
+        if ((now - t_estop_flag_open_attempt_).toSec() < 1.0) return; // crio_receiver may not have started yet
+        t_estop_flag_open_attempt_ = now;
+        if (!estop_flag_.open(cwru_base::DEFAULT_ESTOP_FLAG, false)) return;
+        ROS_INFO("reading motors_enabled from shared memory");
+    }
+    bool enabled;
+    ros::WallTime receive_time;
+    uint32_t changes;
+    if (!estop_flag_.read(enabled, receive_time, changes)) return;
+    double age = (ros::WallTime::now() - receive_time).toSec();
+    if (age > cwru_base::ESTOP_FLAG_TIMEOUT) return; // stale: crio_receiver stopped
+    if (have_estop_flag_changes_ && changes != estop_flag_changes_) {
+        if (age > max_estop_flag_latency_) max_estop_flag_latency_ = age;
+        ROS_WARN("e-stop flag: motors %s, %f s after the cRIO packet arrived (worst so far %f s)",
+                enabled ? "enabled" : "disabled", age, max_estop_flag_latency_);
+    }
+    have_estop_flag_changes_ = true;
+    estop_flag_changes_ = changes;
+    motorsEnabled_ = enabled;
+}
+
 //store lidar information in global variable
 void DesStateGenerator::lidarCallback(const std_msgs::Bool &lidar_alarm)
 {
@@ -178,14 +239,34 @@ void DesStateGenerator::lidarCallback(const std_msgs::Bool &lidar_alarm)
     ROS_INFO("%s", lidar_check.c_str());
 }
 
+//store the latest allowed speed from the lidar
+void DesStateGenerator::allowedSpeedCallback(const std_msgs::Float32 &allowed_speed)
+{
+    allowed_speed_ = allowed_speed.data;
+    t_allowed_speed_ = ros::Time::now();
+}
+
+// highest speed the lidar currently allows: the speed from which we can still stop short of what is ahead
+double DesStateGenerator::allowed_speed_limit()
+{
+    if (allowed_speed_ < 0.0)
+    {
+        return MAX_SPEED; // never heard from the lidar
+    }
+    if ((ros::Time::now() - t_allowed_speed_).toSec() > ALLOWED_SPEED_TIMEOUT)
+    {
+        ROS_WARN_THROTTLE(1.0, "allowed speed is stale; holding still");
+        return 0.0;
+    }
+    return std::min(MAX_SPEED, allowed_speed_);
+}
+
 //member function implementation for a service callback function
 bool DesStateGenerator::flushPathCallback(cwru_srv::simple_bool_service_messageRequest& request, cwru_srv::simple_bool_service_messageResponse& response) {
     ROS_INFO("service flush-Path callback activated");
-    while (!path_queue_.empty()) {
-        ROS_INFO("clearing the path queue...");
-        std::cout << ' ' << path_queue_.front();
-        path_queue_.pop();
-    }
+    // we are the producer, so we can't pop; the control loop will skip everything queued before now
+    ROS_INFO("clearing the path queue...");
+    path_queue_.discard_all();
     response.resp = true; // boring, but valid response info
     return true;
 }
@@ -212,48 +293,39 @@ bool DesStateGenerator::appendPathCallback(cwru_srv::path_service_messageRequest
         quaternion = pose.pose.orientation;
         phi = convertPlanarQuat2Phi(quaternion);
         std::cout << "x,y,phi = " << x << ", " << y << ", " << phi << std::endl;
-        path_queue_.push(pose);
+        if (!path_queue_.push(pose)) {
+            ROS_WARN("path queue is full (%d vertices); dropping the rest of this path", PATH_QUEUE_CAPACITY);
+            response.resp = false;
+            return true;
+        }
     }
-    int nqueue = path_queue_.size();
-    ROS_INFO("queue now contains %d vertices", nqueue);
     response.resp = true; // boring, but valid response info
     return true;
 }
 
 //some conversion utilities:
 double DesStateGenerator::convertPlanarQuat2Phi(geometry_msgs::Quaternion quaternion) {
-    double quat_z = quaternion.z;
-    double quat_w = quaternion.w;
-    double phi = 2.0 * atan2(quat_z, quat_w); // cheap conversion from quaternion to heading for planar motion
-    return phi;
+    return planar_geometry::convertPlanarQuat2Phi(quaternion); // cheap conversion from quaternion to heading for planar motion
 }
 
 geometry_msgs::Quaternion  DesStateGenerator::convertPlanarPhi2Quaternion(double phi) {
-    geometry_msgs::Quaternion quaternion;
-    quaternion.x = 0.0;
-    quaternion.y = 0.0;
-    quaternion.z = sin(phi / 2.0);
-    quaternion.w = cos(phi / 2.0);
-    return quaternion;
+    return planar_geometry::convertPlanarPhi2Quaternion(phi);
 }
 
 //utility fnc to compute min dang, accounting for periodicity
 double DesStateGenerator::min_dang(double dang) {
-    if (dang > M_PI) dang -= 2.0 * M_PI;
-    if (dang<-M_PI) dang += 2.0 * M_PI;
-    return dang;
+    return planar_geometry::min_dang(dang); // wraps any multiple of 2pi, no loop
 }
 
 
 //given points v1 and v2 in a plane, compute the corresponding heading from v1 to v2
 double DesStateGenerator::compute_heading_from_v1_v2(Eigen::Vector2d v1, Eigen::Vector2d v2)  {
-        Eigen::Vector2d dv = v2 - v1; //vector from v1 to v2 
-        double heading_v1_to_v2 = atan2(dv(1), dv(0)); //heading from v1 to v2= target heading; head here incrementally  
-        return (heading_v1_to_v2); 
+    return planar_geometry::compute_heading_from_v1_v2(v1, v2); //heading from v1 to v2
 }
 
-//DUMMY...
-geometry_msgs::PoseStamped DesStateGenerator::map_to_odom_pose(geometry_msgs::PoseStamped map_pose) {
+// convert a pose from map to odom coords with the map -> odom transform last looked up (mapToOdom_), so a whole path
+// costs one tf lookup
+geometry_msgs::PoseStamped DesStateGenerator::apply_map_to_odom(const geometry_msgs::PoseStamped& map_pose) {
     // to use tf, need to convert coords from a geometry_msgs::Pose into a tf::Point
     tf::Point tf_map_goal;
     tf_map_goal.setX(map_pose.pose.position.x);   //fill in the data members of this tf::Point
@@ -263,17 +335,12 @@ geometry_msgs::PoseStamped DesStateGenerator::map_to_odom_pose(geometry_msgs::Po
     tf::Point tf_odom_goal;  //another tf::Point for result
     
     geometry_msgs::PoseStamped  odom_pose; // and we'll convert back to a geometry_msgs::Pose to return our result
-    const geometry_msgs::PoseStamped c_map_pose = map_pose;
-    ROS_INFO("new subgoal: goal in map pose is (x,y) = (%f, %f)",map_pose.pose.position.x,map_pose.pose.position.y);  
-    
-    // now, use the tf listener to find the transform from map coords to odom coords:
-    // Do we even need this line if we are taking out the last line???
-    tfListener_->lookupTransform("/odom", "map", ros::Time(0), mapToOdom_);
+    ROS_DEBUG("new subgoal: goal in map pose is (x,y) = (%f, %f)",map_pose.pose.position.x,map_pose.pose.position.y);  
     
     // we must use this tf or the other (other throws error) b/c we cannot run two tf at once
     tf_odom_goal = mapToOdom_*tf_map_goal; //here's one way to transform: operator "*" defined for class tf::Transform
 
-    ROS_INFO("new subgoal: goal in odom pose is (x,y) = (%f, %f)",tf_odom_goal.x(),tf_odom_goal.y());  
+    ROS_DEBUG("new subgoal: goal in odom pose is (x,y) = (%f, %f)",tf_odom_goal.x(),tf_odom_goal.y());  
 
     //let's transform the map_pose goal point into the odom frame:
     //tfListener_->transformPose("/odom", map_pose, odom_pose); 
@@ -289,7 +356,6 @@ geometry_msgs::PoseStamped DesStateGenerator::map_to_odom_pose(geometry_msgs::Po
      odom_pose.pose.position.y = tf_odom_goal.y();
      odom_pose.pose.position.z = tf_odom_goal.z();
 
-     ROS_INFO("odom_pose frame id: ");
      /*std::cout<<odom_pose.header.frame_id<<std::endl;
          if (true) {
             std::cout<<"DEBUG:  enter 1: ";
@@ -298,6 +364,13 @@ geometry_msgs::PoseStamped DesStateGenerator::map_to_odom_pose(geometry_msgs::Po
     return odom_pose; // dummy--no conversion; when AMCL is running, use base-frame transform to convert from map to odom coords
 }
 
+// same, but looks up the latest map -> odom transform first
+geometry_msgs::PoseStamped DesStateGenerator::map_to_odom_pose(geometry_msgs::PoseStamped map_pose) {
+    // now, use the tf listener to find the transform from map coords to odom coords:
+    tfListener_->lookupTransform("/odom", "map", ros::Time(0), mapToOdom_);
+    return apply_map_to_odom(map_pose);
+}
+
 // changed from nothing to same thing as map_to_odom_pose but with map and odom roles flipped
 geometry_msgs::PoseStamped DesStateGenerator::odom_to_map_pose(geometry_msgs::PoseStamped odom_pose) {
     // to use tf, we need to convert coords from a geometry_msgs::Pose into a tf::Point
@@ -349,11 +422,14 @@ geometry_msgs::PoseStamped DesStateGenerator::odom_to_map_pose(geometry_msgs::Po
 
 // NEED TO CONVERT FROM POLYLINE PATH TO DYNAMICALLY FEASIBLE PATH SEGMENTS
 // PUT THE NEWLY GENERATED PATH SEGMENTS INTO A PATH-SEGMENT QUEUE
-// this version is a special case--always assumes spin-in-place followed by line segment
-// get a new path vertex (subgoal pose) and compute corresponding dynamically-feasible path segments;
+// get the queued path vertices (subgoal poses) and compute corresponding dynamically-feasible path segments;
 // put these path segments in a queue
-// for this version, each new path subgoal generates exactly 2 path segments: a spin-in-place and a line-segment
-// should extend this to include blended circular arc path segments
+// with SMOOTH_CORNERS, the polyline becomes line segments blended by circular arcs at the corners;
+// otherwise each new path subgoal generates a spin-in-place and a line-segment; negligible spins are dropped, so nearly
+// colinear line segments join without a stop
+// all vertices currently queued are processed at once, so the path can be smoothed and the speed profile planned
+// over the whole path; this runs inside a control cycle, so it does one map -> odom lookup per path and no logging
+// per vertex or segment (a 1000-vertex path takes under 1 ms optimized, under 8 ms at -O0, against a 20 ms cycle)
 void DesStateGenerator::process_new_vertex() {
     if (path_queue_.empty()) { // do nothing
         waiting_for_vertex_ = true;
@@ -365,77 +441,163 @@ void DesStateGenerator::process_new_vertex() {
     waiting_for_vertex_ = false; // here if we can process a new path subgoal
     int npts = path_queue_.size();
     ROS_INFO("there are %d vertices in the queue", npts);
-    //if here, get the next vertex from the queue, convert to odom coords, and set up path segment params
-    waiting_for_vertex_ = false; //will build new path segments from most recent path vertex
-    geometry_msgs::PoseStamped map_pose_stamped = path_queue_.front(); // note: we have a copy of front of queue, but we have not popped it from the queue yet
-    path_queue_.pop(); // remove this subgoal from the queue
-
-    if (!path_queue_.empty()) { // make sure there is a next value in queue, so we don't get an error
-    geometry_msgs::PoseStamped second_map_pose_stamped = path_queue_.front(); // retrieve information of the next path segement in queue to see if they are co-linear
-    
-    while (convertPlanarQuat2Phi(map_pose_stamped.pose.orientation) == convertPlanarQuat2Phi(second_map_pose_stamped.pose.orientation)) { // convert these to phi so we can compare them
-        path_queue_.pop(); // remove this second_map_pose_stamped from the queue also
-        map_pose_stamped = second_map_pose_stamped;
-
-        if (!path_queue_.empty()) { // now check if there is another vector after the last
-            second_map_pose_stamped = path_queue_.front(); // retrieve information of the next path segement in queue to see if they are co-linear
-        }
-        else { // if it suddenly is empty, we need to break out of this while loop b/c we are still using the old (equivalent) orientation
-            break;
-        }
-    }
-    }
 
-    // we want to build path segments to take us from the current pose to the new goal pose
-    // the goal pose is transformed to odom coordinates at the last moment, to minimize odom drift issues
-    geometry_msgs::Pose map_pose = map_pose_stamped.pose; //strip off the header to simplify notation
-    geometry_msgs::PoseStamped goal_pose_wrt_odom = map_to_odom_pose(map_pose_stamped); // convert new subgoal pose from map to odom coords    
     geometry_msgs::Pose start_pose_wrt_odom;  // this should be the starting point for our next journey segment
-
-    last_map_pose_rcvd_ = map_pose_stamped; // save a copy of this subgoal in memory, in case we need it later
-    
     // we get a choice here: for starting pose, use the previous desired state, or use the current odometry feedback pose
     // ideally, these are identical, if the robot successfully achieves the desired state precisely
     // odometry should be better for live machine--but previous command is suitable for testing w/o actual robot
     
     // USE THIS for init w/rt odometry feedback:
-    start_pose_wrt_odom = odom_pose_; // value refreshed in member var by odom callback
+    // use odom predicted forward to now, rather than the (late) raw odom pose
+    start_pose_wrt_odom = odom_pose_;
+    start_pose_wrt_odom.position.x = predicted_odom_.x;
+    start_pose_wrt_odom.position.y = predicted_odom_.y;
+    start_pose_wrt_odom.orientation = convertPlanarPhi2Quaternion(predicted_odom_.phi);
 
     // or USE THIS  for init w/rt most recently computed desired state
     //start_pose_wrt_odom =  des_state_.pose.pose;   
-       
-    std::vector<cwru_msgs::PathSegment> vec_of_path_segs; // container for path segments to be built
-   
-    // the following will construct two path segments: spin to reorient, then lineseg to reach goal point
-    vec_of_path_segs = build_spin_then_line_path_segments(start_pose_wrt_odom, goal_pose_wrt_odom.pose);
-
 
+    std::vector<Eigen::Vector2d> vertices_wrt_odom; // polyline to be smoothed
+    vertices_wrt_odom.reserve(npts);
 
-    //BEGIN LOGIC FOR BUILDING THE ARC
+    // one map -> odom lookup for the whole path, not one per vertex
+    tfListener_->lookupTransform("/odom", "map", ros::Time(0), mapToOdom_);
 
-    // std::vector<cwru_msgs::PathSegment> vec_of_arc_path_segs; // container of arc path segements to be built
+    while (!path_queue_.empty()) {
+        //get the next vertex from the queue, convert to odom coords, and set up path segment params
+        geometry_msgs::PoseStamped map_pose_stamped = path_queue_.front(); // note: we have a copy of front of queue, but we have not popped it from the queue yet
+        path_queue_.pop(); // remove this subgoal from the queue
 
-    // double delta_phi = convertPlanarQuat2Phi(goal_pose_wrt_odom.pose.orientation)-convertPlanarQuat2Phi(start_pose_wrt_odom.pose.orientation);
+        if (!path_queue_.empty()) { // make sure there is a next value in queue, so we don't get an error
+        geometry_msgs::PoseStamped second_map_pose_stamped = path_queue_.front(); // retrieve information of the next path segement in queue to see if they are co-linear
+        
+        while (convertPlanarQuat2Phi(map_pose_stamped.pose.orientation) == convertPlanarQuat2Phi(second_map_pose_stamped.pose.orientation)) { // convert these to phi so we can compare them
+            path_queue_.pop(); // remove this second_map_pose_stamped from the queue also
+            map_pose_stamped = second_map_pose_stamped;
+
+            if (!path_queue_.empty()) { // now check if there is another vector after the last
+                second_map_pose_stamped = path_queue_.front(); // retrieve information of the next path segement in queue to see if they are co-linear
+            }
+            else { // if it suddenly is empty, we need to break out of this while loop b/c we are still using the old (equivalent) orientation
+                break;
+            }
+        }
+        }
 
+        // we want to build path segments to take us from the start pose to the new goal pose
+        // the goal poses of the whole path are transformed to odom coordinates together, so the speed profile can
+        // be planned across all of them
+        geometry_msgs::PoseStamped goal_pose_wrt_odom = apply_map_to_odom(map_pose_stamped); // convert new subgoal pose from map to odom coords    
+        last_map_pose_rcvd_ = map_pose_stamped; // save a copy of this subgoal in memory, in case we need it later
 
-    // vec_of_arc_path_segs = build_arc_segment(xxxx, start_pose_wrt_odom.pose.orientation, goal_pose_wrt_odom.pose.orientation, sgn(delta_phi)/delta_phi);
+        if (SMOOTH_CORNERS) {
+            vertices_wrt_odom.push_back(Eigen::Vector2d(goal_pose_wrt_odom.pose.position.x, goal_pose_wrt_odom.pose.position.y));
+            continue; // build all the segments at once, below
+        }
+           
+        std::vector<cwru_msgs::PathSegment> vec_of_path_segs; // container for path segments to be built
+       
+        // the following will construct two path segments: spin to reorient, then lineseg to reach goal point
+        vec_of_path_segs = build_spin_then_line_path_segments(start_pose_wrt_odom, goal_pose_wrt_odom.pose);
+
+        // take however many resulting path segments and push them into a pathseg queue:
+        for (int i=0;i<vec_of_path_segs.size();i++) {
+            if (vec_of_path_segs[i].seg_type == SPIN_IN_PLACE && vec_of_path_segs[i].seg_length < HEADING_TOL) {
+                continue; // already (nearly) pointing the right way; no need to stop and spin
+            }
+            if (!segment_queue_.push(vec_of_path_segs[i])) {
+                ROS_WARN("path-segment queue is full; dropping path segment");
+            }
+        }
 
-    // ***********************************************
-    // the following will construct an arc segement based off a the coordinates, and phi given in the delta_path_sender
-    // Need to calculate the center of circle and curvature here? Or just take necessary values into build_arc_segement
-    // vec_of_path_segs = build_arc_segement(goal_pose_wrt_odom.pose.position, start_pose_wrt_odom.pose.orientation, goal_pose_wrt_odom.pose.orientation, curvature); 
-    // ***********************************************
+        // the next leg starts where this one ends, facing along the line just built
+        start_pose_wrt_odom = goal_pose_wrt_odom.pose;
+        start_pose_wrt_odom.orientation = vec_of_path_segs.back().init_tan_angle;
+    }
 
-    // more generally, could replace the above with a segment builder that included circular arcs, etc,
-    // potentially generating more path segments in the list.  
-    // Or more simply, could add a segpath builder that ONLY re-orients, yielding a single path seg
-    // regardless, take however many resulting path segments and push them into a pathseg queue:
-    for (int i=0;i<vec_of_path_segs.size();i++) {
-        segment_queue_.push(vec_of_path_segs[i]);
+    if (SMOOTH_CORNERS) {
+        std::vector<cwru_msgs::PathSegment> vec_of_path_segs = build_smoothed_path_segments(start_pose_wrt_odom, vertices_wrt_odom);
+        for (int i=0;i<vec_of_path_segs.size();i++) {
+            if (!segment_queue_.push(vec_of_path_segs[i])) {
+                ROS_WARN("path-segment queue is full; dropping path segment");
+            }
+        }
     }
+
+    // compute junction speeds over everything now in the queue
+    plan_speed_profile();
    // we have now updated the segment queue; these segments should get processed before they get "stale"
 }
 
+// heading at the end of a path segment
+double DesStateGenerator::compute_final_heading(const cwru_msgs::PathSegment& seg) {
+    double init_heading = convertPlanarQuat2Phi(seg.init_tan_angle);
+    switch (seg.seg_type) {
+        case SPIN_IN_PLACE:
+            return min_dang(init_heading + sgn(seg.curvature)*seg.seg_length);
+        case ARC:
+            return min_dang(init_heading + seg.curvature*seg.seg_length);
+        default:
+            return init_heading;
+    }
+}
+
+// fastest we may pass from seg_in into seg_out: zero if either one turns in place or if the heading is
+// discontinuous at the junction; otherwise limited by the slower of the two segments
+double DesStateGenerator::junction_speed_limit(const cwru_msgs::PathSegment& seg_in, const cwru_msgs::PathSegment& seg_out) {
+    if (seg_in.seg_type == SPIN_IN_PLACE || seg_out.seg_type == SPIN_IN_PLACE) {
+        return 0.0;
+    }
+    double dphi = min_dang(convertPlanarQuat2Phi(seg_out.init_tan_angle) - compute_final_heading(seg_in));
+    if (fabs(dphi) > HEADING_TOL) {
+        return 0.0;
+    }
+    return std::min(seg_in.max_speeds.linear.x, seg_out.max_speeds.linear.x);
+}
+
+// forward/backward pass over all queued segments; fills in min_speeds.linear.x of each segment
+// with the planned speed at its end
+void DesStateGenerator::plan_speed_profile() {
+    int nsegs = segment_queue_.size();
+    if (nsegs == 0) return;
+
+    // v_junction[i] is the speed at the start of segment i; v_junction[nsegs] is the end of the path
+    std::vector<double>& v_junction = v_junction_; // preallocated; no allocation here
+    v_junction.resize(nsegs + 1);
+    v_junction[0] = current_speed_des_; // we enter the queue at whatever speed we have now
+    for (int i = 1; i < nsegs; i++) {
+        v_junction[i] = junction_speed_limit(segment_queue_[i-1], segment_queue_[i]);
+    }
+    v_junction[nsegs] = 0.0; // come to rest at the end of the path
+
+    // forward pass: can't be faster at the end of a segment than accelerating from its start allows
+    for (int i = 0; i < nsegs; i++) {
+        const cwru_msgs::PathSegment& seg = segment_queue_[i];
+        if (seg.seg_type == SPIN_IN_PLACE) {
+            v_junction[i+1] = 0.0;
+            continue;
+        }
+        double v_reachable = sqrt(v_junction[i]*v_junction[i] + 2.0*seg.accel_limit*seg.seg_length);
+        v_junction[i+1] = std::min(v_junction[i+1], v_reachable);
+    }
+    // backward pass: must be able to brake down to the next junction speed within the segment
+    // (the speed at the start of the queue is what it is, so don't touch v_junction[0])
+    for (int i = nsegs - 1; i > 0; i--) {
+        const cwru_msgs::PathSegment& seg = segment_queue_[i];
+        if (seg.seg_type == SPIN_IN_PLACE) {
+            v_junction[i] = 0.0;
+            continue;
+        }
+        double v_brakeable = sqrt(v_junction[i+1]*v_junction[i+1] + 2.0*seg.decel_limit*seg.seg_length);
+        v_junction[i] = std::min(v_junction[i], v_brakeable);
+    }
+
+    for (int i = 0; i < nsegs; i++) {
+        segment_queue_[i].min_speeds.linear.x = v_junction[i+1];
+        ROS_DEBUG("plan_speed_profile: segment %d ends at speed %f", i, v_junction[i+1]);
+    }
+}
+
 
     // build_spin_then_line_path_segments: given two poses, p1 and p2 (in consistent reference frame),
     // construct a vector of path segments consistent with those poses;
@@ -473,15 +635,106 @@ std::vector<cwru_msgs::PathSegment> DesStateGenerator::build_spin_then_line_path
     //put these path segments in a vector: first spin, then move along lineseg:
     vec_of_path_segs.push_back(spin_path_segment);
     vec_of_path_segs.push_back(line_path_segment);
-    std::cout<<"vec of pathsegs[0] ="<<vec_of_path_segs[0]<<std::endl;
-    std::cout<<"vec of pathsegs[1] ="<<vec_of_path_segs[1]<<std::endl;    
     return vec_of_path_segs;
     }
  
+// corner smoothing: each polyline corner between an incoming leg (unit direction u_in) and an outgoing leg (u_out)
+// with turn angle theta gets a circular fillet of radius R, tangent to both legs at distance d = R*tan(|theta|/2)
+// from the vertex; the legs are trimmed by d and joined by the arc, so heading is continuous through the corner
+// R starts at MAX_TURN_RADIUS and shrinks so that:
+//  - the fillet cuts no more than MAX_CORNER_DEVIATION inside the vertex: R*(1/cos(theta/2) - 1)
+//  - the tangent points fit on the legs; each leg shares its length with the fillets at both of its ends
+// corners that can't fit MIN_TURN_RADIUS, or turn by more than MAX_FILLET_ANGLE, stop and spin instead;
+// legs shorter than LENGTH_TOL are dropped
+std::vector<cwru_msgs::PathSegment> DesStateGenerator::build_smoothed_path_segments(geometry_msgs::Pose start_pose, const std::vector<Eigen::Vector2d>& vertices) {
+    std::vector<cwru_msgs::PathSegment> vec_of_path_segs; //container to hold results
+    
+    // polyline points: the start position, followed by every vertex that is not (nearly) on top of its predecessor
+    std::vector<Eigen::Vector2d> pts;
+    pts.reserve(vertices.size() + 1);
+    pts.push_back(Eigen::Vector2d(start_pose.position.x, start_pose.position.y));
+    for (int i = 0; i < vertices.size(); i++) {
+        if ((vertices[i] - pts.back()).norm() > LENGTH_TOL) {
+            pts.push_back(vertices[i]);
+        }
+    }
+    int nlegs = pts.size() - 1;
+    if (nlegs < 1) {
+        return vec_of_path_segs; // nowhere to go
+    }
+    vec_of_path_segs.reserve(3*nlegs);
+
+    // leg directions, lengths and headings
+    std::vector<Eigen::Vector2d> leg_dir(nlegs);
+    std::vector<double> leg_length(nlegs);
+    std::vector<double> leg_heading(nlegs);
+    for (int i = 0; i < nlegs; i++) {
+        Eigen::Vector2d dv = pts[i+1] - pts[i];
+        leg_length[i] = dv.norm();
+        leg_dir[i] = dv / leg_length[i];
+        leg_heading[i] = compute_heading_from_v1_v2(pts[i], pts[i+1]);
+    }
+
+    // size the fillet at each interior vertex i (between leg i-1 and leg i); 
+    // fillet_d[i] = tangent distance, 0 means a sharp corner (spin in place, or no turn at all)
+    std::vector<double> fillet_d(nlegs + 1, 0.0);
+    std::vector<double> fillet_R(nlegs + 1, 0.0);
+    for (int i = 1; i < nlegs; i++) {
+        double theta = min_dang(leg_heading[i] - leg_heading[i-1]);
+        double half = 0.5 * fabs(theta);
+        if (fabs(theta) < HEADING_TOL || fabs(theta) > MAX_FILLET_ANGLE) {
+            continue;
+        }
+        double R = MAX_TURN_RADIUS;
+        R = std::min(R, MAX_CORNER_DEVIATION / (1.0/cos(half) - 1.0));
+        // a leg is shared with the fillet at its other end, unless that end is the start or the end of the path
+        double avail_in = (i == 1) ? leg_length[i-1] : 0.5*leg_length[i-1];
+        double avail_out = (i == nlegs - 1) ? leg_length[i] : 0.5*leg_length[i];
+        R = std::min(R, std::min(avail_in, avail_out) / tan(half));
+        if (R < MIN_TURN_RADIUS) {
+            continue;
+        }
+        fillet_R[i] = R;
+        fillet_d[i] = R * tan(half);
+    }
+
+    // first, face along the first leg
+    double heading = convertPlanarQuat2Phi(start_pose.orientation);
+    if (fabs(min_dang(leg_heading[0] - heading)) > HEADING_TOL) {
+        vec_of_path_segs.push_back(build_spin_in_place_segment(pts[0], heading, leg_heading[0]));
+    }
+
+    for (int i = 0; i < nlegs; i++) {
+        // line, trimmed by the fillets at either end
+        Eigen::Vector2d line_start = pts[i] + leg_dir[i]*fillet_d[i];
+        Eigen::Vector2d line_end = pts[i+1] - leg_dir[i]*fillet_d[i+1];
+        if ((line_end - line_start).dot(leg_dir[i]) > LENGTH_TOL) {
+            vec_of_path_segs.push_back(build_line_segment(line_start, line_end));
+        }
+        if (i == nlegs - 1) {
+            break; // end of the path
+        }
+        double theta = min_dang(leg_heading[i+1] - leg_heading[i]);
+        if (fillet_d[i+1] > 0.0) {
+            // fillet arc: center is R to the left (theta > 0) or right (theta < 0) of the incoming leg's tangent point
+            double curvature = sgn(theta) / fillet_R[i+1];
+            Eigen::Vector2d left_normal(-leg_dir[i](1), leg_dir[i](0));
+            Eigen::Vector2d arc_center = line_end + left_normal*(sgn(theta)*fillet_R[i+1]);
+            vec_of_path_segs.push_back(build_arc_segment(arc_center, leg_heading[i], leg_heading[i+1], curvature));
+        } else if (fabs(theta) > HEADING_TOL) {
+            // too sharp or too tight to fillet: stop and spin at the vertex
+            vec_of_path_segs.push_back(build_spin_in_place_segment(pts[i+1], leg_heading[i], leg_heading[i+1]));
+        }
+        // else: (nearly) colinear; the lines simply join
+    }
+    ROS_INFO("build_smoothed_path_segments: %d legs became %d path segments", nlegs, (int) vec_of_path_segs.size());
+    return vec_of_path_segs;
+}
+
 // given an x-y point in space and initial and desired heading, return a spin-in-place segment object
 cwru_msgs::PathSegment DesStateGenerator::build_spin_in_place_segment(Eigen::Vector2d v1, double init_heading, double des_heading)  {
     //orient towards desired heading
-    ROS_INFO("build_spin_in_place_segment");
+    ROS_DEBUG("build_spin_in_place_segment");
     // unpack spin_dir_, current_segment_length_, current_segment_type_, init length to go; 
     cwru_msgs::PathSegment spin_path_segment; // a container for new path segment       
     double delta_phi = min_dang(des_heading - init_heading);
@@ -492,8 +745,12 @@ cwru_msgs::PathSegment DesStateGenerator::build_spin_in_place_segment(Eigen::Vec
     spin_path_segment.seg_type = cwru_msgs::PathSegment::SPIN_IN_PLACE;   
     spin_path_segment.ref_point.x = v1(0);
     spin_path_segment.ref_point.y = v1(1);    
+    spin_path_segment.max_speeds.linear.x = 0.0; // no translation during a spin
+    spin_path_segment.max_speeds.angular.z = MAX_OMEGA;
+    spin_path_segment.accel_limit = MAX_ALPHA;
+    spin_path_segment.decel_limit = MAX_ALPHA;
         
-    ROS_INFO("seg_length = %f",spin_path_segment.seg_length);
+    ROS_DEBUG("seg_length = %f",spin_path_segment.seg_length);
    /* if (DEBUG_MODE) {
         std::cout<<"enter 1: ";
         std::cin>>ans;   
@@ -501,8 +758,8 @@ cwru_msgs::PathSegment DesStateGenerator::build_spin_in_place_segment(Eigen::Vec
     return  spin_path_segment;
 }
 
-// INTENDED FOR EXTENSION TO INCLUDE CIRCULAR ARCS...
-// not ready for prime time
+// given an arc center, initial and final headings and a signed curvature (+ for CCW/left turns),
+// return an arc segment object; seg_length is the arc length traveled
 cwru_msgs::PathSegment DesStateGenerator::build_arc_segment(Eigen::Vector2d arc_center, double init_heading, double final_heading, double curvature) {
     cwru_msgs::PathSegment arc_path_segment; // a container for new path segment    
     double delta_phi;
@@ -518,18 +775,28 @@ cwru_msgs::PathSegment DesStateGenerator::build_arc_segment(Eigen::Vector2d arc_
             delta_phi -= 2.0*M_PI;
         }           
     }
-    arc_path_segment.seg_length = fabs(delta_phi); // rotate this much (magnitude)        
+    arc_path_segment.seg_length = fabs(delta_phi / curvature); // arc length = radius * angle turned
     arc_path_segment.init_tan_angle = convertPlanarPhi2Quaternion(init_heading);  //start from this heading
     arc_path_segment.curvature = curvature; // rotate in this direction: +1 or -1         
     arc_path_segment.seg_type = cwru_msgs::PathSegment::ARC;   
     arc_path_segment.ref_point.x = arc_center(0);
     arc_path_segment.ref_point.y = arc_center(1);  
+    // speed on an arc is limited by lateral acceleration (v^2*k) and by the max spin rate (v*k)
+    double arc_speed = ARC_MAX_SPEED;
+    if (fabs(curvature) > 0.0) {
+        arc_speed = std::min(arc_speed, sqrt(ARC_MAX_ACCEL / fabs(curvature)));
+        arc_speed = std::min(arc_speed, MAX_OMEGA / fabs(curvature));
+    }
+    arc_path_segment.max_speeds.linear.x = arc_speed;
+    arc_path_segment.max_speeds.angular.z = arc_speed*fabs(curvature);
+    arc_path_segment.accel_limit = ARC_MAX_ACCEL;
+    arc_path_segment.decel_limit = ARC_MAX_ACCEL;
     return arc_path_segment;
 }
 
 //given two x-y vertices, define and return a line path segment object
 cwru_msgs::PathSegment DesStateGenerator::build_line_segment(Eigen::Vector2d v1, Eigen::Vector2d v2) {
-    ROS_INFO("build_line_segment");
+    ROS_DEBUG("build_line_segment");
 
     cwru_msgs::PathSegment line_path_segment; // a container for new path segment
     double des_heading;
@@ -542,10 +809,15 @@ cwru_msgs::PathSegment DesStateGenerator::build_line_segment(Eigen::Vector2d v1,
     line_path_segment.seg_type = cwru_msgs::PathSegment::LINE;   
     line_path_segment.ref_point.x = v1(0);
     line_path_segment.ref_point.y = v1(1);        
-
-    ROS_INFO("new line seg starts from x,y = %f, %f",v1(0),v1(1));
-    ROS_INFO("new line seg_length = %f",line_path_segment.seg_length);
-    ROS_INFO("heading: %f",des_heading);
+    line_path_segment.max_speeds.linear.x = MAX_SPEED;
+    line_path_segment.max_speeds.angular.z = 0.0;
+    line_path_segment.accel_limit = MAX_ACCEL;
+    line_path_segment.decel_limit = MAX_ACCEL;
+    line_path_segment.min_speeds.linear.x = 0.0; // stop at the end, unless the speed planner says otherwise
+
+    ROS_DEBUG("new line seg starts from x,y = %f, %f",v1(0),v1(1));
+    ROS_DEBUG("new line seg_length = %f",line_path_segment.seg_length);
+    ROS_DEBUG("heading: %f",des_heading);
         
    /* if (DEBUG_MODE) {
         std::cout<<"enter 1: ";
@@ -596,6 +868,9 @@ void DesStateGenerator::unpack_next_path_segment() {
     current_seg_type_ = path_segment.seg_type;
     current_seg_curvature_ = path_segment.curvature;
     current_seg_length_ = path_segment.seg_length;
+    current_seg_v_max_ = path_segment.max_speeds.linear.x;
+    current_seg_v_end_ = path_segment.min_speeds.linear.x; // planned junction speed into the next segment
+    current_seg_accel_ = path_segment.accel_limit;
     current_seg_ref_point_(0) = path_segment.ref_point.x;
     current_seg_ref_point_(1) = path_segment.ref_point.y;  
     // path segments store heading as a quaternion...convert to scalar heading:
@@ -619,9 +894,9 @@ void DesStateGenerator::unpack_next_path_segment() {
             ROS_INFO("unpacking a spin-in-place segment");
             current_seg_phi_goal_= current_seg_init_tan_angle_ + sgn(current_seg_curvature_)*current_seg_length_;
             break;
-        case ARC:  // not implemented; set segment type to HALT
+        case ARC:
             ROS_INFO("unpacking an arc segment");
-            current_seg_phi_goal_= current_seg_init_tan_angle_ + sgn(current_seg_curvature_)*current_seg_length_;
+            current_seg_phi_goal_= current_seg_init_tan_angle_ + current_seg_curvature_*current_seg_length_; // seg_length is arc length
             break;
         default:  
             ROS_WARN("segment type not defined");
@@ -648,6 +923,7 @@ void DesStateGenerator::unpack_next_path_segment() {
     
 // no arguments--uses values in member variables 
 void DesStateGenerator::update_des_state() {
+    update_predicted_odom();
     switch (current_seg_type_) {
         case LINE: 
             des_state_ = update_des_state_lineseg();          
@@ -655,13 +931,30 @@ void DesStateGenerator::update_des_state() {
         case SPIN_IN_PLACE:
             des_state_ = update_des_state_spin();
             break;
-        case ARC:  // not implemented; set segment type to HALT
+        case ARC:
             des_state_ = update_des_state_arc();
             break;
         default:  
             des_state_ = update_des_state_halt();   
     }
-    des_state_publisher_.publish(des_state_); //send out our message
+    // send out our message; as a shared pointer, so a steering nodelet in the same manager gets it without serialization
+    des_state_publisher_.publish(nav_msgs::OdometryPtr(new nav_msgs::Odometry(des_state_)));
+}
+
+// one control cycle: if we have completed a path segment, try to get another one, then update the desired state and publish it
+// main() and the nodelet both call this at UPDATE_RATE
+void DesStateGenerator::update() {
+    check_estop_flag();
+    if (current_path_seg_done_) {
+        // if necessary, construct new path segments from new polyline path subgoal
+        unpack_next_path_segment();
+    }
+    update_des_state(); // when segment is traversed, sets: current_path_seg_done_ = true
+}
+
+// service our subscriptions' callbacks; run as a node, that is the global queue, but a nodelet gives us a queue of our own
+void DesStateGenerator::spin_once() {
+    static_cast<ros::CallbackQueue*>(nh_.getCallbackQueue())->callAvailable();
 }
 
 
@@ -687,7 +980,7 @@ nav_msgs::Odometry DesStateGenerator::update_des_state_lineseg()
     }
     else
     {
-        current_speed_des_ = compute_speed_profile(current_seg_length_to_go_, dist_decel); //USE VEL PROFILING
+        current_speed_des_ = compute_speed_profile(current_seg_length_to_go_, current_seg_v_end_); //USE VEL PROFILING
     }
 
     current_omega_des_ = 0.0; // this value will not change during lineseg motion
@@ -704,7 +997,9 @@ nav_msgs::Odometry DesStateGenerator::update_des_state_lineseg()
         current_seg_xy_des_ = current_seg_ref_point_ + current_seg_tangent_vec_*current_seg_length_; // specify destination vertex as exact, current goal
         current_seg_phi_des_ = current_seg_init_tan_angle_;
         current_seg_length_to_go_=0.0;
-        current_speed_des_ = 0.0;  //
+        // carry speed into the next segment: at most the planned junction speed (0 if we must stop), and never more
+        // than was actually commanded (a lidar cap may have held it lower)
+        current_speed_des_ = std::min(current_speed_des_, current_seg_v_end_);
         current_omega_des_ = 0.0; 
         current_path_seg_done_ = true; 
         ROS_INFO("update_des_state_lineseg: done with translational motion commands");
@@ -746,6 +1041,9 @@ nav_msgs::Odometry DesStateGenerator::update_des_state_spin()
     else
     {
     current_omega_des_ = compute_omega_profile(current_seg_length_to_go_, rot_decel, current_seg_curvature_); //USE VEL PROFILING 
+    // spin slower in clutter, in proportion to the allowed speed
+    double omega_allowed = MAX_OMEGA * std::max(std::min(1.0, allowed_speed_limit() / MAX_SPEED), ALLOWED_OMEGA_FLOOR);
+    current_omega_des_ = planar_geometry::sat(current_omega_des_, omega_allowed);
     }
 
     double delta_phi = current_omega_des_*dt_; //incremental rotation--could be + or -
@@ -783,45 +1081,50 @@ nav_msgs::Odometry DesStateGenerator::update_des_state_spin()
 }
 
 
+// update desired state along a circular arc; ref point is the arc center, seg length is the arc length
+// position at heading phi along the arc: center + (1/curvature)*[sin(phi), -cos(phi)]
 nav_msgs::Odometry DesStateGenerator::update_des_state_arc() 
 {
     nav_msgs::Odometry desired_state; // fill in this message and return it
     // need to update these values:
     //    current_seg_length_to_go_, current_seg_phi_des_, current_seg_xy_des_ 
     //    current_speed_des_, current_omega_des_
-    current_seg_xy_des_ = current_seg_ref_point_; 
-    current_seg_phi_des_ = current_seg_init_tan_angle_; 
-    current_arc_des_ = compute_arc_profile(); //USE VEL PROFILING
-    
-    // !!!!!!!!!!!!!!! the formula used in the next two lines should be verified
-    double TURN_RADIUS = (current_speed_des_) / (current_omega_des_); // radius = velocity / omega     
-    double delta_arc = TURN_RADIUS * current_omega_des_*dt_; // the length of arc = radius * theta, where theta = omega * dt_
+    if (motorsEnabled_ == false)
+    {
+        current_speed_des_ = 0;
+    }
+    else if (lidar_alarm_ == true || soft_stop_ == true)
+    {
+        current_speed_des_ = compute_lidar_vel(lidar_scheduled_vel, ARC_MAX_ACCEL, dt_);
+    }
+    else
+    {
+        current_speed_des_ = compute_speed_profile(current_seg_length_to_go_, current_seg_v_end_); //USE VEL PROFILING
+    }
+    current_omega_des_ = current_speed_des_ * current_seg_curvature_; // omega = v/R, signed by turn direction
     
+    double delta_arc = current_speed_des_*dt_; // incremental distance along the arc
     ROS_INFO("update_des_state_arc: delta_arc = %f",delta_arc);
     current_seg_length_to_go_ -= delta_arc; 
     ROS_INFO("update_des_state_arc: current_segment_length_to_go_ = %f",current_seg_length_to_go_);    
     
-    if (delta_arc >= (2 * M_PI * TURN_RADIUS / 4)) 
+    if (current_seg_length_to_go_ < LENGTH_TOL) 
     { // check if done with this move
-        // or the condition should be "delta_arc >= 2 * M_PI * TURN_RADIUS / 4", which is uesed for the perticular case: turn around
         current_seg_type_ = HALT;
-        current_seg_xy_des_ = current_seg_ref_point_ + current_seg_tangent_vec_*current_seg_length_; // specify destination vertex as exact, current goal
         current_seg_length_to_go_=0.0;
-        current_speed_des_ = 0.0;  // 
+        current_speed_des_ = std::min(current_speed_des_, current_seg_v_end_);  // planned junction speed, unless commanded lower
         current_omega_des_ = 0.0;
-        current_seg_phi_des_ = current_seg_init_tan_angle_ + sgn(current_seg_curvature_)*current_seg_length_;  
+        current_seg_phi_des_ = current_seg_phi_goal_;  
         current_path_seg_done_ = true;
         ROS_INFO("update_des_state_arc: done with arc");
     }
     else 
-    { // not done yet--rotate some more
-        // based on angular distance covered, compute current desired heading
-        // consider specified curvature ==> rotation direction to goal
-        current_seg_phi_des_ = current_seg_init_tan_angle_ + sgn(current_seg_curvature_)*(current_seg_length_ - current_seg_length_to_go_);
-        // not done with translational move yet--step forward
-        // based on distance covered, compute current desired x,y; use scaled vector from v1 to v2 
-        current_seg_xy_des_ = current_seg_ref_point_ + current_seg_tangent_vec_*(current_seg_length_ - current_seg_length_to_go_);       
+    { // not done yet--advance along the arc
+        current_seg_phi_des_ = current_seg_init_tan_angle_ + current_seg_curvature_*(current_seg_length_ - current_seg_length_to_go_);
     }
+    // position follows from heading, for a circle about ref point
+    current_seg_xy_des_(0) = current_seg_ref_point_(0) + sin(current_seg_phi_des_)/current_seg_curvature_;
+    current_seg_xy_des_(1) = current_seg_ref_point_(1) - cos(current_seg_phi_des_)/current_seg_curvature_;
 
     // fill in components of desired-state message:
     desired_state.twist.twist.linear.x =current_speed_des_;
@@ -855,33 +1158,30 @@ nav_msgs::Odometry DesStateGenerator::update_des_state_halt() {
 //DUMMY--fill this in
 
 // To calculate the desired speed
-double DesStateGenerator::compute_speed_profile(double current_seg_length_to_go_, double dist_decel) 
+// speed is the smallest of: the segment cruise speed, what we can reach by accelerating from the current
+// speed, and what still lets us brake to the planned end-of-segment speed v_end
+double DesStateGenerator::compute_speed_profile(double current_seg_length_to_go_, double v_end) 
 {
-    double scheduled_vel = 0.0f;
-
     ROS_INFO("distance left: %f", current_seg_length_to_go_);
     
-    // use distance left to decide what scheduled velocity should be
-    // use some parameters in vel_scheduler.cpp in assignment 4
     if (current_seg_length_to_go_ <= 0.0)
     {
-         return 0.0;
-    }
-    // possibly should be braking to a halt
-    // dist = 0.5*a*t_halt^2; so t_halt = sqrt(2*dist/a); v = a*t_halt
-    // so v = a*sqrt(2*dist/a) = sqrt(2*dist*a)
-    // dist_decel and MAX_ACCEL have been defined in corresponding head document
-    else if (current_seg_length_to_go_ <= dist_decel)
-    {
-         scheduled_vel = .5 * sqrt(2 * current_seg_length_to_go_ * MAX_ACCEL);
-         ROS_WARN("Braking Zone: First scheduled vel = %f", scheduled_vel);
-         return scheduled_vel;
+         return v_end;
     }
-    // not ready to decel, so target vel is v_max, either accel to it or hold it
-    else
+    // possibly should be braking: v_end^2 = v^2 - 2*a*dist, so v = sqrt(v_end^2 + 2*a*dist)
+    double v_brake = sqrt(v_end*v_end + 2.0 * current_seg_length_to_go_ * current_seg_accel_);
+    // accelerate toward the cruise speed at no more than the accel limit
+    double v_accel = current_speed_des_ + current_seg_accel_ * dt_;
+
+    // don't exceed the lidar's allowed speed; if it drops below our speed, brake toward it at the segment's decel limit
+    double v_allowed = std::max(allowed_speed_limit(), current_speed_des_ - current_seg_accel_ * dt_);
+
+    double scheduled_vel = std::min(std::min(current_seg_v_max_, v_allowed), std::min(v_brake, v_accel));
+    if (v_brake < current_seg_v_max_)
     {
-         return MAX_SPEED;
+         ROS_INFO("Braking Zone: scheduled vel = %f", scheduled_vel);
     }
+    return scheduled_vel;
 }
 
 
@@ -922,33 +1222,6 @@ double DesStateGenerator::compute_omega_profile(double current_seg_length_to_go_
     */
 }
 
-double DesStateGenerator::compute_arc_profile()
-{
-    double scheduled_arc = 0.0f;
-
-    ROS_INFO("arc left: %f", current_seg_length_to_go_);
-
-    // use rotational phi left to decide what scheduled omega should be
-    // use some parameters in vel_scheduler.cpp in assignment 4
-    if (current_seg_length_to_go_ <= 0.01 && current_seg_length_to_go_ >= -0.01) 
-    { // achieve the goal or overshot: need to stop!
-        scheduled_arc = 0.0;
-    } 
-    // rot_decel and MAX_ALPHA have been defined in corresponding head document
-    else if (fabs(current_seg_length_to_go_) <= arc_decel) 
-    {   //robot should be braking to a halt
-        scheduled_arc = sgn(current_seg_curvature_) * sqrtf(2 * fabs(current_seg_length_to_go_) * ARC_MAX_ACCEL);
-        ROS_INFO("braking zone schedued arc is: %f", scheduled_arc);
-    } 
-    else 
-    {
-        // do not need to decelerate, so scheduled omega will be the max omega (need to accelerate or keep the max omega)
-        scheduled_arc = sgn(current_seg_curvature_) * ARC_MAX_SPEED;
-    }
-    ROS_INFO("Slow down scheduled arc is: %f", scheduled_arc);
-    return scheduled_arc;
-}
-
 double DesStateGenerator::compute_lidar_vel(double scheduled_vel, double a_max, double DT)
 {
     double emergency_slow_down_fudge_factor = 2;
@@ -977,44 +1250,3 @@ double DesStateGenerator::compute_lidar_omega(double scheduled_omega, double alp
         lidar_scheduled_omega = scheduled_omega;
         return scheduled_omega;
 }
-
-int main(int argc, char** argv) {
-    // ROS set-ups:
-    ros::init(argc, argv, "desStateGenerator"); //node name
-    ros::NodeHandle nh; // create a node handle; need to pass this to the class constructor
-
-    ROS_INFO("main: instantiating a DesStateGenerator");
-    DesStateGenerator desStateGenerator(&nh); //instantiate a DesStateGenerator object and pass in pointer to nodehandle for constructor to use
-    ros::Rate sleep_timer(UPDATE_RATE); //a timer for desired rate, e.g. 50Hz
-    
-
-    //subscribe to motors_enabled rosmsg
-    //ros::Subscriber submotorsEnabled = nh.subscribe("/motors_enabled", 1, motorsEnabledCallback);
-
-    //subscribe to lidar_alarm rosmsg
-    //ros::Subscriber sublidar = nh.subscribe("/lidar_alarm", 1, lidarCallback);
-
-    double command_velocity = 0;
-    double command_omega = 0;
-
-    //constructor will wait for a valid odom message; let's use this for our first vertex;
-    ROS_INFO("main: going into main loop");
-
-
-    while (ros::ok()) {
-        if (desStateGenerator.get_current_path_seg_done()) {
-            //here if we have completed a path segment, so try to get another one
-            // if necessary, construct new path segments from new polyline path subgoal
-            desStateGenerator.unpack_next_path_segment();
-        }
-
-        desStateGenerator.update_des_state(); // update the desired state and publish it; 
-        // when segment is traversed, set: current_path_seg_done_ = true
-
-        ros::spinOnce();
-        //checkAlarms(cmd_vel, command_velocity, command_omega);
-        sleep_timer.sleep();
-    }
-    return 0;
-}
-
@@ -16,6 +16,7 @@ const bool DEBUG_MODE=false; // change this for display/break-points
 #include <string>
 #include <vector>
 #include <queue>
+#include <algorithm>
 #include <iostream>
 #include <nav_msgs/Path.h>
 #include <geometry_msgs/Twist.h>
@@ -26,6 +27,10 @@ const bool DEBUG_MODE=false; // change this for display/break-points
 
 
 #include <ros/ros.h> //ALWAYS need to include this
+#include <planar_geometry/planar_geometry.h> // shared sgn/sat/min_dang/quaternion utilities
+#include <ros/callback_queue.h>
+#include <ros/spinner.h>
+#include <boost/scoped_ptr.hpp>
 
 //message types used in this example code;  include more message types, as needed
 #include <std_msgs/Bool.h> 
@@ -44,6 +49,11 @@ const bool DEBUG_MODE=false; // change this for display/break-points
 
 #include <tf/transform_listener.h> //for transforms
 
+#include <std_msgs/Float32MultiArray.h>
+#include <delta_des_state_generator/odom_predictor.h> // forward-predicts late odom to control time
+#include <delta_des_state_generator/spsc_queue.h> // lock-free queue between service thread and control loop
+#include <cwru_base/estop_flag.h> // crio_receiver's motors_enabled, in shared memory
+
 //Segment types 
 const int HALT = 0;
 const int LINE = cwru_msgs::PathSegment::LINE;
@@ -59,40 +69,48 @@ const double MAX_ALPHA = 1.0; // rad/sec^2; adjust this
 const double ARC_MAX_SPEED = 0.3; // m/sec; adjust this
 const double ARC_MAX_ACCEL = 0.5; // m/sec^2; adjust this
 
+// allowed-speed signal from the lidar (/lidar_allowed_speed): speed limits are scaled down by it in clutter
+const double ALLOWED_SPEED_TIMEOUT = 0.5; // sec; if the signal goes quiet this long, assume nothing is allowed
+const double ALLOWED_OMEGA_FLOOR = 0.3; // spin limit never drops below this fraction of MAX_OMEGA, so we can turn away
+
 const double LENGTH_TOL = 0.05; // tolerance for path; adjust this
 const double HEADING_TOL = 0.05; // heading tolerance; adjust this
+
+// corner smoothing: replace spin-in-place stops at polyline corners with circular-arc fillets
+const bool SMOOTH_CORNERS = true; // set false to fall back to spin-then-line at every vertex
+const double MAX_TURN_RADIUS = 1.0; // m; preferred fillet radius
+const double MIN_TURN_RADIUS = 0.2; // m; if a corner can't fit at least this radius, stop and spin instead
+const double MAX_CORNER_DEVIATION = 0.25; // m; max distance the fillet may cut inside the polyline vertex
+const double MAX_FILLET_ANGLE = 2.5; // rad; sharper turns (nearly reversing) spin in place instead
 //const double ARC_TOL = 0.05; // heading tolerance; adjust this
 //const double TURN_RADIUS = 1.5; // the radius used for turning right smoothly in arc path; adjust this
 
 const double UPDATE_RATE = 50.0; // choose the desired-state publication update rate
+// queue capacities; storage is allocated once, at start-up
+const int PATH_QUEUE_CAPACITY = 4096; // max path vertices waiting to be processed
+const int SEGMENT_QUEUE_CAPACITY = 3*PATH_QUEUE_CAPACITY + 1; // each vertex makes at most a spin/arc + line, plus an initial spin
+const int LATENCY_PUBLISH_DECIMATION = 50; // publish odom latency stats once per this many updates
 
 // compute some parameters for speed profile
 // use the names nearly the same with vel_scheduler.cpp in assignment 4
-float accelTime = MAX_SPEED / MAX_ACCEL; // supposes start from rest
-float decelTime = accelTime; 
-float dist_accel = 0.5 * MAX_ACCEL * (accelTime * accelTime); 
-float dist_decel = 0.5 * MAX_ACCEL * (decelTime * decelTime); 
+const float accelTime = MAX_SPEED / MAX_ACCEL; // supposes start from rest
+const float decelTime = accelTime; 
+const float dist_accel = 0.5 * MAX_ACCEL * (accelTime * accelTime); 
+const float dist_decel = 0.5 * MAX_ACCEL * (decelTime * decelTime); 
 
 // compute some parameters for omega profile
 // use the names nearly the same with vel_scheduler.cpp in assignment 4
-float rotAccelTime = MAX_OMEGA / MAX_ALPHA; // supposes start from rest
-float rotDecelTime = rotAccelTime; 
-float rot_accel = 0.5 * MAX_ALPHA * (rotAccelTime * rotAccelTime);
-float rot_decel = 0.5 * MAX_ALPHA * (rotDecelTime * rotDecelTime);
+const float rotAccelTime = MAX_OMEGA / MAX_ALPHA; // supposes start from rest
+const float rotDecelTime = rotAccelTime; 
+const float rot_accel = 0.5 * MAX_ALPHA * (rotAccelTime * rotAccelTime);
+const float rot_decel = 0.5 * MAX_ALPHA * (rotDecelTime * rotDecelTime);
 
 
 // compute some parameters for arc profile
-float arcAccelTime = ARC_MAX_SPEED / ARC_MAX_ACCEL; // supposes start from rest
-float arcDecelTime = arcAccelTime; 
-float arc_accel = 0.5 * ARC_MAX_ACCEL * (arcAccelTime * arcAccelTime); 
-float arc_decel = 0.5 * ARC_MAX_ACCEL * (arcDecelTime * arcDecelTime);
-
-// Alarms global variables
-bool lidar_alarm_ = false;
-bool soft_stop_ = false;
-bool motorsEnabled_ = true;
-std::string check;
-std::string lidar_check;
+const float arcAccelTime = ARC_MAX_SPEED / ARC_MAX_ACCEL; // supposes start from rest
+const float arcDecelTime = arcAccelTime; 
+const float arc_accel = 0.5 * ARC_MAX_ACCEL * (arcAccelTime * arcAccelTime); 
+const float arc_decel = 0.5 * ARC_MAX_ACCEL * (arcDecelTime * arcDecelTime);
 
 // define a class, including a constructor, member variables and member functions
 
@@ -100,13 +118,11 @@ class DesStateGenerator {
 public:
     // PUBLIC MEMBER FUNCTIONS:
     DesStateGenerator(ros::NodeHandle* nodehandle); //"main" will need to instantiate a ROS nodehandle, then pass it to the constructor
+    ~DesStateGenerator();
 
     // some utilities:
     //signum function: define this one in-line
-    double sgn(double x) { if (x>0.0) {return 1.0; }
-    else if (x<0.0) {return -1.0;}
-    else {return 0.0;}
-    }
+    double sgn(double x) { return planar_geometry::sgn(x); }
     
     bool get_waiting_for_vertex() { return waiting_for_vertex_; }  
     bool get_current_path_seg_done() { return current_path_seg_done_; }     
@@ -119,6 +135,7 @@ public:
     double compute_heading_from_v1_v2(Eigen::Vector2d v1, Eigen::Vector2d v2);
 
     geometry_msgs::PoseStamped map_to_odom_pose(geometry_msgs::PoseStamped map_pose);
+    geometry_msgs::PoseStamped apply_map_to_odom(const geometry_msgs::PoseStamped& map_pose); // with mapToOdom_ as is
     
     //geometry_msgs::Pose map_to_odom_pose(geometry_msgs::Pose map_pose); // convert a pose from map frame to odom frame
     geometry_msgs::PoseStamped odom_to_map_pose(geometry_msgs::PoseStamped odom_pose); // convert a pose from odom frame to map frame   
@@ -127,6 +144,7 @@ public:
     //the interesting functions: how to update the desired state and how to get a new path segment
     void update_des_state();
     void unpack_next_path_segment();
+    void update(); // one control cycle: unpack a new segment if needed, then update and publish the desired state
  
     
 private:
@@ -138,13 +156,28 @@ private:
     ros::Subscriber odom_subscriber_; //these will be set up within the class constructor, hiding these ugly details
     ros::Subscriber motorsEnabled_subscriber_;
     ros::Subscriber lidar_subscriber_;
+    ros::Subscriber allowed_speed_subscriber_;
+    // the path services run on their own callback queue and thread, so path appends never stall the control loop;
+    // they talk to the control loop only through the lock-free path_queue_
+    ros::NodeHandle service_nh_;
+    ros::CallbackQueue service_queue_;
+    boost::scoped_ptr<ros::AsyncSpinner> service_spinner_; // stopped in the destructor, before service_queue_ goes
     ros::ServiceServer append_path_; // service to receive a path message and append the poses to a queue of poses
     ros::ServiceServer flush_path_; //service to clear out the current queue of path points
     ros::Publisher des_state_publisher_; // we will publish desired states using this object   
+    ros::Publisher odom_latency_publisher_; // publishes the odom latency distribution
 
     double dt_; // time step of update rate
-    std::queue<geometry_msgs::PoseStamped> path_queue_; //a C++ "queue" object, stores vertices as Pose points in a FIFO queue; receive these via appendPath service
-    std::queue<cwru_msgs::PathSegment> segment_queue_; // path segment objects--as generated from crude polyline path (above)
+    // stores vertices as Pose points in a FIFO queue; receive these via appendPath service
+    // produced by the service thread (append/flush), consumed by the control loop (process_new_vertex)
+    SpscQueue<geometry_msgs::PoseStamped> path_queue_;
+    // path segment objects--as generated from crude polyline path (above)
+    // produced and consumed by the control loop; a preallocated ring with random access, so the speed planner can
+    // sweep forward and backward over all queued segments without allocating;
+    // each segment carries its own limits: max_speeds.linear.x (cruise speed), accel_limit/decel_limit,
+    // and min_speeds.linear.x = planned speed at the END of the segment (junction speed into the next one)
+    SpscQueue<cwru_msgs::PathSegment> segment_queue_;
+    std::vector<double> v_junction_; // speed planner scratch space, preallocated
 
     geometry_msgs::PoseStamped last_map_pose_rcvd_;
     geometry_msgs::Pose new_pose_des_;
@@ -161,6 +194,12 @@ private:
     double odom_phi_;
     geometry_msgs::Quaternion odom_quat_;
 
+    // odom history and prediction to control time, compensating for odom latency
+    OdomPredictor odom_predictor_;
+    OdomSample predicted_odom_; // latest odom, forward-integrated to the time of the current update
+    std_msgs::Float32MultiArray odom_latency_stats_;
+    int n_updates_;
+
     //path description values:  these are all with respect to odom coordinates
     // these values get set once upon construction of the current path segment:
     double current_seg_init_tan_angle_;  
@@ -168,6 +207,9 @@ private:
     double current_seg_length_; 
     int current_seg_type_; 
     double current_seg_phi_goal_;
+    double current_seg_v_max_; // cruise speed limit for this segment
+    double current_seg_v_end_; // planned speed at the end of this segment; 0 if we must stop there
+    double current_seg_accel_; // accel/decel limit for this segment
     Eigen::Vector2d current_seg_tangent_vec_; 
     Eigen::Vector2d current_seg_ref_point_;
     
@@ -183,8 +225,26 @@ private:
     // lidar private variables
     double lidar_scheduled_vel;
     double lidar_scheduled_omega;
+    double allowed_speed_; // latest allowed speed from the lidar; negative until the first message
+    ros::Time t_allowed_speed_;
+
+    // e-stop fast path: crio_receiver's shared-memory flag, read at the top of every update; it overrides
+    // motorsEnabled_ from the topic while it's fresh
+    cwru_base::EstopFlag estop_flag_;
+    ros::WallTime t_estop_flag_open_attempt_;
+    bool have_estop_flag_changes_;
+    uint32_t estop_flag_changes_;
+    double max_estop_flag_latency_; // cRIO packet receipt to seeing the change here, worst so far
     
     bool waiting_for_vertex_;
+
+    // alarm state, from the motors_enabled/lidar_alarm topics and the e-stop flag; per instance, so two nodelets
+    // in one manager don't share it
+    bool lidar_alarm_;
+    bool soft_stop_;
+    bool motorsEnabled_;
+    std::string check;
+    std::string lidar_check;
 /*
      //Variables to store the motorsEnabled information
     bool motorsEnabled;
@@ -213,11 +273,18 @@ private:
     void initializeSubscribers(); // we will define some helper methods to encapsulate the gory details of initializing subscribers, publishers and services
     void initializePublishers();
     void initializeServices();
+    void spin_once(); // service this object's subscriptions (the constructor waits on odom and tf with this)
 
     //prototypes for subscription callbacks
     void odomCallback(const nav_msgs::Odometry& odom_rcvd);
     void motorsEnabledCallback(const std_msgs::Bool::ConstPtr &motorsEnabled);
     void lidarCallback(const std_msgs::Bool &lidar_alarm);
+    void allowedSpeedCallback(const std_msgs::Float32 &allowed_speed);
+    double allowed_speed_limit(); // current speed cap from the lidar (MAX_SPEED if there is no lidar node)
+    void check_estop_flag(); // motorsEnabled_ from the shared-memory flag, if crio_receiver is writing it
+
+    // forward-predict odom to "now" and (occasionally) publish the latency stats
+    void update_predicted_odom();
 
     //prototypes for service callbacks 
     bool flushPathCallback(cwru_srv::simple_bool_service_messageRequest& request, cwru_srv::simple_bool_service_messageResponse& response);
@@ -226,6 +293,14 @@ private:
     // function to draw a subgoal from the polyline path queue and re-interpret it in terms of multiple, dynamically-feasible
     // path segments
     void process_new_vertex();
+
+    // speed planning over the whole segment queue, done once per path (not per tick):
+    // a forward pass (limited by accel from the previous junction) and a backward pass (must be able to brake
+    // to the next junction) yield the maximal speed at every junction, so the robot carries speed through
+    // segments instead of stopping at every vertex
+    void plan_speed_profile();
+    double junction_speed_limit(const cwru_msgs::PathSegment& seg_in, const cwru_msgs::PathSegment& seg_out);
+    double compute_final_heading(const cwru_msgs::PathSegment& seg);
         
     //construct path segments: 
     // build_spin_then_line_path_segments: given two poses, p1 and p2 (in consistent reference frame),
@@ -235,10 +310,17 @@ private:
     // So, this function will return a vector of path segments of size=2
     std::vector<cwru_msgs::PathSegment> build_spin_then_line_path_segments(geometry_msgs::Pose pose1, geometry_msgs::Pose pose2);
 
+    // build_smoothed_path_segments: given a start pose and a polyline of vertices (consistent reference frame),
+    // construct line segments joined by tangent circular arcs at the corners, so the robot rolls through
+    // corners instead of stopping to spin; a spin is only emitted at the start (to face the first leg) and at
+    // corners too sharp or too tight to fillet; single pass, O(number of vertices)
+    std::vector<cwru_msgs::PathSegment> build_smoothed_path_segments(geometry_msgs::Pose start_pose, const std::vector<Eigen::Vector2d>& vertices);
+
     // helper functions for the above: how to construct line and spin path segments
     cwru_msgs::PathSegment build_line_segment(Eigen::Vector2d v1, Eigen::Vector2d v2);
     cwru_msgs::PathSegment build_spin_in_place_segment(Eigen::Vector2d v1, double init_heading, double des_heading);
     // TODO: augment with circular-arc segments
+    // for arcs, seg_length is the arc length (m) and ref_point is the arc center
     cwru_msgs::PathSegment build_arc_segment(Eigen::Vector2d arc_center, double init_heading, double final_heading, double curvature);
     
     //interpret path segments:
@@ -248,9 +330,8 @@ private:
     
     // these should do triangular or trapezoidal velocity profiling
     // they should also be smart enough to recognize E-stops, etc.
-    double compute_speed_profile(double current_seg_length_to_go_, double dist_decel);
+    double compute_speed_profile(double current_seg_length_to_go_, double v_end);
     double compute_omega_profile(double current_seg_length_to_go_, double rot_decel, double current_seg_curvature_); 
-    double compute_arc_profile();
     double compute_lidar_vel(double scheduled_vel, double a_max, double DT);
     double compute_lidar_omega(double scheduled_omega, double alpha_max, double DT);
 
@@ -0,0 +1,24 @@
+//delta_des_state_generator_node.cpp:
+//runs DesStateGenerator as a stand-alone node; see delta_des_state_generator_nodelet.cpp to run it in a nodelet manager
+
+#include "delta_des_state_generator.h"
+
+int main(int argc, char** argv) {
+    // ROS set-ups:
+    ros::init(argc, argv, "desStateGenerator"); //node name
+    ros::NodeHandle nh; // create a node handle; need to pass this to the class constructor
+
+    ROS_INFO("main: instantiating a DesStateGenerator");
+    DesStateGenerator desStateGenerator(&nh); //instantiate a DesStateGenerator object and pass in pointer to nodehandle for constructor to use
+    ros::Rate sleep_timer(UPDATE_RATE); //a timer for desired rate, e.g. 50Hz
+
+    //constructor will wait for a valid odom message; let's use this for our first vertex;
+    ROS_INFO("main: going into main loop");
+
+    while (ros::ok()) {
+        desStateGenerator.update(); // update the desired state and publish it; get a new path segment when needed
+        ros::spinOnce();
+        sleep_timer.sleep();
+    }
+    return 0;
+}
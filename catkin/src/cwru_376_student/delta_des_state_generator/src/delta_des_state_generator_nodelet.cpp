@@ -0,0 +1,50 @@
+//delta_des_state_generator_nodelet.cpp:
+//runs DesStateGenerator in a nodelet manager, alongside the steering nodelet: desState is then handed over
+//as a shared pointer, with no serialization or TCP hop
+//the control loop is the same as main() in delta_des_state_generator_node.cpp, in a thread of its own, and the
+//subscriptions get a callback queue of their own that only this thread services, so callbacks and control
+//cycles never overlap, just like in the stand-alone node
+
+#include <boost/thread.hpp>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include "delta_des_state_generator.h"
+
+namespace delta_des_state_generator {
+
+class DesStateGeneratorNodelet : public nodelet::Nodelet {
+public:
+    DesStateGeneratorNodelet() : running_(false) {}
+    ~DesStateGeneratorNodelet() {
+        running_ = false;
+        if (control_thread_.joinable()) control_thread_.join();
+    }
+
+private:
+    ros::CallbackQueue queue_;
+    boost::thread control_thread_;
+    volatile bool running_;
+
+    virtual void onInit() {
+        running_ = true;
+        // the constructor blocks until odom and tf arrive, so don't run it in the manager's thread
+        control_thread_ = boost::thread(boost::bind(&DesStateGeneratorNodelet::run, this));
+    }
+
+    void run() {
+        ros::NodeHandle nh(getNodeHandle());
+        nh.setCallbackQueue(&queue_);
+        DesStateGenerator desStateGenerator(&nh);
+        ros::Rate sleep_timer(UPDATE_RATE);
+        NODELET_INFO("going into main loop");
+        while (running_ && ros::ok()) {
+            desStateGenerator.update();
+            queue_.callAvailable();
+            sleep_timer.sleep();
+        }
+    }
+};
+
+} // namespace delta_des_state_generator
+
+PLUGINLIB_EXPORT_CLASS(delta_des_state_generator::DesStateGeneratorNodelet, nodelet::Nodelet)
@@ -24,7 +24,7 @@ SteeringController::SteeringController(ros::NodeHandle* nodehandle):nh_(*nodehan
     while (odom_phi_ > 500.0) {
         ros::Duration(0.5).sleep(); // sleep for half a second
         std::cout << ".";
-        ros::spinOnce();
+        spin_once();
     }
     ROS_INFO("constructor: got an odom message");    
     
@@ -43,7 +43,7 @@ SteeringController::SteeringController(ros::NodeHandle* nodehandle):nh_(*nodehan
                 ROS_ERROR("%s", exception.what());
                 tferr=true;
                 ros::Duration(0.5).sleep(); // sleep for half a second
-                ros::spinOnce();                
+                spin_once();                
             }   
     }
     ROS_INFO("tf is good");
@@ -68,6 +68,7 @@ SteeringController::SteeringController(ros::NodeHandle* nodehandle):nh_(*nodehan
     twist_cmd2_.twist = twist_cmd_; // copy the twist command into twist2 message
     twist_cmd2_.header.stamp = ros::Time::now(); // look up the time and put it in the header  
 
+    n_control_cycles_ = 0;
 }
 
 //member helper function to set up subscribers;
@@ -96,6 +97,7 @@ void SteeringController::initializePublishers()
     cmd_publisher_ = nh_.advertise<geometry_msgs::Twist>("cmd_vel", 1, true); // talks to the robot!
     cmd_publisher2_ = nh_.advertise<geometry_msgs::TwistStamped>("cmd_vel_stamped",1, true); //alt topic, includes time stamp
     steering_errs_publisher_ =  nh_.advertise<std_msgs::Float32MultiArray>("steering_errs",1, true);
+    odom_latency_publisher_ = nh_.advertise<std_msgs::Float32MultiArray>("steering_odom_latency", 1); // [latest, mean, min, median, p95, max, n], in sec
 }
 
 
@@ -116,6 +118,7 @@ void SteeringController::odomCallback(const nav_msgs::Odometry& odom_rcvd) {
     // let's put odom x,y in an Eigen-style 2x1 vector; convenient for linear algebra operations
     odom_xy_vec_(0) = odom_x_;
     odom_xy_vec_(1) = odom_y_;   
+    odom_predictor_.add_odom(odom_rcvd); // remember this sample, for latency compensation
 }
 
 void SteeringController::desStateCallback(const nav_msgs::Odometry& des_state_rcvd) {
@@ -138,29 +141,18 @@ void SteeringController::desStateCallback(const nav_msgs::Odometry& des_state_rc
 
 //utility fnc to compute min dang, accounting for periodicity
 double SteeringController::min_dang(double dang) {
-    while (dang > M_PI) dang -= 2.0 * M_PI;
-    while (dang < -M_PI) dang += 2.0 * M_PI;
-    return dang;
+    return planar_geometry::min_dang(dang); // wraps any multiple of 2pi, no loop
 }
 
 
 // saturation function, values -1 to 1
 double SteeringController::sat(double x) {
-    if (x>1.0) {
-        return 1.0;
-    }
-    if (x< -1.0) {
-        return -1.0;
-    }
-    return x;
+    return planar_geometry::sat(x);
 }
 
 //some conversion utilities:
 double SteeringController::convertPlanarQuat2Phi(geometry_msgs::Quaternion quaternion) {
-    double quat_z = quaternion.z;
-    double quat_w = quaternion.w;
-    double phi = 2.0 * atan2(quat_z, quat_w); // cheap conversion from quaternion to heading for planar motion
-    return phi;
+    return planar_geometry::convertPlanarQuat2Phi(quaternion); // cheap conversion from quaternion to heading for planar motion
 }
 
 //member function implementation for a service callback function
@@ -187,6 +179,17 @@ void SteeringController::my_clever_steering_algorithm() {
     double lateral_err;
     double trip_dist_err; // error is scheduling...are we ahead or behind?
     
+    // odom is already old by the time we get here; compare desired state against odom predicted forward to now
+    OdomSample predicted_odom = odom_predictor_.predict(ros::Time::now());
+    odom_xy_vec_(0) = predicted_odom.x;
+    odom_xy_vec_(1) = predicted_odom.y;
+    odom_phi_ = predicted_odom.phi;
+    n_control_cycles_++;
+    if (n_control_cycles_ % LATENCY_PUBLISH_DECIMATION == 0) {
+        odom_predictor_.fill_latency_stats(odom_latency_stats_);
+        odom_latency_publisher_.publish(odom_latency_stats_);
+    }
+
 
     // have access to: des_state_vel_, des_state_omega_, des_state_x_, des_state_y_, des_state_phi_ and corresponding odom values    
     pos_err_xy_vec_ = des_xy_vec_ - odom_xy_vec_; // vector pointing from odom x-y to desired x-y
@@ -230,24 +233,7 @@ void SteeringController::my_clever_steering_algorithm() {
     cmd_publisher2_.publish(twist_cmd2_);     
 }
 
-int main(int argc, char** argv) 
-{
-    // ROS set-ups:
-    ros::init(argc, argv, "steeringController"); //node name
-
-    ros::NodeHandle nh; // create a node handle; need to pass this to the class constructor
-
-    ROS_INFO("main: instantiating an object of type SteeringController");
-    SteeringController steeringController(&nh);  //instantiate an exampleRosClass object and pass in pointer to nodehandle for constructor to use
-    ros::Rate sleep_timer(UPDATE_RATE); //a timer for desired rate, e.g. 50Hz
-   
-    ROS_INFO:("starting steering algorithm");
-    while (ros::ok()) {
-        steeringController.my_clever_steering_algorithm(); // compute and publish twist commands and cmd_vel and cmd_vel_stamped
-
-        ros::spinOnce();
-        sleep_timer.sleep();
-    }
-    return 0;
-} 
-
+// service our subscriptions' callbacks; run as a node, that is the global queue, but a nodelet gives us a queue of our own
+void SteeringController::spin_once() {
+    static_cast<ros::CallbackQueue*>(nh_.getCallbackQueue())->callAvailable();
+}
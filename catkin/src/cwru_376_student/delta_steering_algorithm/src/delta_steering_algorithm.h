@@ -12,6 +12,8 @@
 #include <vector>
 
 #include <ros/ros.h> //ALWAYS need to include this
+#include <ros/callback_queue.h>
+#include <planar_geometry/planar_geometry.h> // shared sgn/sat/min_dang/quaternion utilities
 
 //message types used in this example code;  include more message types, as needed
 #include <std_msgs/Bool.h> 
@@ -26,6 +28,7 @@
 #include <geometry_msgs/PoseStamped.h>
 #include <nav_msgs/Odometry.h>
  #include <tf/transform_listener.h>
+#include <delta_des_state_generator/odom_predictor.h> // forward-predicts late odom to control time
 
 //Eigen is useful for linear algebra
 #include <Eigen/Eigen>
@@ -34,6 +37,7 @@
 #include <Eigen/LU>
 
 const double UPDATE_RATE = 50.0; // choose the desired-state publication update rate
+const int LATENCY_PUBLISH_DECIMATION = 50; // publish odom latency stats once per this many control cycles
 const double K_PHI= 1; // control gains for steering (5 is optimized for gazebo; 1 is optimized for jinx)
 const double K_DISP = 3.0;
 const double K_TRIP_DIST = 1.0;
@@ -57,10 +61,7 @@ public:
 
     // some utilities:
     //signum function: define this one in-line
-    double sgn(double x) { if (x>0.0) {return 1.0; }
-    else if (x<0.0) {return -1.0;}
-    else {return 0.0;}
-    }
+    double sgn(double x) { return planar_geometry::sgn(x); }
 
 private:
     // put private member data here;  "private" data will only be available to member functions of this class;
@@ -72,6 +73,7 @@ private:
     ros::Publisher cmd_publisher_; // = nh.advertise<geometry_msgs::Twist>("cmd_vel",1);
     ros::Publisher cmd_publisher2_; // = nh.advertise<geometry_msgs::TwistStamped>("cmd_vel_stamped",1);
     ros::Publisher steering_errs_publisher_;
+    ros::Publisher odom_latency_publisher_;
     
     ros::ServiceServer simple_service_; //a do-nothing service--but easily modified to be useful
     
@@ -95,6 +97,11 @@ private:
     double odom_phi_;
     geometry_msgs::Quaternion odom_quat_; 
     Eigen::Vector2d odom_xy_vec_;
+
+    // odom history and prediction to control time, compensating for odom latency
+    OdomPredictor odom_predictor_;
+    std_msgs::Float32MultiArray odom_latency_stats_;
+    int n_control_cycles_;
     
     //state values from desired state; these will get filled in by desStateCallback
     nav_msgs::Odometry des_state_; 
@@ -114,6 +121,7 @@ private:
     void initializeSubscribers(); // we will define some helper methods to encapsulate the gory details of initializing subscribers, publishers and services
     void initializePublishers();
     void initializeServices();
+    void spin_once(); // service this object's subscriptions (the constructor waits on odom and tf with this)
  
     void odomCallback(const nav_msgs::Odometry& odom_rcvd);
     void desStateCallback(const nav_msgs::Odometry& des_state_rcvd);    
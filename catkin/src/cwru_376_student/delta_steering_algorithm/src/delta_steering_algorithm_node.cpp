@@ -0,0 +1,25 @@
+//delta_steering_algorithm_node.cpp:
+//runs SteeringController as a stand-alone node; see delta_steering_algorithm_nodelet.cpp to run it in a nodelet manager
+
+#include "delta_steering_algorithm.h"
+
+int main(int argc, char** argv) 
+{
+    // ROS set-ups:
+    ros::init(argc, argv, "steeringController"); //node name
+
+    ros::NodeHandle nh; // create a node handle; need to pass this to the class constructor
+
+    ROS_INFO("main: instantiating an object of type SteeringController");
+    SteeringController steeringController(&nh);  //instantiate an exampleRosClass object and pass in pointer to nodehandle for constructor to use
+    ros::Rate sleep_timer(UPDATE_RATE); //a timer for desired rate, e.g. 50Hz
+   
+    ROS_INFO("starting steering algorithm");
+    while (ros::ok()) {
+        steeringController.my_clever_steering_algorithm(); // compute and publish twist commands and cmd_vel and cmd_vel_stamped
+
+        ros::spinOnce();
+        sleep_timer.sleep();
+    }
+    return 0;
+} 
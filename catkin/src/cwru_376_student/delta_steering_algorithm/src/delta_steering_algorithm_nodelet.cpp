@@ -0,0 +1,49 @@
+//delta_steering_algorithm_nodelet.cpp:
+//runs SteeringController in a nodelet manager, alongside the des state generator nodelet, so desState arrives
+//as a shared pointer, with no serialization or TCP hop
+//same loop as main() in delta_steering_algorithm_node.cpp, in a thread of its own; the subscriptions get a
+//callback queue that only this thread services, so callbacks and control cycles never overlap
+
+#include <boost/thread.hpp>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include "delta_steering_algorithm.h"
+
+namespace delta_steering_algorithm {
+
+class SteeringControllerNodelet : public nodelet::Nodelet {
+public:
+    SteeringControllerNodelet() : running_(false) {}
+    ~SteeringControllerNodelet() {
+        running_ = false;
+        if (control_thread_.joinable()) control_thread_.join();
+    }
+
+private:
+    ros::CallbackQueue queue_;
+    boost::thread control_thread_;
+    volatile bool running_;
+
+    virtual void onInit() {
+        running_ = true;
+        // the constructor blocks until odom and tf arrive, so don't run it in the manager's thread
+        control_thread_ = boost::thread(boost::bind(&SteeringControllerNodelet::run, this));
+    }
+
+    void run() {
+        ros::NodeHandle nh(getNodeHandle());
+        nh.setCallbackQueue(&queue_);
+        SteeringController steeringController(&nh);
+        ros::Rate sleep_timer(UPDATE_RATE);
+        NODELET_INFO("starting steering algorithm");
+        while (running_ && ros::ok()) {
+            steeringController.my_clever_steering_algorithm();
+            queue_.callAvailable();
+            sleep_timer.sleep();
+        }
+    }
+};
+
+} // namespace delta_steering_algorithm
+
+PLUGINLIB_EXPORT_CLASS(delta_steering_algorithm::SteeringControllerNodelet, nodelet::Nodelet)
@@ -0,0 +1,146 @@
+// alarm_voter.h header file //
+// temporal filtering for the lidar alarm: a single noisy scan (dust, a stray return) should not stop the robot
+// each beam keeps the last n of its "too close" decisions as a bit history, with a running count of hits;
+// a beam votes for an obstacle if it was too close in at least k of the last n scans
+// the persistent beams are tallied per sector (contiguous groups of beams), and the alarm has hysteresis:
+// it turns on when some sector has at least on_count voting beams, and off only once every sector is down to off_count
+// per scan, each beam costs O(1): shift in the new bit, adjust the count by (new bit - bit that fell off)
+//
+// also keeps statistics: fraction of scans alarmed, number of alarm onsets, and the latency from the first raw
+// detection of an obstacle to publication of the alarm it caused
+
+#ifndef ALARM_VOTER_H_
+#define ALARM_VOTER_H_
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#include <std_msgs/Float32MultiArray.h>
+
+const int MAX_VOTE_SCANS = 32; // n is limited by the bits in a beam's history word
+const int DETECTION_LATENCY_HISTORY_SIZE = 64; // number of onsets kept for the latency stats
+
+class AlarmVoter {
+public:
+    AlarmVoter(int k, int n, int n_sectors, int on_count, int off_count) : n_beams_(0), alarm_(false),
+            onset_pending_(false), first_hit_time_(-1.0), n_scans_(0), n_alarm_scans_(0), n_raw_hit_scans_(0),
+            n_onsets_(0), i_latency_(0), n_latency_(0) {
+        n_ = std::max(1, std::min(n, MAX_VOTE_SCANS));
+        k_ = std::max(1, std::min(k, n_));
+        n_sectors_ = std::max(1, n_sectors);
+        on_count_ = std::max(1, on_count);
+        off_count_ = std::min(off_count, on_count_ - 1);
+        mask_ = (n_ == 32) ? 0xffffffffu : ((1u << n_) - 1u);
+        sector_count_.resize(n_sectors_);
+        latency_history_.resize(DETECTION_LATENCY_HISTORY_SIZE);
+    }
+
+    // (re)size for a scan of n_beams; clears the beam histories
+    void resize(int n_beams) {
+        n_beams_ = n_beams;
+        history_.assign(n_beams, 0u);
+        votes_.assign(n_beams, 0);
+        sector_of_.resize(n_beams);
+        for (int i = 0; i < n_beams; i++) {
+            sector_of_[i] = (i * n_sectors_) / n_beams;
+        }
+    }
+
+    int size() const { return n_beams_; }
+    bool alarm() const { return alarm_; }
+
+    // fold in one scan's per-beam decisions (hits[i] is 0 or 1) and return the filtered alarm state
+    // t_scan: scan time stamp, sec; used to time the detection latency
+    bool update(const uint8_t* hits, double t_scan) {
+        std::fill(sector_count_.begin(), sector_count_.end(), 0);
+        int n_raw_hits = 0;
+        int oldest_bit = n_ - 1;
+        for (int i = 0; i < n_beams_; i++) {
+            uint32_t hit = hits[i];
+            uint32_t dropped = (history_[i] >> oldest_bit) & 1u;
+            history_[i] = ((history_[i] << 1) | hit) & mask_;
+            votes_[i] += (int) hit - (int) dropped;
+            sector_count_[sector_of_[i]] += (votes_[i] >= k_);
+            n_raw_hits += hit;
+        }
+        int max_sector_count = *std::max_element(sector_count_.begin(), sector_count_.end());
+
+        // remember when the obstacle was first seen, for the latency stats
+        if (n_raw_hits > 0) {
+            if (first_hit_time_ < 0.0) first_hit_time_ = t_scan;
+            n_raw_hit_scans_++;
+        } else if (!alarm_) {
+            first_hit_time_ = -1.0;
+        }
+
+        // hysteresis
+        if (!alarm_ && max_sector_count >= on_count_) {
+            alarm_ = true;
+            onset_pending_ = true;
+            n_onsets_++;
+        } else if (alarm_ && max_sector_count <= off_count_) {
+            alarm_ = false;
+            first_hit_time_ = -1.0;
+        }
+
+        n_scans_++;
+        if (alarm_) n_alarm_scans_++;
+        return alarm_;
+    }
+
+    // call right after publishing the alarm state; if that was an alarm onset, records the detection latency
+    void note_published(double t_publish) {
+        if (!onset_pending_) return;
+        onset_pending_ = false;
+        if (first_hit_time_ < 0.0) return;
+        latency_history_[i_latency_] = t_publish - first_hit_time_;
+        i_latency_ = (i_latency_ + 1) % DETECTION_LATENCY_HISTORY_SIZE;
+        if (n_latency_ < DETECTION_LATENCY_HISTORY_SIZE) n_latency_++;
+    }
+
+    // [fraction of scans alarmed, fraction of scans with any raw hit, number of alarm onsets, number of scans,
+    //  mean and max detection latency (sec) over the last DETECTION_LATENCY_HISTORY_SIZE onsets]
+    void fill_stats(std_msgs::Float32MultiArray& stats) const {
+        stats.data.clear();
+        double n_scans = std::max(n_scans_, 1L);
+        stats.data.push_back(n_alarm_scans_ / n_scans);
+        stats.data.push_back(n_raw_hit_scans_ / n_scans);
+        stats.data.push_back(n_onsets_);
+        stats.data.push_back(n_scans_);
+        double sum = 0.0;
+        double max = 0.0;
+        for (int i = 0; i < n_latency_; i++) {
+            sum += latency_history_[i];
+            max = std::max(max, latency_history_[i]);
+        }
+        stats.data.push_back(n_latency_ > 0 ? sum / n_latency_ : 0.0);
+        stats.data.push_back(max);
+    }
+
+private:
+    int k_;
+    int n_;
+    int n_sectors_;
+    int on_count_;
+    int off_count_;
+    uint32_t mask_;
+    int n_beams_;
+    std::vector<uint32_t> history_; // per beam: bit j set if the beam was too close j scans ago
+    std::vector<int> votes_; // per beam: number of bits set in history_
+    std::vector<int> sector_of_;
+    std::vector<int> sector_count_; // per sector: beams voting for an obstacle, this scan
+    bool alarm_;
+
+    // stats
+    bool onset_pending_;
+    double first_hit_time_; // stamp of the first scan of the current detection; negative if none
+    long n_scans_;
+    long n_alarm_scans_;
+    long n_raw_hit_scans_;
+    long n_onsets_;
+    std::vector<double> latency_history_; // ring buffer of detection latencies
+    int i_latency_;
+    int n_latency_;
+};
+
+#endif  // ALARM_VOTER_H_
@@ -0,0 +1,23 @@
+// allowed_speed.h header file //
+// shared by lidar_alarm and proximity_safety: the highest speed from which the robot can still stop short of an obstacle
+
+#ifndef ALLOWED_SPEED_H_
+#define ALLOWED_SPEED_H_
+
+#include <math.h>
+
+// highest speed from which we can stop stop_margin short of an obstacle "clearance" meters ahead;
+// travel before stopping is v*reaction_time + v^2/(2*brake_decel), so solve that quadratic for v; never more than speed_cap
+inline double allowed_speed_for_clearance(double clearance, double stop_margin, double brake_decel, double reaction_time, double speed_cap)
+{
+    double dist = clearance - stop_margin;
+    if (dist <= 0.0)
+    {
+        return 0.0;
+    }
+    double a_t = brake_decel * reaction_time;
+    double v = -a_t + sqrt(a_t * a_t + 2.0 * brake_decel * dist);
+    return (v < speed_cap) ? v : speed_cap;
+}
+
+#endif  // ALLOWED_SPEED_H_
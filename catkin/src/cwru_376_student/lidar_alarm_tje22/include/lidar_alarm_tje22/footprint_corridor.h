@@ -0,0 +1,168 @@
+// footprint_corridor.h header file //
+// swept-footprint collision check for the lidar alarm
+// instead of a fixed wedge in front of the lidar, sweep the robot's footprint polygon along the arc it is
+// commanded to drive (constant v, omega) for as long as it would take to stop, and alarm on scan points
+// inside the swept area
+//
+// all the geometry happens up front: for every (v, omega) bin and every beam, precompute the range out to
+// which that beam's ray lies inside the swept area; per scan, the check is then one comparison per beam,
+// ranges[i] < limit[i] (see planar_geometry::mark_within_limits)
+//
+// the commanded (v, omega) moves base_link, so the sweep turns about base_link, not the lidar: poses are integrated
+// in base_link, and each beam's ray (from the lidar, set_lidar_pose) is clipped against the footprint at that pose
+// footprint and limits are in the lidar frame (x forward, y left), like the rest of lidar_alarm
+// conservative: a beam's limit is the FARTHEST point where its ray leaves any swept footprint, so a ray that
+// exits the swept area and re-enters further out (possible on tight turns) treats the gap as inside too
+
+#ifndef FOOTPRINT_CORRIDOR_H_
+#define FOOTPRINT_CORRIDOR_H_
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <planar_geometry/scan_geometry.h>
+
+class FootprintCorridor {
+public:
+    // footprint: convex polygon, counter-clockwise (x, y) vertices in the lidar frame
+    // lidar_x, lidar_y, lidar_yaw: the lidar's pose in base_link (the base_link -> lidar transform)
+    // v_max, v_step, omega_max, omega_step: command bins to precompute (v from 0 to v_max, omega from -omega_max to omega_max)
+    // brake_decel, reaction_time, min_horizon: the sweep lasts reaction_time + v/brake_decel, but at least min_horizon
+    FootprintCorridor(const std::vector<double>& footprint_x, const std::vector<double>& footprint_y,
+            double v_max, double v_step, double omega_max, double omega_step,
+            double brake_decel, double reaction_time, double min_horizon,
+            double lidar_x, double lidar_y, double lidar_yaw)
+    : lidar_fx_(footprint_x), lidar_fy_(footprint_y), v_step_(v_step), omega_step_(omega_step),
+      brake_decel_(brake_decel), reaction_time_(reaction_time), min_horizon_(min_horizon), n_beams_(0) {
+        n_v_ = (int) ceil(v_max / v_step) + 1;
+        n_omega_half_ = (int) ceil(omega_max / omega_step);
+        set_lidar_pose(lidar_x, lidar_y, lidar_yaw);
+    }
+
+    // where the lidar sits on the robot; takes effect at the next build()
+    void set_lidar_pose(double lidar_x, double lidar_y, double lidar_yaw) {
+        lidar_x_ = lidar_x;
+        lidar_y_ = lidar_y;
+        lidar_yaw_ = lidar_yaw;
+        // the footprint in base_link, where the sweep is integrated
+        double c = cos(lidar_yaw), s = sin(lidar_yaw);
+        fx_.resize(lidar_fx_.size());
+        fy_.resize(lidar_fy_.size());
+        for (size_t j = 0; j < lidar_fx_.size(); j++) {
+            fx_[j] = c * lidar_fx_[j] - s * lidar_fy_[j] + lidar_x;
+            fy_[j] = s * lidar_fx_[j] + c * lidar_fy_[j] + lidar_y;
+        }
+    }
+
+    // build the per-beam limits for every command bin; call whenever the scan layout changes
+    // (a few hundred ms for a 1080-beam scan; nothing is computed per scan)
+    void build(const planar_geometry::ScanGeometry& geometry, double max_range) {
+        n_beams_ = geometry.size();
+        int n_bins = n_v_ * (2 * n_omega_half_ + 1);
+        limits_.assign(n_bins * n_beams_, 0.0f);
+        for (int i_v = 0; i_v < n_v_; i_v++) {
+            for (int i_w = -n_omega_half_; i_w <= n_omega_half_; i_w++) {
+                build_bin(geometry, max_range, i_v * v_step_, i_w * omega_step_, &limits_[bin_index(i_v, i_w) * n_beams_]);
+            }
+        }
+    }
+
+    // per-beam range limits for a command; v is rounded UP to the next bin, omega to the nearest
+    // backing up (v < 0) is treated as v = 0: the forward-facing lidar can't see behind anyway
+    const float* limits(double v, double omega) const {
+        int i_v = (v <= 0.0) ? 0 : (int) ceil(v / v_step_ - 1e-6);
+        if (i_v >= n_v_) i_v = n_v_ - 1;
+        int i_w = (int) floor(omega / omega_step_ + 0.5);
+        if (i_w > n_omega_half_) i_w = n_omega_half_;
+        if (i_w < -n_omega_half_) i_w = -n_omega_half_;
+        return &limits_[bin_index(i_v, i_w) * n_beams_];
+    }
+
+private:
+    std::vector<double> lidar_fx_; // footprint as given, in the lidar frame
+    std::vector<double> lidar_fy_;
+    std::vector<double> fx_; // the same footprint in base_link
+    std::vector<double> fy_;
+    double lidar_x_;
+    double lidar_y_;
+    double lidar_yaw_;
+    double v_step_;
+    double omega_step_;
+    double brake_decel_;
+    double reaction_time_;
+    double min_horizon_;
+    int n_v_;
+    int n_omega_half_;
+    int n_beams_;
+    std::vector<float> limits_; // [bin][beam]
+
+    int bin_index(int i_v, int i_w) const { return i_v * (2 * n_omega_half_ + 1) + (i_w + n_omega_half_); }
+
+    void build_bin(const planar_geometry::ScanGeometry& geometry, double max_range, double v, double omega, float* limits) {
+        double horizon = reaction_time_ + v / brake_decel_;
+        if (horizon < min_horizon_) horizon = min_horizon_;
+        // sample poses along the arc finely enough that consecutive footprints overlap: <= 5 cm and <= 0.05 rad apart
+        int n_poses = (int) ceil(std::max(v * horizon, fabs(omega) * horizon) / 0.05) + 1;
+        double dt = horizon / n_poses;
+
+        for (int i = 0; i < n_beams_; i++) {
+            limits[i] = 0.0f;
+        }
+        for (int k = 0; k <= n_poses; k++) {
+            // base_link's unicycle pose after time t, in its starting frame
+            double t = k * dt;
+            double theta = omega * t;
+            double px, py;
+            if (fabs(omega) < 1e-6) {
+                px = v * t;
+                py = 0.0;
+            } else {
+                px = v / omega * sin(theta);
+                py = v / omega * (1.0 - cos(theta));
+            }
+            double c = cos(theta);
+            double s = sin(theta);
+            // each beam is a ray from the lidar (fixed where it started, at lidar_x_, lidar_y_ in the starting base_link
+            // frame); express it in base_link at this pose, where the footprint is
+            double ox = c * (lidar_x_ - px) + s * (lidar_y_ - py);
+            double oy = -s * (lidar_x_ - px) + c * (lidar_y_ - py);
+            double cr = cos(lidar_yaw_ - theta);
+            double sr = sin(lidar_yaw_ - theta);
+            const float* cos_table = geometry.cos_table();
+            const float* sin_table = geometry.sin_table();
+            for (int i = 0; i < n_beams_; i++) {
+                double dx = cr * cos_table[i] - sr * sin_table[i];
+                double dy = sr * cos_table[i] + cr * sin_table[i];
+                double r_exit = ray_exit(ox, oy, dx, dy);
+                if (r_exit > max_range) r_exit = max_range;
+                if (r_exit > limits[i]) limits[i] = r_exit;
+            }
+        }
+    }
+
+    // distance along the ray (o + r*d, r >= 0) at which it leaves the convex footprint; 0 if it misses it
+    // (Cyrus-Beck clipping against each edge)
+    double ray_exit(double ox, double oy, double dx, double dy) const {
+        double r_enter = 0.0;
+        double r_exit = 1e9;
+        int n = fx_.size();
+        for (int j = 0; j < n; j++) {
+            int j_next = (j + 1) % n;
+            // outward normal of a counter-clockwise edge
+            double nx = fy_[j_next] - fy_[j];
+            double ny = -(fx_[j_next] - fx_[j]);
+            double num = nx * (fx_[j] - ox) + ny * (fy_[j] - oy); // >= 0 if the ray origin is inside this edge
+            double den = nx * dx + ny * dy;
+            if (fabs(den) < 1e-12) {
+                if (num < 0.0) return 0.0; // parallel to and outside this edge
+            } else if (den < 0.0) {
+                r_enter = std::max(r_enter, num / den); // heading in through this edge
+            } else {
+                r_exit = std::min(r_exit, num / den); // heading out through this edge
+            }
+        }
+        return (r_enter <= r_exit) ? r_exit : 0.0;
+    }
+};
+
+#endif  // FOOTPRINT_CORRIDOR_H_
@@ -5,8 +5,19 @@
 #include <std_msgs/Float32.h>
 // boolean message time
 #include <std_msgs/Bool.h>
+// precomputed per-ping cos/sin tables
+#include <planar_geometry/scan_geometry.h>
+// per-sector allowed speeds
+#include <std_msgs/Float32MultiArray.h>
+// commanded speed/spin, for the footprint corridor
+#include <geometry_msgs/Twist.h>
+#include <lidar_alarm_tje22/footprint_corridor.h>
+// k-of-n voting and hysteresis
+#include <lidar_alarm_tje22/alarm_voter.h>
+#include <lidar_alarm_tje22/allowed_speed.h>
 // we need to be able to math!
 #include <math.h>
+#include <vector>
 
 
 // set alarm if anything is within 0.5m of the front of robot
@@ -14,6 +25,44 @@ const double MIN_SAFE_DISTANCE = 2.0;
 const double ALLOWABLE_CLOSE_PINGS = 2;
 const double FIELD_OF_VIEW = 30;
 
+// allowed-speed signal: instead of just stop/go, publish the fastest speed from which the robot can still stop
+// short of the nearest obstacle in its path; schedulers scale their speed limits by it
+const double ROBOT_HALF_WIDTH = 0.35; // m; half the width of the corridor the robot sweeps, plus a little clearance
+const double STOP_MARGIN = 0.5; // m; want to come to rest at least this far from an obstacle
+const double BRAKE_DECEL = 0.3; // m/sec^2; decel the schedulers use when braking for an obstacle
+const double REACTION_TIME = 0.2; // sec; scan age + scheduler update + command latency, before braking starts
+const double ALLOWED_SPEED_CAP = 1.0; // m/sec; reported when the path is clear
+const int N_SPEED_SECTORS = 7; // headings evaluated for the per-sector signal
+const double SECTOR_SPAN = 60; // deg; sectors are centered from -SECTOR_SPAN (right) to +SECTOR_SPAN (left)
+
+// footprint corridor mode (set param ~footprint_corridor true): instead of the FIELD_OF_VIEW wedge, alarm on scan points
+// inside the area the robot's footprint sweeps along its commanded arc (from /cmd_vel) before it could stop
+// footprint, counter-clockwise, in the lidar frame (x forward, y left); the lidar sits at the front of the robot
+const double FOOTPRINT_X[] = {0.1, 0.1, -0.55, -0.55};
+const double FOOTPRINT_Y[] = {-0.3, 0.3, 0.3, -0.3};
+const int N_FOOTPRINT = 4;
+const double CORRIDOR_V_MAX = 1.0; // m/sec; faster commands are checked as if at this speed
+const double CORRIDOR_V_STEP = 0.1; // m/sec; command bins precomputed; speeds are rounded up to the next bin
+const double CORRIDOR_OMEGA_MAX = 1.0; // rad/sec
+const double CORRIDOR_OMEGA_STEP = 0.1; // rad/sec
+const double CORRIDOR_MIN_HORIZON = 0.5; // sec; sweep at least this far ahead, even when stopped
+// the lidar's place on the robot (base_link -> base_laser1_link, as in cwru_configs/jinx/base/static_transform.launch);
+// the sweep turns about base_link. Private params ~lidar_x, ~lidar_y, ~lidar_yaw override these
+const double LIDAR_X = 0.2159; // m
+const double LIDAR_Y = 0.0; // m
+const double LIDAR_YAW = 0.0; // rad
+
+// temporal filtering: a beam counts only if it was too close in VOTE_K of the last VOTE_N scans; the alarm turns on when
+// a sector has ALARM_ON_PINGS such beams, and off only when every sector is down to ALARM_OFF_PINGS
+// (VOTE_K = VOTE_N = 1, VOTE_SECTORS = 1, ALARM_ON_PINGS = ALLOWABLE_CLOSE_PINGS + 1, ALARM_OFF_PINGS = ALLOWABLE_CLOSE_PINGS
+// gives back the unfiltered single-scan alarm); each can be overridden by the private param of the same name, lower case
+const int VOTE_K = 3;
+const int VOTE_N = 5;
+const int VOTE_SECTORS = 1; // sectors across the whole scan; more sectors need the pings bunched together, so alarm less
+const int ALARM_ON_PINGS = ALLOWABLE_CLOSE_PINGS + 1;
+const int ALARM_OFF_PINGS = 0;
+const int STATS_DECIMATION = 40; // publish alarm stats once per this many scans
+
 // these values to be set within the laser callback
 // global var to hold length of a SINGLE LIDAR ping--in front
 double ping_dist_in_front_ = 3.0;
@@ -28,11 +77,33 @@ double range_min_ = 0.0;
 double range_max_ = 0.0;
 double points_per_degree = -1;
 bool laser_alarm_ = false;
+planar_geometry::ScanGeometry scan_geometry_; // cos/sin of every ping angle; rebuilt only if the scan layout changes
+
+bool use_footprint_corridor_ = false;
+FootprintCorridor footprint_corridor_(std::vector<double>(FOOTPRINT_X, FOOTPRINT_X + N_FOOTPRINT), std::vector<double>(FOOTPRINT_Y, FOOTPRINT_Y + N_FOOTPRINT),
+                                      CORRIDOR_V_MAX, CORRIDOR_V_STEP, CORRIDOR_OMEGA_MAX, CORRIDOR_OMEGA_STEP,
+                                      BRAKE_DECEL, REACTION_TIME, CORRIDOR_MIN_HORIZON, LIDAR_X, LIDAR_Y, LIDAR_YAW);
+double cmd_vel_ = 0.0; // latest commanded speed and spin
+double cmd_omega_ = 0.0;
+
+AlarmVoter *alarm_voter_; // built in main, once the params are read
+std::vector<uint8_t> hits_; // this scan's per-beam "too close" decisions
+std_msgs::Float32MultiArray alarm_stats_;
+ros::Publisher alarm_stats_publisher_;
 
 double pi = 3.14159653;
 
 ros::Publisher lidar_alarm_publisher_;
 ros::Publisher lidar_dist_publisher_;
+ros::Publisher allowed_speed_publisher_;
+ros::Publisher allowed_speed_sectors_publisher_;
+
+// corridor headings: the N_SPEED_SECTORS sectors, right to left, then straight ahead; filled in once, in main
+const int N_HEADINGS = N_SPEED_SECTORS + 1;
+double heading_cos_[N_HEADINGS];
+double heading_sin_[N_HEADINGS];
+double heading_clearance_[N_HEADINGS]; // per scan
+std_msgs::Float32MultiArray allowed_speed_sectors_msg_; // sized once, in main
 
 double rad_to_deg(float rad)
 {
@@ -44,21 +115,87 @@ double deg_to_rad(float deg)
 	return deg / 180 * pi;
 }
 
-double index_to_deg_off_x(int index)
+// highest speed from which we can stop STOP_MARGIN short of an obstacle "clearance" meters ahead
+double allowed_speed_for_clearance(double clearance)
 {
-	return (index - ping_index_) / points_per_degree;
+    return allowed_speed_for_clearance(clearance, STOP_MARGIN, BRAKE_DECEL, REACTION_TIME, ALLOWED_SPEED_CAP);
 }
 
-double index_to_rad_off_x(int index)
+// sector k is centered at heading -SECTOR_SPAN + k*(2*SECTOR_SPAN/(N_SPEED_SECTORS-1)), i.e. right to left
+void init_corridor_headings()
 {
-	return deg_to_rad(index_to_deg_off_x(index));
+    for (int k = 0; k < N_HEADINGS; k++)
+    {
+        double heading = (k < N_SPEED_SECTORS) ? deg_to_rad(-SECTOR_SPAN + k * (2.0 * SECTOR_SPAN / (N_SPEED_SECTORS - 1))) : 0.0;
+        heading_cos_[k] = cos(heading);
+        heading_sin_[k] = sin(heading);
+    }
+    allowed_speed_sectors_msg_.data.resize(N_SPEED_SECTORS);
+}
+
+// distance to the nearest scan point inside a robot-width corridor along each heading, in one pass over the scan
+void corridor_clearances(const sensor_msgs::LaserScan &laser_scan)
+{
+    for (int k = 0; k < N_HEADINGS; k++)
+    {
+        heading_clearance_[k] = range_max_;
+    }
+    const float *cos_table = scan_geometry_.cos_table();
+    const float *sin_table = scan_geometry_.sin_table();
+    for (int i = 0; i < laser_scan.ranges.size(); i++)
+    {
+        double range = laser_scan.ranges[i];
+        if (!(range >= range_min_ && range <= range_max_))
+        {
+            continue; // no return (inf/nan) or out of spec
+        }
+        // the point in the lidar frame, x forward, y left
+        double x = range * cos_table[i];
+        double y = range * sin_table[i];
+        for (int k = 0; k < N_HEADINGS; k++)
+        {
+            // rotate the point into the corridor frame
+            double along = x * heading_cos_[k] + y * heading_sin_[k];
+            double across = -x * heading_sin_[k] + y * heading_cos_[k];
+            if (along > 0.0 && fabs(across) < ROBOT_HALF_WIDTH && along < heading_clearance_[k])
+            {
+                heading_clearance_[k] = along;
+            }
+        }
+    }
+}
+
+// publish the allowed speed straight ahead, and for each heading sector
+void publish_allowed_speeds(const sensor_msgs::LaserScan &laser_scan)
+{
+    corridor_clearances(laser_scan);
+
+    std_msgs::Float32 allowed_speed_msg;
+    allowed_speed_msg.data = allowed_speed_for_clearance(heading_clearance_[N_SPEED_SECTORS]);
+    allowed_speed_publisher_.publish(allowed_speed_msg);
+
+    for (int k = 0; k < N_SPEED_SECTORS; k++)
+    {
+        allowed_speed_sectors_msg_.data[k] = allowed_speed_for_clearance(heading_clearance_[k]);
+    }
+    allowed_speed_sectors_publisher_.publish(allowed_speed_sectors_msg_);
+}
+
+void cmdVelCallback(const geometry_msgs::Twist &cmd_vel)
+{
+    cmd_vel_ = cmd_vel.linear.x;
+    cmd_omega_ = cmd_vel.angular.z;
 }
 
 void laserCallback(const sensor_msgs::LaserScan &laser_scan)
 {
-    if (ping_index_ < 0)
+    if (laser_scan.ranges.empty())
     {
-        //for first message received, set up the desired index of LIDAR range to eval
+        return;
+    }
+    if (scan_geometry_.update(laser_scan.angle_min, laser_scan.angle_increment, laser_scan.ranges.size()))
+    {
+        //for first message received (or if the scan layout changes), set up the angle tables and the indices of LIDAR ranges to eval
         angle_min_ = laser_scan.angle_min;
         angle_max_ = laser_scan.angle_max;
         angle_increment_ = laser_scan.angle_increment;
@@ -67,11 +204,10 @@ void laserCallback(const sensor_msgs::LaserScan &laser_scan)
         // what is the index of the ping that is straight ahead?
         // BETTER would be to use transforms, which would reference how the LIDAR is mounted;
         // but this will do for simple illustration
-        ping_index_ = (int)((angle_max_ - angle_min_) / angle_increment_) / 2;
-        points_per_degree = ((ping_index_ * 2) / rad_to_deg(angle_max_ - angle_min_));
-        int consider_pings_one_side = points_per_degree * (FIELD_OF_VIEW / 2);
-        ping_low_limit_index_ = ping_index_ - consider_pings_one_side;
-        ping_high_limit_index_ = ping_index_ + consider_pings_one_side;
+        ping_index_ = scan_geometry_.index_of(0.0);
+        points_per_degree = 1.0 / rad_to_deg(angle_increment_);
+        ping_low_limit_index_ = scan_geometry_.index_of(deg_to_rad(-FIELD_OF_VIEW / 2));
+        ping_high_limit_index_ = scan_geometry_.index_of(deg_to_rad(FIELD_OF_VIEW / 2));
 
         // Print out some debug info
         ROS_INFO("LIDAR setup: ping_index = %d", ping_index_);
@@ -80,40 +216,59 @@ void laserCallback(const sensor_msgs::LaserScan &laser_scan)
         ROS_INFO("LIDAR setup: angle_inc = %lfdeg", rad_to_deg(angle_increment_));
         ROS_INFO("LIDAR setup: points per degree = %lf", points_per_degree);
         ROS_INFO("LIDAR setup: checking indicies %d through %d", ping_low_limit_index_, ping_high_limit_index_);
+        if (use_footprint_corridor_)
+        {
+            ROS_INFO("LIDAR setup: precomputing swept footprint corridors");
+            footprint_corridor_.build(scan_geometry_, range_max_);
+        }
     }
 
-    ping_dist_in_front_ = laser_scan.ranges[ping_index_];
-    int too_close_count = 0;
-    for (int i = ping_low_limit_index_; i < ping_high_limit_index_; i++)
+    const float *ranges = &laser_scan.ranges[0];
+    const float *cos_table = scan_geometry_.cos_table();
+    int n_pings = laser_scan.ranges.size();
+    if (alarm_voter_->size() != n_pings)
     {
-    	double ping_dist_in_front_ = laser_scan.ranges[i];
-    	double cos_distance = ping_dist_in_front_ * std::cos(index_to_rad_off_x(i));
-    	if (!std::isinf(ping_dist_in_front_))
-    	{
-		    //ROS_INFO("ping dist %lf at angle %lfdeg", ping_dist_in_front_, index_to_deg_off_x(i));
-    	}
-        if (cos_distance < MIN_SAFE_DISTANCE)
-        {
-            ROS_WARN("There appears to be something in front of us, %lfdeg off center, %lfm away in x", index_to_deg_off_x(i), cos_distance);
-            if (++too_close_count > ALLOWABLE_CLOSE_PINGS)
-            {
-                ROS_WARN("DANGER, WILL ROBINSON!!");
-                laser_alarm_ = true;
-                break;
-            }
-        }
-        else
-        {
-            laser_alarm_ = false;
-        }
+        alarm_voter_->resize(n_pings);
+        hits_.assign(n_pings, 0);
+    }
+    // decide "too close" for every beam: one branch-free pass over the ranges, no trig
+    if (use_footprint_corridor_)
+    {
+        // pings inside the footprint's sweep along the commanded arc; the per-beam limits were precomputed
+        planar_geometry::mark_within_limits(ranges, footprint_corridor_.limits(cmd_vel_, cmd_omega_), 0, n_pings, range_min_, &hits_[0]);
+    }
+    else
+    {
+        // pings in the field of view that are closer than MIN_SAFE_DISTANCE in x
+        planar_geometry::mark_closer_in_x(ranges, cos_table, ping_low_limit_index_, ping_high_limit_index_, MIN_SAFE_DISTANCE, &hits_[0]);
+    }
+
+    // vote over the last few scans, with hysteresis
+    bool last_alarm = laser_alarm_;
+    laser_alarm_ = alarm_voter_->update(&hits_[0], laser_scan.header.stamp.toSec());
+    if (laser_alarm_ && !last_alarm)
+    {
+        ROS_WARN("DANGER, WILL ROBINSON!! obstacle confirmed over the last few scans");
+    }
+    else if (!laser_alarm_ && last_alarm)
+    {
+        ROS_INFO("lidar alarm cleared");
     }
     ping_dist_in_front_ = laser_scan.ranges[ping_index_];
     std_msgs::Bool lidar_alarm_msg;
     lidar_alarm_msg.data = laser_alarm_;
     lidar_alarm_publisher_.publish(lidar_alarm_msg);
+    alarm_voter_->note_published(ros::Time::now().toSec());
+    static int n_scans = 0;
+    if (++n_scans % STATS_DECIMATION == 0)
+    {
+        alarm_voter_->fill_stats(alarm_stats_);
+        alarm_stats_publisher_.publish(alarm_stats_);
+    }
     std_msgs::Float32 lidar_dist_msg;
     lidar_dist_msg.data = ping_dist_in_front_;
     lidar_dist_publisher_.publish(lidar_dist_msg);
+    publish_allowed_speeds(laser_scan);
 }
 
 int main(int argc, char **argv)
@@ -123,13 +278,37 @@ int main(int argc, char **argv)
 
     ROS_INFO("LIDAR setup: Attempting to start");
     ros::NodeHandle nh;
+    ros::NodeHandle nh_private("~");
+    nh_private.getParam("footprint_corridor", use_footprint_corridor_);
+    ROS_INFO("LIDAR setup: footprint corridor mode is %s", use_footprint_corridor_ ? "on" : "off");
+    double lidar_x, lidar_y, lidar_yaw;
+    nh_private.param("lidar_x", lidar_x, LIDAR_X);
+    nh_private.param("lidar_y", lidar_y, LIDAR_Y);
+    nh_private.param("lidar_yaw", lidar_yaw, LIDAR_YAW);
+    footprint_corridor_.set_lidar_pose(lidar_x, lidar_y, lidar_yaw);
+    int vote_k, vote_n, vote_sectors, alarm_on_pings, alarm_off_pings;
+    nh_private.param("vote_k", vote_k, VOTE_K);
+    nh_private.param("vote_n", vote_n, VOTE_N);
+    nh_private.param("vote_sectors", vote_sectors, VOTE_SECTORS);
+    nh_private.param("alarm_on_pings", alarm_on_pings, ALARM_ON_PINGS);
+    nh_private.param("alarm_off_pings", alarm_off_pings, ALARM_OFF_PINGS);
+    alarm_voter_ = new AlarmVoter(vote_k, vote_n, vote_sectors, alarm_on_pings, alarm_off_pings);
+    ROS_INFO("LIDAR setup: alarm needs %d of %d scans, on at %d pings per sector, off at %d", vote_k, vote_n, alarm_on_pings, alarm_off_pings);
     //create a Subscriber object and have it subscribe to the lidar topic
     ros::Publisher pub = nh.advertise<std_msgs::Bool>("/lidar_alarm", 1);
     // let's make this global, so callback can use it
     lidar_alarm_publisher_ = pub;
     ros::Publisher pub2 = nh.advertise<std_msgs::Float32>("/lidar_dist", 1);
     lidar_dist_publisher_ = pub2;
+    // m/sec; highest speed at which we can still stop short of what is ahead
+    allowed_speed_publisher_ = nh.advertise<std_msgs::Float32>("/lidar_allowed_speed", 1);
+    // same, for N_SPEED_SECTORS headings from right to left
+    allowed_speed_sectors_publisher_ = nh.advertise<std_msgs::Float32MultiArray>("/lidar_allowed_speed_sectors", 1);
+    init_corridor_headings();
+    // [fraction of scans alarmed, fraction with raw hits, alarm onsets, scans, mean and max latency from first detection to alarm]
+    alarm_stats_publisher_ = nh.advertise<std_msgs::Float32MultiArray>("/lidar_alarm_stats", 1);
     ros::Subscriber lidar_subscriber = nh.subscribe("/base_laser1_scan", 1, laserCallback);
+    ros::Subscriber cmd_vel_subscriber = nh.subscribe("/cmd_vel", 1, cmdVelCallback);
     //this is essentially a "while(1)" statement, except it
     // forces refreshing wakeups upon new data arrival
     // main program essentially hangs here, but it must stay alive to keep the callback function alive
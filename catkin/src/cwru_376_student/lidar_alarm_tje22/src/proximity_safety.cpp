@@ -0,0 +1,201 @@
+//proximity_safety.cpp:
+//fuses the cRIO sonars and the lidar into one polar buffer around base_link, and publishes
+///lidar_alarm and /lidar_allowed_speed from it; a drop-in replacement for lidar_alarm_tje22
+
+// this header incorporates all the necessary #include files and defines the class "ProximitySafety"
+#include "proximity_safety.h"
+
+//CONSTRUCTOR: sizes all the buffers, so the callbacks never allocate
+ProximitySafety::ProximitySafety(ros::NodeHandle* nodehandle) : nh_(*nodehandle), n_sonar_pings_in_packet_(0),
+        sonar_array_seen_(false) {
+    ROS_INFO("in class constructor of ProximitySafety");
+
+    lidar_pose_.valid = false;
+    for (int i = 0; i < N_SONARS; i++) {
+        sonar_pose_[i].valid = false;
+        sonar_layer_[i].n_samples = 0;
+        char frame_id[16];
+        snprintf(frame_id, sizeof(frame_id), "sonar_%d_link", i + 1);
+        sonar_frame_[i] = frame_id;
+    }
+    for (int b = 0; b < N_POLAR_BINS; b++) {
+        double angle = -M_PI + (b + 0.5) * POLAR_BIN_WIDTH; // center of the bin
+        bin_cos_[b] = cos(angle);
+        bin_sin_[b] = sin(angle);
+        lidar_range_[b] = INFINITY;
+    }
+    // sample a sonar's cone about once per bin, edges included
+    n_cone_samples_ = MAX_SONAR_SAMPLES;
+    for (int k = 0; k < n_cone_samples_; k++) {
+        double angle = -SONAR_HALF_ANGLE + k * 2.0 * SONAR_HALF_ANGLE / (n_cone_samples_ - 1);
+        sonar_cone_cos_[k] = cos(angle);
+        sonar_cone_sin_[k] = sin(angle);
+    }
+
+    initializeSubscribers();
+    initializePublishers();
+}
+
+void ProximitySafety::initializeSubscribers() {
+    ROS_INFO("Initializing Subscribers");
+    scan_subscriber_ = nh_.subscribe("/base_laser1_scan", 1, &ProximitySafety::scanCallback, this);
+    for (int i = 0; i < N_SONARS; i++) {
+        char topic[16];
+        snprintf(topic, sizeof(topic), "sonar_%d", i + 1);
+        sonar_subscriber_[i] = nh_.subscribe<cwru_msgs::Sonar>(topic, N_SONARS,
+                boost::bind(&ProximitySafety::sonarCallback, this, _1, i));
+    }
+    // crio_receiver publishes the pings here instead with ~sonar_output:=array
+    sonar_array_subscriber_ = nh_.subscribe("sonar_array", 1, &ProximitySafety::sonarArrayCallback, this);
+}
+
+void ProximitySafety::initializePublishers() {
+    ROS_INFO("Initializing Publishers");
+    alarm_publisher_ = nh_.advertise<std_msgs::Bool>("lidar_alarm", 1);
+    allowed_speed_publisher_ = nh_.advertise<std_msgs::Float32>("lidar_allowed_speed", 1);
+    latency_publisher_ = nh_.advertise<std_msgs::Float32>("proximity_safety_latency", 1);
+}
+
+bool ProximitySafety::lookup_sensor_pose(const std::string& frame_id, SensorPose& pose) {
+    if (pose.valid) return true;
+    tf::StampedTransform transform;
+    try {
+        tf_listener_.lookupTransform(BASE_FRAME, frame_id, ros::Time(0), transform);
+    } catch (tf::TransformException &exception) {
+        // not published yet; this sensor is left out until it is
+        ROS_WARN_THROTTLE(2.0, "no tf from %s to %s yet: %s", BASE_FRAME.c_str(), frame_id.c_str(), exception.what());
+        return false;
+    }
+    pose.x = transform.getOrigin().x();
+    pose.y = transform.getOrigin().y();
+    pose.yaw = tf::getYaw(transform.getRotation());
+    pose.valid = true;
+    ROS_INFO("%s is at (%f, %f), yaw %f in %s", frame_id.c_str(), pose.x, pose.y, pose.yaw, BASE_FRAME.c_str());
+    return true;
+}
+
+// bin holding the bearing of point (x, y) in base_link
+int ProximitySafety::bin_of(double x, double y) const {
+    int b = (int) ((planar_geometry::fast_atan2(y, x) + M_PI) / POLAR_BIN_WIDTH);
+    if (b < 0) return 0;
+    if (b >= N_POLAR_BINS) return N_POLAR_BINS - 1;
+    return b;
+}
+
+void ProximitySafety::scanCallback(const sensor_msgs::LaserScan::ConstPtr& scan) {
+    if (!lookup_sensor_pose(scan->header.frame_id, lidar_pose_)) return;
+    scan_geometry_.update(scan->angle_min, scan->angle_increment, scan->ranges.size());
+
+    // rebuild the lidar layer: each valid ping into the bin of its bearing from base_link
+    const float* cos_table = scan_geometry_.cos_table();
+    const float* sin_table = scan_geometry_.sin_table();
+    double c = cos(lidar_pose_.yaw);
+    double s = sin(lidar_pose_.yaw);
+    for (int b = 0; b < N_POLAR_BINS; b++) {
+        lidar_range_[b] = INFINITY;
+    }
+    int n_pings = scan->ranges.size();
+    for (int i = 0; i < n_pings; i++) {
+        float r = scan->ranges[i];
+        if (!(r >= scan->range_min && r <= scan->range_max)) continue; // also drops NaN
+        double px = r * cos_table[i];
+        double py = r * sin_table[i];
+        double x = lidar_pose_.x + c * px - s * py;
+        double y = lidar_pose_.y + s * px + c * py;
+        int b = bin_of(x, y);
+        float range = sqrt(x * x + y * y);
+        if (range < lidar_range_[b]) lidar_range_[b] = range;
+    }
+    lidar_stamp_ = scan->header.stamp;
+    fuse_and_publish(scan->header.stamp);
+}
+
+void ProximitySafety::update_sonar_layer(int i_sonar, const std::string& frame_id, const ros::Time& stamp,
+        double dist) {
+    SonarLayer& layer = sonar_layer_[i_sonar];
+    if (!lookup_sensor_pose(frame_id, sonar_pose_[i_sonar])) return;
+    const SensorPose& pose = sonar_pose_[i_sonar];
+    layer.n_samples = 0;
+    layer.stamp = stamp;
+    if (dist >= SONAR_MIN_RANGE && dist <= SONAR_MAX_RANGE) {
+        // the echo could have come from anywhere across the cone: mark the whole arc at range dist
+        double c = cos(pose.yaw);
+        double s = sin(pose.yaw);
+        for (int k = 0; k < n_cone_samples_; k++) {
+            double px = dist * sonar_cone_cos_[k];
+            double py = dist * sonar_cone_sin_[k];
+            double x = pose.x + c * px - s * py;
+            double y = pose.y + s * px + c * py;
+            layer.bin[k] = bin_of(x, y);
+            layer.range[k] = sqrt(x * x + y * y);
+        }
+        layer.n_samples = n_cone_samples_;
+    }
+}
+
+void ProximitySafety::sonarCallback(const cwru_msgs::Sonar::ConstPtr& ping, int i_sonar) {
+    if (sonar_array_seen_) return;
+    update_sonar_layer(i_sonar, ping->header.frame_id, ping->header.stamp, ping->dist);
+
+    // all sonars of a packet are stamped alike; publish once per packet, when its last ping is in
+    if (ping->header.stamp != sonar_packet_stamp_) {
+        sonar_packet_stamp_ = ping->header.stamp;
+        n_sonar_pings_in_packet_ = 0;
+    }
+    n_sonar_pings_in_packet_++;
+    if (n_sonar_pings_in_packet_ == N_SONARS) {
+        fuse_and_publish(sonar_packet_stamp_);
+    }
+}
+
+// the whole packet in one message: no counting, publish right away
+void ProximitySafety::sonarArrayCallback(const cwru_msgs::SonarArray::ConstPtr& pings) {
+    sonar_array_seen_ = true;
+    int n_pings = pings->dist.size();
+    if (n_pings > N_SONARS) n_pings = N_SONARS;
+    for (int i = 0; i < n_pings; i++) {
+        update_sonar_layer(i, sonar_frame_[i], pings->header.stamp, pings->dist[i]);
+    }
+    fuse_and_publish(pings->header.stamp);
+}
+
+void ProximitySafety::fuse_and_publish(const ros::Time& stamp) {
+    ros::Time now = ros::Time::now();
+    bool lidar_fresh = lidar_pose_.valid && (now - lidar_stamp_).toSec() < SENSOR_TIMEOUT;
+    for (int b = 0; b < N_POLAR_BINS; b++) {
+        fused_range_[b] = lidar_fresh ? lidar_range_[b] : INFINITY;
+    }
+    for (int i = 0; i < N_SONARS; i++) {
+        const SonarLayer& layer = sonar_layer_[i];
+        if ((now - layer.stamp).toSec() >= SENSOR_TIMEOUT) continue;
+        for (int k = 0; k < layer.n_samples; k++) {
+            if (layer.range[k] < fused_range_[layer.bin[k]]) fused_range_[layer.bin[k]] = layer.range[k];
+        }
+    }
+
+    // clearance ahead of the front of the robot, within the corridor it sweeps driving straight
+    double clearance = INFINITY;
+    for (int b = 0; b < N_POLAR_BINS; b++) {
+        double x = fused_range_[b] * bin_cos_[b];
+        double y = fused_range_[b] * bin_sin_[b];
+        if (x > 0.0 && fabs(y) < ROBOT_HALF_WIDTH && x - ROBOT_FRONT < clearance) {
+            clearance = x - ROBOT_FRONT;
+        }
+    }
+
+    double allowed_speed = allowed_speed_for_clearance(clearance, STOP_MARGIN, BRAKE_DECEL, REACTION_TIME, ALLOWED_SPEED_CAP);
+    if (!lidar_fresh) {
+        // the sonars alone only see a few narrow cones; don't call the path clear on their word
+        ROS_WARN_THROTTLE(2.0, "no recent lidar scan; holding allowed speed at zero");
+        allowed_speed = 0.0;
+    }
+    alarm_msg_.data = (allowed_speed <= 0.0);
+    allowed_speed_msg_.data = allowed_speed;
+    alarm_publisher_.publish(alarm_msg_);
+    allowed_speed_publisher_.publish(allowed_speed_msg_);
+    latency_msg_.data = (ros::Time::now() - stamp).toSec();
+    latency_publisher_.publish(latency_msg_);
+    if (alarm_msg_.data) {
+        ROS_WARN_THROTTLE(1.0, "proximity alarm: %f m clear ahead", clearance);
+    }
+}
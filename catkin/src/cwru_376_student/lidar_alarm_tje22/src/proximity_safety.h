@@ -0,0 +1,129 @@
+// proximity_safety.h header file //
+// include this file in "proximity_safety.cpp"
+// proximity safety node: fuses the five cRIO sonars (sonar_1..sonar_5, or sonar_array) with the lidar scan into one
+// polar occupancy buffer around base_link, then publishes the same outputs as lidar_alarm (/lidar_alarm,
+// /lidar_allowed_speed), so glass and low obstacles that only the sonars see slow and stop the robot too
+// run this INSTEAD of lidar_alarm_tje22, not alongside it
+//
+// the buffer holds, for each of N_POLAR_BINS bearings, the nearest range seen by any sensor whose data is fresh;
+// each sensor keeps its own layer (the lidar: a full ring of bins; a sonar: the arc its cone covers at the
+// measured range), and the layers are min-combined whenever outputs are published
+// everything is sized at compile time or on the first scan; nothing is allocated per message
+
+#ifndef PROXIMITY_SAFETY_H_
+#define PROXIMITY_SAFETY_H_
+
+#include <math.h>
+#include <stdio.h>
+#include <string>
+#include <ros/ros.h>
+#include <boost/bind.hpp>
+#include <sensor_msgs/LaserScan.h>
+#include <std_msgs/Bool.h>
+#include <std_msgs/Float32.h>
+#include <cwru_msgs/Sonar.h>
+#include <cwru_msgs/SonarArray.h>
+#include <tf/transform_listener.h>
+#include <planar_geometry/planar_geometry.h>
+#include <planar_geometry/scan_geometry.h>
+#include <lidar_alarm_tje22/allowed_speed.h>
+
+const std::string BASE_FRAME = "base_link";
+
+// polar buffer
+const int N_POLAR_BINS = 360; // 1 deg bearings around base_link
+const double POLAR_BIN_WIDTH = 2.0 * M_PI / N_POLAR_BINS;
+const double SENSOR_TIMEOUT = 0.5; // sec; older layers are left out of the fusion
+
+// sonars, as published by crio_receiver
+const int N_SONARS = 5;
+const double SONAR_HALF_ANGLE = 0.26; // rad; half-width of a sonar's beam cone
+const double SONAR_MIN_RANGE = 0.05; // m; closer is treated as no echo
+const double SONAR_MAX_RANGE = 3.0; // m; farther is treated as no echo
+const int MAX_SONAR_SAMPLES = (int) (2.0 * SONAR_HALF_ANGLE / POLAR_BIN_WIDTH) + 2; // points along a sonar's arc
+
+// outputs: same meaning, and same defaults, as in lidar_alarm
+const double ROBOT_HALF_WIDTH = 0.35; // m; half the width of the corridor the robot sweeps, plus a little clearance
+const double ROBOT_FRONT = 0.45; // m; from base_link to the front of the robot
+const double STOP_MARGIN = 0.5; // m; want to come to rest at least this far from an obstacle
+const double BRAKE_DECEL = 0.3; // m/sec^2
+const double REACTION_TIME = 0.2; // sec
+const double ALLOWED_SPEED_CAP = 1.0; // m/sec
+
+// where a sensor sits on the robot, looked up once from tf (the sensor mounts are static)
+struct SensorPose {
+    bool valid;
+    double x;
+    double y;
+    double yaw;
+};
+
+// one sonar's contribution to the polar buffer
+struct SonarLayer {
+    int n_samples; // 0 if the last ping had no echo
+    int bin[MAX_SONAR_SAMPLES];
+    float range[MAX_SONAR_SAMPLES];
+    ros::Time stamp;
+};
+
+class ProximitySafety {
+public:
+    ProximitySafety(ros::NodeHandle* nodehandle);
+
+private:
+    ros::NodeHandle nh_;
+    ros::Subscriber scan_subscriber_;
+    ros::Subscriber sonar_subscriber_[N_SONARS];
+    ros::Subscriber sonar_array_subscriber_;
+    ros::Publisher alarm_publisher_;
+    ros::Publisher allowed_speed_publisher_;
+    ros::Publisher latency_publisher_; // sec from sensor stamp (packet arrival at crio_receiver, or scan time) to publication
+    tf::TransformListener tf_listener_;
+
+    SensorPose lidar_pose_;
+    SensorPose sonar_pose_[N_SONARS];
+
+    // lidar layer
+    planar_geometry::ScanGeometry scan_geometry_;
+    float lidar_range_[N_POLAR_BINS];
+    ros::Time lidar_stamp_;
+
+    // sonar layers; sonar_cone_cos_/sin_ are the sample directions across a cone, in the sonar's frame
+    SonarLayer sonar_layer_[N_SONARS];
+    std::string sonar_frame_[N_SONARS]; // sonar_<i+1>_link; a SonarArray doesn't name its frames
+    float sonar_cone_cos_[MAX_SONAR_SAMPLES];
+    float sonar_cone_sin_[MAX_SONAR_SAMPLES];
+    int n_cone_samples_;
+    // the five pings of one cRIO pose packet share a stamp; publish once all of them are in
+    ros::Time sonar_packet_stamp_;
+    int n_sonar_pings_in_packet_;
+    // crio_receiver with ~sonar_output:=both sends every ping twice; once the array is seen, sonar_N is ignored
+    bool sonar_array_seen_;
+
+    // fused buffer, and the bearing of each bin
+    float fused_range_[N_POLAR_BINS];
+    float bin_cos_[N_POLAR_BINS];
+    float bin_sin_[N_POLAR_BINS];
+
+    // output messages, reused
+    std_msgs::Bool alarm_msg_;
+    std_msgs::Float32 allowed_speed_msg_;
+    std_msgs::Float32 latency_msg_;
+
+    void initializeSubscribers();
+    void initializePublishers();
+
+    void scanCallback(const sensor_msgs::LaserScan::ConstPtr& scan);
+    void sonarCallback(const cwru_msgs::Sonar::ConstPtr& ping, int i_sonar);
+    void sonarArrayCallback(const cwru_msgs::SonarArray::ConstPtr& pings);
+    // rebuild sonar i_sonar's layer from one ping
+    void update_sonar_layer(int i_sonar, const std::string& frame_id, const ros::Time& stamp, double dist);
+
+    // pose of frame_id in BASE_FRAME; looked up from tf on first use, then cached
+    bool lookup_sensor_pose(const std::string& frame_id, SensorPose& pose);
+    int bin_of(double x, double y) const;
+    // combine the fresh layers, compute the outputs and publish them; stamp is the time of the triggering sensor data
+    void fuse_and_publish(const ros::Time& stamp);
+};
+
+#endif  // PROXIMITY_SAFETY_H_
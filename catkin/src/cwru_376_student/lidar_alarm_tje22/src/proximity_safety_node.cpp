@@ -0,0 +1,17 @@
+//proximity_safety_node.cpp:
+//runs ProximitySafety as a stand-alone node; see proximity_safety_nodelet.cpp to run it in a nodelet manager
+
+#include "proximity_safety.h"
+
+int main(int argc, char** argv) {
+    // ROS set-ups:
+    ros::init(argc, argv, "proximity_safety"); //node name
+    ros::NodeHandle nh; // create a node handle; need to pass this to the class constructor
+
+    ROS_INFO("main: instantiating a ProximitySafety");
+    ProximitySafety proximitySafety(&nh); //instantiate a ProximitySafety object and pass in pointer to nodehandle for constructor to use
+
+    ROS_INFO("main: going into spin; let the callbacks do all the work");
+    ros::spin();
+    return 0;
+}
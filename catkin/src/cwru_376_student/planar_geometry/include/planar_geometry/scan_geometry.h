@@ -0,0 +1,99 @@
+// scan_geometry.h header file //
+// per-beam angle tables for a planar laser scan, so scan callbacks never call cos()/sin() per ping
+// the tables are built once for a given (angle_min, angle_increment, number of pings) and rebuilt only if a scan
+// arrives with a different signature (e.g. the driver was reconfigured)
+// plus branch-free loops over a contiguous range of pings, written so the compiler can vectorize them
+// (no early exits, no function calls, float data to match sensor_msgs::LaserScan::ranges)
+
+#ifndef SCAN_GEOMETRY_H_
+#define SCAN_GEOMETRY_H_
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace planar_geometry {
+
+class ScanGeometry {
+public:
+    ScanGeometry() : angle_min_(0.0), angle_increment_(0.0) {}
+
+    // make sure the tables match this scan; returns true if they were (re)built
+    bool update(double angle_min, double angle_increment, size_t n_pings) {
+        if (n_pings == cos_.size() && angle_min == angle_min_ && angle_increment == angle_increment_) {
+            return false;
+        }
+        angle_min_ = angle_min;
+        angle_increment_ = angle_increment;
+        cos_.resize(n_pings);
+        sin_.resize(n_pings);
+        for (size_t i = 0; i < n_pings; i++) {
+            double angle = angle_min + i * angle_increment;
+            cos_[i] = cos(angle);
+            sin_[i] = sin(angle);
+        }
+        return true;
+    }
+
+    size_t size() const { return cos_.size(); }
+    double angle_min() const { return angle_min_; }
+    double angle_increment() const { return angle_increment_; }
+    double angle(int i) const { return angle_min_ + i * angle_increment_; }
+
+    // index of the ping closest to the given angle, clamped to the scan
+    int index_of(double angle) const {
+        if (cos_.empty()) return 0;
+        int i = (int) floor((angle - angle_min_) / angle_increment_ + 0.5);
+        if (i < 0) return 0;
+        if (i >= (int) cos_.size()) return cos_.size() - 1;
+        return i;
+    }
+
+    const float* cos_table() const { return cos_.data(); }
+    const float* sin_table() const { return sin_.data(); }
+
+private:
+    double angle_min_;
+    double angle_increment_;
+    std::vector<float> cos_;
+    std::vector<float> sin_;
+};
+
+// number of pings in [i_begin, i_end) whose forward distance range*cos(angle) is less than x_limit;
+// inf and NaN ranges never count
+inline int count_closer_in_x(const float* ranges, const float* cos_table, int i_begin, int i_end, float x_limit) {
+    int count = 0;
+    for (int i = i_begin; i < i_end; i++) {
+        count += (ranges[i] * cos_table[i] < x_limit);
+    }
+    return count;
+}
+
+// smallest forward distance range*cos(angle) over pings [i_begin, i_end); returns x_max if none is closer
+inline float min_x(const float* ranges, const float* cos_table, int i_begin, int i_end, float x_max) {
+    float x_min = x_max;
+    for (int i = i_begin; i < i_end; i++) {
+        float x = ranges[i] * cos_table[i];
+        x_min = (x < x_min) ? x : x_min;
+    }
+    return x_min;
+}
+
+// per-ping decisions for [i_begin, i_end): hits[i] = 1 if range*cos(angle) < x_limit, else 0
+inline void mark_closer_in_x(const float* ranges, const float* cos_table, int i_begin, int i_end, float x_limit, uint8_t* hits) {
+    for (int i = i_begin; i < i_end; i++) {
+        hits[i] = (ranges[i] * cos_table[i] < x_limit);
+    }
+}
+
+// per-ping decisions for [i_begin, i_end): hits[i] = 1 if r_min <= range < limits[i], i.e. inside a per-beam range limit
+inline void mark_within_limits(const float* ranges, const float* limits, int i_begin, int i_end, float r_min, uint8_t* hits) {
+    for (int i = i_begin; i < i_end; i++) {
+        hits[i] = (ranges[i] < limits[i]) & (ranges[i] >= r_min);
+    }
+}
+
+} // namespace planar_geometry
+
+#endif  // SCAN_GEOMETRY_H_
@@ -0,0 +1,89 @@
+// checks the fast approximations and the angle wrapping in planar_geometry.h against libm on a grid
+
+#include <math.h>
+#include <gtest/gtest.h>
+#include <planar_geometry/planar_geometry.h>
+
+using namespace planar_geometry;
+
+// the error bound documented in planar_geometry.h (measured worst case is 1.66e-6 rad)
+const double FAST_ATAN2_TOL = 2.0e-6;
+
+// (x, y) on a polar grid over several decades of radius, plus the axes and the diagonals
+TEST(FastAtan2, MatchesAtan2OnGrid)
+{
+    double max_err = 0.0;
+    for (int k = 0; k <= 7200; k++)
+    {
+        double theta = -M_PI + k * (M_PI / 3600.0);
+        for (double r = 1e-6; r < 1e7; r *= 10.0)
+        {
+            double x = r * cos(theta);
+            double y = r * sin(theta);
+            double err = fabs(fast_atan2(y, x) - atan2(y, x));
+            // atan2 and fast_atan2 may land on opposite ends of the cut at +/- pi
+            err = fmin(err, fabs(err - TWO_PI));
+            max_err = fmax(max_err, err);
+        }
+    }
+    EXPECT_LT(max_err, FAST_ATAN2_TOL);
+}
+
+TEST(FastAtan2, AxesAndOrigin)
+{
+    EXPECT_DOUBLE_EQ(0.0, fast_atan2(0.0, 0.0));
+    EXPECT_DOUBLE_EQ(0.0, fast_atan2(0.0, 1.0));
+    EXPECT_NEAR(M_PI_2, fast_atan2(1.0, 0.0), FAST_ATAN2_TOL);
+    EXPECT_NEAR(-M_PI_2, fast_atan2(-1.0, 0.0), FAST_ATAN2_TOL);
+    EXPECT_NEAR(M_PI, fast_atan2(0.0, -1.0), FAST_ATAN2_TOL);
+    EXPECT_NEAR(M_PI_4, fast_atan2(1.0, 1.0), FAST_ATAN2_TOL);
+    EXPECT_NEAR(-3.0 * M_PI_4, fast_atan2(-1.0, -1.0), FAST_ATAN2_TOL);
+}
+
+// wrap_to_pi() lands in [-pi, pi] and names the same direction as its input: compare through atan2(sin, cos)
+TEST(WrapToPi, MatchesAtan2OfSinCos)
+{
+    for (int k = -20000; k <= 20000; k++)
+    {
+        double angle = k * 0.00731; // about +/- 23 turns, not commensurate with pi
+        double wrapped = wrap_to_pi(angle);
+        ASSERT_LE(wrapped, M_PI + 1e-12) << "angle " << angle;
+        ASSERT_GE(wrapped, -M_PI - 1e-12) << "angle " << angle;
+        double expected = atan2(sin(angle), cos(angle));
+        double err = fabs(wrapped - expected);
+        err = fmin(err, fabs(err - TWO_PI));
+        ASSERT_LT(err, 1e-9) << "angle " << angle;
+        ASSERT_DOUBLE_EQ(wrapped, min_dang(angle));
+    }
+}
+
+TEST(WrapToPi, LargeAngles)
+{
+    // exact to rounding for |angle| < 1e6 rad
+    for (double angle = -1e6; angle <= 1e6; angle += 9999.123)
+    {
+        double expected = atan2(sin(angle), cos(angle));
+        double err = fabs(wrap_to_pi(angle) - expected);
+        err = fmin(err, fabs(err - TWO_PI));
+        EXPECT_LT(err, 1e-9) << "angle " << angle;
+    }
+}
+
+// planar quaternion -> heading, fast and exact, over the whole circle
+TEST(PlanarQuat2Phi, FastMatchesExact)
+{
+    for (int k = -3600; k <= 3600; k++)
+    {
+        double phi = k * (M_PI / 3600.0);
+        geometry_msgs::Quaternion q = convertPlanarPhi2Quaternion(phi);
+        double err = fabs(fastPlanarQuat2Phi(q) - convertPlanarQuat2Phi(q));
+        err = fmin(err, fabs(err - TWO_PI));
+        EXPECT_LT(err, 4.0e-6) << "phi " << phi;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,82 @@
+// stop_profile.h header file //
+// jerk-limited stopping trajectory for vel_scheduler
+// when an alarm fires, the profile is latched from the COMMANDED speed and acceleration (not from odom, which lags),
+// and then steps that state down to zero: deceleration builds up at j_max to a_max, and eases back off at j_max
+// just in time to reach zero speed with zero acceleration.  This is the shortest stop the accel and jerk limits allow,
+// and since it never looks at odom, a lagging odom can't make the command chatter between braking and re-accelerating
+// works for either sign of speed, so the same class handles both linear speed and spin rate
+
+#ifndef STOP_PROFILE_H_
+#define STOP_PROFILE_H_
+
+#include <math.h>
+
+const double STOPPED_SPEED = 1e-6; // speeds below this are rounding residue: at rest
+
+class StopProfile
+{
+public:
+    StopProfile(double a_max, double j_max) : a_max_(a_max), j_max_(j_max), active_(false), dir_(1.0), v_(0.0), a_(0.0) {}
+
+    bool active() const { return active_; }
+
+    // latch a stop, starting from the commanded speed v0 and acceleration a0
+    void start(double v0, double a0)
+    {
+        active_ = true;
+        dir_ = (v0 < 0.0) ? -1.0 : 1.0;
+        // track magnitudes; a_ < 0 means slowing down
+        v_ = fabs(v0);
+        a_ = dir_ * a0;
+        if (a_ > a_max_) a_ = a_max_;
+        if (a_ < -a_max_) a_ = -a_max_;
+    }
+
+    // stop following the profile; the caller resumes from speed() and accel()
+    void release() { active_ = false; }
+
+    // advance the profile by dt and return the new commanded speed
+    // the speed is integrated with the mean of the old and new acceleration, so easing a decel b back off to zero at
+    // j_max loses exactly b^2/(2*j_max), tick size or not; each tick brakes as hard as the limits allow while still
+    // leaving room to ease off, so the speed reaches zero together with the acceleration, without a jerk spike
+    double update(double dt)
+    {
+        if (v_ <= STOPPED_SPEED)
+        {
+            v_ = 0.0;
+            a_ = 0.0;
+            return 0.0;
+        }
+        double b = -a_; // deceleration now
+        double b_next = b + j_max_ * dt; // brake harder...
+        if (b_next > a_max_) b_next = a_max_; // ...up to a_max...
+        // ...but no harder than we can ease back off from by the time we stop:
+        // v_ - dt*(b + b_next)/2 >= b_next^2/(2*j_max), solved for b_next
+        double c = v_ - 0.5 * dt * b;
+        double b_ease = (c > 0.0) ? j_max_ * (sqrt(0.25 * dt * dt + 2.0 * c / j_max_) - 0.5 * dt) : 0.0;
+        if (b_next > b_ease) b_next = b_ease;
+        if (b_next < b - j_max_ * dt) b_next = b - j_max_ * dt; // easing off is jerk-limited too
+        v_ -= 0.5 * dt * (b + b_next);
+        a_ = -b_next;
+        if (v_ <= STOPPED_SPEED)
+        {
+            // at rest (or, latched braking too hard for the speed left, the last tick would pass through zero)
+            v_ = 0.0;
+            a_ = 0.0;
+        }
+        return speed();
+    }
+
+    double speed() const { return dir_ * v_; }
+    double accel() const { return dir_ * a_; }
+
+private:
+    double a_max_;
+    double j_max_;
+    bool active_;
+    double dir_; // sign of the speed when the stop was latched
+    double v_; // speed magnitude
+    double a_; // acceleration, in the direction of travel
+};
+
+#endif  // STOP_PROFILE_H_
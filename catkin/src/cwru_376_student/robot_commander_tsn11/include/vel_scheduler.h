@@ -2,8 +2,34 @@
 #include <ros/ros.h>
 #include <std_msgs/Float64.h>
 #include <std_msgs/Bool.h>
+#include <std_msgs/Float32.h>
 #include <geometry_msgs/Twist.h>
 #include <nav_msgs/Odometry.h>
+#include <vector>
+#include <algorithm>
+#include <XmlRpcValue.h>
+#include <cwru_srv/simple_bool_service_message.h>
+#include <planar_geometry/planar_geometry.h>
+#include <stop_profile.h>
 
 
 using namespace std;
+
+// one step of a mission: travel a straight-line distance and/or rotate by an angle
+// the profile breakpoints are precomputed once, when the mission is loaded, so the control loop
+// only has to compare against them
+struct MissionStep
+{
+    double length; // m to travel
+    double angle; // rad to rotate (signed)
+    double v_peak; // highest speed reached: v_max, or less if the segment is too short to get there
+    double dist_decel; // start braking when this much distance is left
+    double omega_peak; // highest spin rate reached
+    double rot_decel; // start braking the rotation when this much angle is left
+};
+
+// a mission is loaded from the parameter server, e.g. from a yaml file (see config/mission.yaml):
+//   mission:
+//     segments: [2.0, 0.0, 1.0, 0.0, 2.0, 0.0]  # m
+//     turns: [0.0, 1.5708, 0.0, 1.5708, 0.0, 1.5708]  # rad
+// "rosparam load new_mission.yaml" followed by "rosservice call reloadMissionService 1" swaps routes on the fly
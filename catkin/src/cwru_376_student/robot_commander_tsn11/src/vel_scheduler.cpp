@@ -38,6 +38,8 @@ const double a_max = 0.3; //1m/sec^2 is 0.1 g's
 //const double a_max_decel = 0.1; // TEST
 const double omega_max = 0.6; //1 rad/sec-> about 6 seconds to rotate 1 full rev
 const double alpha_max = 0.3; //0.5 rad/sec^2-> takes 2 sec to get from rest to full omega
+const double j_max = 0.6; // m/sec^3; jerk limit for alarm stops--reaches a_max in 0.5 sec
+const double jerk_omega_max = 0.6; // rad/sec^3; same, for spin
 const double DT = 0.050; // choose an update rate of 20Hz; go faster with actual hardware
 
 //Variables to store the motorsEnabled information
@@ -51,19 +53,38 @@ bool lidar_alarm;
 bool lidar_alarm_ = false; //global variable to store lidar status
 string lidar_check;
 
+//allowed speed from the lidar: the highest speed from which we can still stop short of what is ahead
+const double ALLOWED_SPEED_TIMEOUT = 0.5; // sec; if the signal goes quiet this long, assume nothing is allowed
+const double ALLOWED_OMEGA_FLOOR = 0.3; // spin limit never drops below this fraction of omega_max, so we can turn away
+double allowed_speed_ = -1.0; // negative until the first message; without a lidar node, only v_max applies
+ros::Time t_allowed_speed_;
+
 //Soft_stop variables
 bool soft_stop_ = false;  //in future add callback message
 
+//commanded state, i.e. what was last published; ramps and alarm stops start from here rather than from (lagging) odom
+double last_cmd_vel_ = 0.0;
+double last_cmd_accel_ = 0.0;
+double last_cmd_omega_ = 0.0;
+double last_cmd_alpha_ = 0.0;
+
+//jerk-limited stop trajectories, latched when the lidar alarm or soft stop fires
+StopProfile vel_stop_profile_(a_max, j_max);
+StopProfile omega_stop_profile_(alpha_max, jerk_omega_max);
+
 
-//arrays that hold the segment and turn information for plotting the course
-double segments [] = {2, 0.0, 1.0, 0.0, 2.0, 0.0}; //variable to store movement segments
-double turns [] = {0.0, PI / 2, 0.0, PI / 2, 0.0, PI / 2}; //variable to store turn segments
-int counter = 1; //counts through segment and turn arrays
+//default mission, used if none is found on the parameter server
+double default_segments [] = {2, 0.0, 1.0, 0.0, 2.0, 0.0}; //variable to store movement segments
+double default_turns [] = {0.0, PI / 2, 0.0, PI / 2, 0.0, PI / 2}; //variable to store turn segments
 
+// the mission currently being executed, with precomputed profile breakpoints
+std::vector<MissionStep> mission_;
+int counter = 0; //counts through the mission steps
+bool restart_mission_ = false; // set when a new mission has been loaded; main loop restarts from the current pose
 
-//starting at first values in array
-double segment_length = segments [0];
-double angle_rotation = turns [0];
+//current step
+double segment_length = 0.0;
+double angle_rotation = 0.0;
 
 // globals for communication w/ callbacks:
 double odom_vel_ = 0.0; // measured/published system speed
@@ -102,10 +123,8 @@ void odomCallback(const nav_msgs::Odometry &odom_rcvd)
     odom_y_ = odom_rcvd.pose.pose.position.y;
     //odom publishes orientation as a quaternion.  Convert this to a simple heading
     // see notes above for conversion for simple planar motion
-    double quat_z = odom_rcvd.pose.pose.orientation.z;
-    double quat_w = odom_rcvd.pose.pose.orientation.w;
     // cheap conversion from quaternion to heading for planar motion
-    double raw_odom_phi_ = 2.0 * atan2(quat_z, quat_w);
+    double raw_odom_phi_ = planar_geometry::convertPlanarQuat2Phi(odom_rcvd.pose.pose.orientation);
     ROS_WARN("raw_odom_phi is %lf", raw_odom_phi_);
     if ((last_odom_phi_ - raw_odom_phi_) > (1.5*PI))
     {
@@ -158,11 +177,135 @@ void lidarCallback(const std_msgs::Bool &lidar_alarm)
     ROS_INFO("%s", lidar_check.c_str());
 }
 
-//cycle through the array of distance moves
-int segmentCycle(double segment [], double turn [], int i)
+//store the latest allowed speed from the lidar
+void allowedSpeedCallback(const std_msgs::Float32 &allowed_speed)
+{
+    allowed_speed_ = allowed_speed.data;
+    t_allowed_speed_ = ros::Time::now();
+}
+
+// speed limit right now: v_max, scaled down by the lidar's allowed speed
+double allowedSpeed()
+{
+    if (allowed_speed_ < 0.0)
+    {
+        return v_max; // never heard from the lidar
+    }
+    if ((ros::Time::now() - t_allowed_speed_).toSec() > ALLOWED_SPEED_TIMEOUT)
+    {
+        ROS_WARN_THROTTLE(1.0, "allowed speed is stale; holding still");
+        return 0.0;
+    }
+    return std::min(v_max, allowed_speed_);
+}
+
+// precompute the trapezoidal (or triangular, for short moves) profile of one step
+MissionStep computeMissionStep(double length, double angle)
 {
-    segment_length = segment [i];
-    angle_rotation = turn [i];
+    MissionStep step;
+    step.length = length;
+    step.angle = angle;
+
+    // a move too short to reach full speed peaks where accel and decel ramps meet, halfway: v = sqrt(a*length)
+    step.v_peak = std::min(v_max, sqrt(a_max * fabs(length)));
+    step.dist_decel = 0.5 * step.v_peak * step.v_peak / a_max; // dist = v^2/(2a)
+
+    step.omega_peak = std::min(omega_max, sqrt(alpha_max * fabs(angle)));
+    step.rot_decel = 0.5 * step.omega_peak * step.omega_peak / alpha_max;
+    return step;
+}
+
+// build a mission (with all profile breakpoints) in a single pass over the segment/turn lists
+void buildMission(const std::vector<double> &segments, const std::vector<double> &turns, std::vector<MissionStep> &mission)
+{
+    mission.clear();
+    int nsteps = std::min(segments.size(), turns.size());
+    mission.reserve(nsteps);
+    for (int i = 0; i < nsteps; i++)
+    {
+        mission.push_back(computeMissionStep(segments[i], turns[i]));
+    }
+}
+
+// read a list of numbers from the parameter server; ints are accepted as well as doubles
+bool getDoubleList(ros::NodeHandle &nh, const std::string &name, std::vector<double> &values)
+{
+    XmlRpc::XmlRpcValue list;
+    if (!nh.getParam(name, list) || list.getType() != XmlRpc::XmlRpcValue::TypeArray)
+    {
+        return false;
+    }
+    values.clear();
+    for (int i = 0; i < list.size(); i++)
+    {
+        if (list[i].getType() == XmlRpc::XmlRpcValue::TypeDouble)
+        {
+            values.push_back(static_cast<double>(list[i]));
+        }
+        else if (list[i].getType() == XmlRpc::XmlRpcValue::TypeInt)
+        {
+            values.push_back(static_cast<int>(list[i]));
+        }
+        else
+        {
+            ROS_WARN("%s[%d] is not a number", name.c_str(), i);
+            return false;
+        }
+    }
+    return true;
+}
+
+// load the mission from the parameter server, falling back to the compiled-in default
+// the new table is built on the side and then swapped in, so the old mission is never half-replaced
+void loadMission(ros::NodeHandle &nh)
+{
+    std::vector<double> segments, turns;
+    if (getDoubleList(nh, "mission/segments", segments) && getDoubleList(nh, "mission/turns", turns))
+    {
+        if (segments.size() != turns.size())
+        {
+            ROS_WARN("mission has %d segments but %d turns; using the shorter list", (int) segments.size(), (int) turns.size());
+        }
+        ROS_INFO("loaded mission from parameter server");
+    }
+    else
+    {
+        segments.assign(default_segments, default_segments + sizeof(default_segments) / sizeof(double));
+        turns.assign(default_turns, default_turns + sizeof(default_turns) / sizeof(double));
+        ROS_WARN("no mission on parameter server; using default mission");
+    }
+    std::vector<MissionStep> new_mission;
+    buildMission(segments, turns, new_mission);
+    mission_.swap(new_mission);
+    ROS_INFO("mission has %d steps", (int) mission_.size());
+}
+
+ros::NodeHandle *nh_ptr_; // for the reload service
+
+// swap in a new mission without restarting the node; it starts from wherever the robot is now
+bool reloadMissionCallback(cwru_srv::simple_bool_service_messageRequest &request, cwru_srv::simple_bool_service_messageResponse &response)
+{
+    ROS_INFO("reloading mission");
+    loadMission(*nh_ptr_);
+    restart_mission_ = true;
+    response.resp = true;
+    return true;
+}
+
+//cycle through the mission steps
+void segmentCycle(int i)
+{
+    if (i < mission_.size())
+    {
+        segment_length = mission_[i].length;
+        angle_rotation = mission_[i].angle;
+    }
+    else
+    {
+        // mission complete; hold still
+        segment_length = 0.0;
+        angle_rotation = 0.0;
+    }
     ROS_INFO("Segment length: %f, Rotation Angle: %f", segment_length, angle_rotation);
 }
 
@@ -219,10 +362,10 @@ double determineCmdVel(double scheduled_vel)
 {
 	//how does the current velocity compare to the scheduled vel?
 	// maybe we halted, e.g. due to estop or obstacle;
-	if (odom_vel_ < scheduled_vel)
+	if (last_cmd_vel_ < scheduled_vel)
 	{
 	    // may need to ramp up to v_max; do so within accel limits
-	    double v_test = odom_vel_ + (a_max * dt_callback_); // if callbacks are slow, this could be abrupt
+	    double v_test = last_cmd_vel_ + (a_max * DT);
 	    // operator:  c = (a>b) ? a : b;
 	    double new_cmd_vel = (v_test < scheduled_vel) ? v_test : scheduled_vel; //choose lesser of two options
 	    ROS_INFO("Ramping up velocity: New Cmd Vel: %f, Sched Vel: %f", new_cmd_vel, scheduled_vel);
@@ -230,11 +373,11 @@ double determineCmdVel(double scheduled_vel)
 	}
 
 	//travelling too fast--this could be trouble
-	else if (odom_vel_ > scheduled_vel)
+	else if (last_cmd_vel_ > scheduled_vel)
 	{
 	    // ramp down to the scheduled velocity.  However, scheduled velocity might already be ramping down at a_max.
 	    // need to catch up, so ramp down even faster than a_max.  Try 1.2*a_max.
-	    double v_test = odom_vel_ - (1.2 * a_max * dt_callback_); //moving too fast--try decelerating faster than nominal a_max
+	    double v_test = last_cmd_vel_ - (1.2 * a_max * DT); //moving too fast--try decelerating faster than nominal a_max
 
 	    double new_cmd_vel = (v_test > scheduled_vel) ? v_test : scheduled_vel; // choose larger of two options...don't overshoot scheduled_vel
 
@@ -251,10 +394,10 @@ double determineCmdVel(double scheduled_vel)
 double determineCmdOmega(double scheduled_omega, double rot_direction)
 {
 	//compare the current turning speed to the scheduled turning speed
-	if (fabs(odom_omega_) < fabs(scheduled_omega))
+	if (fabs(last_cmd_omega_) < fabs(scheduled_omega))
 	{
 	    //for some reason the turning speed is less than schedule
-	    double omega_test = odom_omega_ + (rot_direction * alpha_max * dt_callback_);
+	    double omega_test = last_cmd_omega_ + (rot_direction * alpha_max * DT);
 	    //create two options for turning
 	    double new_cmd_omega = (fabs(omega_test) < fabs(scheduled_omega)) ? omega_test : scheduled_omega; // choose lesser of the two turn speeds
 	    //done in order to prevent overshooting the scheduled_omega
@@ -263,10 +406,10 @@ double determineCmdOmega(double scheduled_omega, double rot_direction)
 	}
 
 	// for some reason we are traveling too fast
-	else if (fabs(odom_omega_) > fabs(scheduled_omega))
+	else if (fabs(last_cmd_omega_) > fabs(scheduled_omega))
 	{
 	    //lets ramp down at 1.2*alpha_max in case we are already trying to decel
-	    double omega_test = (rot_direction * fabs(odom_omega_)) - (1.2 * alpha_max * dt_callback_); //turning too fast, slow down faster than normal
+	    double omega_test = (rot_direction * fabs(last_cmd_omega_)) - (1.2 * alpha_max * DT); //turning too fast, slow down faster than normal
 	    double new_cmd_omega = (fabs(omega_test) > fabs(scheduled_omega)) ? omega_test : scheduled_omega; //choose the larger of the two options, as to not overshoot scheduled_omega
 
 	    ROS_INFO("Slowing Down rotation: New cmd omega: %f; Sched omega: %f", new_cmd_omega, scheduled_omega); //debug/analysis output; can comment this out
@@ -279,50 +422,67 @@ double determineCmdOmega(double scheduled_omega, double rot_direction)
 	}
 }
 
-void checkAlarms(geometry_msgs::Twist &cmd_vel, double rot_direction)
+void checkAlarms(geometry_msgs::Twist &cmd_vel)
 {
-	//begin decel to stop if lidar alarm or soft stop is on
+	//follow a jerk-limited stop if lidar alarm or soft stop is on
 	if (lidar_alarm_ == true || soft_stop_ == true)
 	{
-
-	    ROS_WARN("LIDAR OR SOFT STOP");
-
-	    if (odom_vel_ >= .01)
-	    {
-	        cmd_vel.linear.x = odom_vel_ - (a_max * dt_callback_); //decel
-	    }
-
-	    else cmd_vel.linear.x = 0;  //velocity 0 if slow enough
-
-
-	    if (fabs(odom_omega_) >= .01)
+	    if (!vel_stop_profile_.active())
 	    {
-	        cmd_vel.angular.z = (rot_direction * fabs(odom_omega_)) - (alpha_max * dt_callback_); //decel
+	        // latch the stop from what we were commanding, not from odom, which lags
+	        ROS_WARN("LIDAR OR SOFT STOP");
+	        vel_stop_profile_.start(last_cmd_vel_, last_cmd_accel_);
+	        omega_stop_profile_.start(last_cmd_omega_, last_cmd_alpha_);
 	    }
-
-	    else cmd_vel.angular.z = 0; //omega 0 if slow enough
-
+	    cmd_vel.linear.x = vel_stop_profile_.update(DT);
+	    cmd_vel.angular.z = omega_stop_profile_.update(DT);
+	}
+	else if (vel_stop_profile_.active())
+	{
+	    // alarm cleared; the scheduler ramps back up from the stop profile's state, which is now the commanded state
+	    ROS_INFO("alarm cleared; resuming from v = %f, omega = %f", vel_stop_profile_.speed(), omega_stop_profile_.speed());
+	    vel_stop_profile_.release();
+	    omega_stop_profile_.release();
 	}
 
 	if (motorsEnabled_ == false)
 	{
+	    // motors are unpowered, so the robot is coasting to a stop regardless; command zero, and
+	    // resume from rest once the motors come back
 	    ROS_WARN("ESTOP ACTIVATED");
 	    cmd_vel.linear.x = 0.0;
 	    cmd_vel.angular.z = 0.0;
+	    vel_stop_profile_.start(0.0, 0.0);
+	    omega_stop_profile_.start(0.0, 0.0);
 	}
 }
 
+// remember what was published; this is the commanded state that ramps and stop profiles start from
+void updateCommandedState(const geometry_msgs::Twist &cmd_vel)
+{
+    last_cmd_accel_ = (cmd_vel.linear.x - last_cmd_vel_) / DT;
+    last_cmd_alpha_ = (cmd_vel.angular.z - last_cmd_omega_) / DT;
+    last_cmd_vel_ = cmd_vel.linear.x;
+    last_cmd_omega_ = cmd_vel.angular.z;
+}
+
 int main(int argc, char **argv)
 {
     ros::init(argc, argv, "vel_scheduler"); // name of this node will be "minimal_publisher1"
 
     ros::NodeHandle nh; // get a ros nodehandle; standard yadda-yadda
+    nh_ptr_ = &nh;
+
+    // route to follow; can be swapped at run time via reloadMissionService
+    loadMission(nh);
+    ros::ServiceServer reload_mission_service = nh.advertiseService("reloadMissionService", reloadMissionCallback);
 
     //subscribe to motors_enabled rosmsg
     ros::Subscriber submotorsEnabled = nh.subscribe("/motors_enabled", 1, motorsEnabledCallback);
 
     //subscribe to lidar_alarm rosmsg
     ros::Subscriber sublidar = nh.subscribe("/lidar_alarm", 1, lidarCallback);
+    ros::Subscriber suballowed = nh.subscribe("/lidar_allowed_speed", 1, allowedSpeedCallback);
 
     //create a publisher object that can talk to ROS and issue twist messages on named topic;
     // note: this is customized for stdr robot; would need to change the topic to talk to jinx, etc.
@@ -373,28 +533,34 @@ int main(int argc, char **argv)
 
     ROS_INFO("start pose: x %f, y= %f, phi = %f", start_x, start_y, start_phi);
 
-    // compute some properties of trapezoidal velocity profile plan:
-    double T_accel = v_max / a_max; //...assumes start from rest
-    double T_decel = v_max / a_max; //(for same decel as accel); assumes brake to full halt
-    double dist_accel = 0.5 * a_max * (T_accel * T_accel); //distance rqd to ramp up to full speed
-    double dist_decel = 0.5 * a_max * (T_decel * T_decel);; //same as ramp-up distance
-    double dist_const_v = segment_length - dist_accel - dist_decel; //if this is <0, never get to full spd
-    double T_const_v = dist_const_v / v_max; //will be <0 if don't get to full speed
-    double T_segment_tot = T_accel + T_decel + T_const_v; // expected duration of this move
-
-    //compute some properties of trapezoidal rotation profile plan
-    double T_accel_alpha = omega_max / alpha_max;
-    double T_decel_alpha = omega_max / alpha_max;
-    double rot_accel = 0.5 * alpha_max * (T_accel_alpha * T_accel_alpha);
-    double rot_decel = 0.5 * alpha_max * (T_decel_alpha * T_decel_alpha);
-    double rot_const_omega = angle_rotation - rot_accel - rot_decel;
-    double T_const_omega = rot_const_omega / omega_max;
-    double T_rot_total = T_accel_alpha + T_decel_alpha + T_const_omega;
-
-    //dist_decel*= 2.0; // TEST TEST TEST
+    // profile properties (accel, cruise, decel breakpoints) were precomputed per step by loadMission()
+    counter = 0;
+    segmentCycle(counter);
+
     while (ros::ok()) // do work here in infinite loop (desired for this example), but terminate if detect ROS has faulted (or ctl-C)
     {
         ros::spinOnce(); // allow callbacks to populate fresh data
+        if (restart_mission_)
+        {
+            // a new mission was loaded; start it from here
+            restart_mission_ = false;
+            counter = 0;
+            segmentCycle(counter);
+            start_x = odom_x_;
+            start_y = odom_y_;
+            start_phi = odom_phi_;
+        }
+        if (counter >= mission_.size())
+        {
+            // mission complete (or empty): hold still, but keep honoring the reload service
+            cmd_vel.linear.x = 0.0;
+            cmd_vel.angular.z = 0.0;
+            vel_cmd_publisher.publish(cmd_vel);
+            updateCommandedState(cmd_vel);
+            rtimer.sleep();
+            continue;
+        }
+        const MissionStep &step = mission_[counter];
         // compute distance travelled so far:
         double delta_x = odom_x_ - start_x;
         double delta_y = odom_y_ - start_y;
@@ -412,8 +578,21 @@ int main(int argc, char **argv)
 
         //use segment_length_done to decide what vel should be, as per plan
 
-        scheduled_vel = determineScheduledVel(dist_to_go, dist_decel);
-        scheduled_omega = determineScheduledOmega(angle_to_turn, rot_decel, rot_direction);
+        scheduled_vel = std::min(step.v_peak, determineScheduledVel(dist_to_go, step.dist_decel));
+        scheduled_omega = determineScheduledOmega(angle_to_turn, step.rot_decel, rot_direction);
+        if (fabs(scheduled_omega) > step.omega_peak)
+        {
+            scheduled_omega = rot_direction * step.omega_peak; // short turns never reach omega_max
+        }
+
+        // scale the limits down in clutter; determineCmdVel/Omega then ramp smoothly to the lower speed
+        double v_allowed = allowedSpeed();
+        double omega_allowed = omega_max * std::max(v_allowed / v_max, ALLOWED_OMEGA_FLOOR);
+        scheduled_vel = std::min(scheduled_vel, v_allowed);
+        if (fabs(scheduled_omega) > omega_allowed)
+        {
+            scheduled_omega = rot_direction * omega_allowed;
+        }
 
 
         cmd_vel.linear.x = determineCmdVel(scheduled_vel);
@@ -422,7 +601,7 @@ int main(int argc, char **argv)
         ROS_INFO("cmd vel: %f", cmd_vel.linear.x); // debug output
         ROS_INFO("cmd omega: %f", cmd_vel.angular.z); // debug output
 
-        checkAlarms(cmd_vel, rot_direction);
+        checkAlarms(cmd_vel);
 
         //uh-oh...went too far already! or the estop is true!
         if (dist_to_go <= 0.0)
@@ -437,6 +616,7 @@ int main(int argc, char **argv)
         }
 
         vel_cmd_publisher.publish(cmd_vel); // publish the command to robot0/cmd_vel
+        updateCommandedState(cmd_vel);
         rtimer.sleep(); // sleep for remainder of timed iteration
 
         ROS_INFO("Final new_cmd_vel: %f", cmd_vel.linear.x);
@@ -444,8 +624,8 @@ int main(int argc, char **argv)
         //after finishing current move, cycle array, reinitialize starting values for next iteration
         if (dist_to_go <= 0.0 && (angle_to_turn <= 0.01 && angle_to_turn >= -0.01))
         {
-            segmentCycle(segments, turns, counter);
             counter ++;
+            segmentCycle(counter);
             start_x = odom_x_;
             start_y = odom_y_;
             start_phi = odom_phi_;
@@ -0,0 +1,163 @@
+// regression tests for StopProfile (include/stop_profile.h): latches a stop from several commanded (v, a) states,
+// steps it at vel_scheduler's rate and checks the stop time and distance and the accel and jerk limits
+
+#include <math.h>
+#include <gtest/gtest.h>
+#include <stop_profile.h>
+
+// vel_scheduler's limits and update period
+const double A_MAX = 0.3; // m/sec^2
+const double J_MAX = 0.6; // m/sec^3
+const double DT = 0.05; // sec
+
+struct StopResult
+{
+    double time; // until the commanded speed first reaches zero
+    double distance; // signed
+    double max_accel; // magnitude
+    double max_jerk; // magnitude
+    bool reversed; // the speed changed sign
+};
+
+// latch a stop from (v0, a0) and step it until it is at rest
+StopResult simulate_stop(double v0, double a0)
+{
+    StopProfile profile(A_MAX, J_MAX);
+    profile.start(v0, a0);
+    StopResult result = {0.0, 0.0, 0.0, 0.0, false};
+    double v = v0;
+    double a = profile.accel();
+    for (int i = 0; i < 10000 && v != 0.0; i++)
+    {
+        double v_next = profile.update(DT);
+        double a_next = profile.accel();
+        result.time += DT;
+        result.distance += 0.5 * (v + v_next) * DT;
+        result.max_accel = fmax(result.max_accel, fabs(a_next));
+        result.max_jerk = fmax(result.max_jerk, fabs(a_next - a) / DT);
+        if (v_next * v0 < 0.0)
+        {
+            result.reversed = true;
+        }
+        v = v_next;
+        a = a_next;
+    }
+    return result;
+}
+
+const double LIMIT_TOL = 1e-9;
+
+// from cruise, the stop is jerk up to a_max, hold it, jerk back off: v0/a_max + a_max/j_max = 2.5 s;
+// and 0.75 m (the trapezoidal speed update makes the discrete stop match the continuous one)
+TEST(StopProfile, FromCruise)
+{
+    StopResult r = simulate_stop(0.6, 0.0);
+    EXPECT_NEAR(2.5, r.time, 2 * DT);
+    EXPECT_NEAR(0.75, r.distance, 0.01);
+    EXPECT_LE(r.max_accel, A_MAX + LIMIT_TOL);
+    EXPECT_LE(r.max_jerk, J_MAX + LIMIT_TOL);
+    EXPECT_FALSE(r.reversed);
+}
+
+// latched while still speeding up: the acceleration has to be unwound first, so the stop takes longer
+TEST(StopProfile, WhileAccelerating)
+{
+    StopResult cruise = simulate_stop(0.6, 0.0);
+    StopResult r = simulate_stop(0.6, A_MAX);
+    EXPECT_GT(r.time, cruise.time);
+    EXPECT_GT(r.distance, cruise.distance);
+    // a_max/j_max to unwind, then v0 + a_max^2/(2 j_max) left to stop from: 0.5 + 0.675/0.3 + 0.5 = 3.25 s
+    EXPECT_NEAR(3.25, r.time, 2 * DT);
+    EXPECT_LE(r.max_accel, A_MAX + LIMIT_TOL);
+    EXPECT_LE(r.max_jerk, J_MAX + LIMIT_TOL);
+    EXPECT_FALSE(r.reversed);
+}
+
+// latched while already braking at a_max: no jerk-in phase, so it stops sooner
+TEST(StopProfile, WhileBraking)
+{
+    StopResult cruise = simulate_stop(0.6, 0.0);
+    StopResult r = simulate_stop(0.6, -A_MAX);
+    EXPECT_LT(r.time, cruise.time);
+    EXPECT_LT(r.distance, cruise.distance);
+    // v0/a_max + a_max/(2 j_max) = 2.25 s
+    EXPECT_NEAR(2.25, r.time, 2 * DT);
+    EXPECT_LE(r.max_accel, A_MAX + LIMIT_TOL);
+    EXPECT_LE(r.max_jerk, J_MAX + LIMIT_TOL);
+    EXPECT_FALSE(r.reversed);
+}
+
+// backing up (or spinning clockwise) stops the same way, mirrored
+TEST(StopProfile, Reverse)
+{
+    StopResult forward = simulate_stop(0.6, 0.0);
+    StopResult r = simulate_stop(-0.6, 0.0);
+    EXPECT_NEAR(forward.time, r.time, 1e-9);
+    EXPECT_NEAR(-forward.distance, r.distance, 1e-9);
+    EXPECT_LE(r.max_accel, A_MAX + LIMIT_TOL);
+    EXPECT_LE(r.max_jerk, J_MAX + LIMIT_TOL);
+    EXPECT_FALSE(r.reversed);
+}
+
+// too slow to reach a_max (v0 < a_max^2/j_max): a triangular decel pulse, 2*sqrt(v0/j_max) long
+TEST(StopProfile, SlowNeverReachesAMax)
+{
+    StopResult r = simulate_stop(0.1, 0.0);
+    EXPECT_NEAR(2.0 * sqrt(0.1 / J_MAX), r.time, 2 * DT);
+    EXPECT_LT(r.max_accel, A_MAX);
+    EXPECT_LE(r.max_jerk, J_MAX + LIMIT_TOL);
+    EXPECT_FALSE(r.reversed);
+}
+
+// a range of commanded states, all within the limits: the limits hold and the speed never reverses
+TEST(StopProfile, LimitsHoldOnGrid)
+{
+    for (int iv = -12; iv <= 12; iv++)
+    {
+        for (int ia = -2; ia <= 2; ia++)
+        {
+            double v0 = 0.05 * iv;
+            double a0 = 0.5 * A_MAX * ia;
+            // braking hard at low speed can't ease off in time without reversing; the profile clamps at zero then
+            if (a0 * v0 < 0.0 && fabs(v0) < 0.5 * a0 * a0 / J_MAX)
+            {
+                continue;
+            }
+            StopResult r = simulate_stop(v0, a0);
+            EXPECT_LE(r.max_accel, A_MAX + LIMIT_TOL) << "v0 " << v0 << " a0 " << a0;
+            EXPECT_LE(r.max_jerk, J_MAX + LIMIT_TOL) << "v0 " << v0 << " a0 " << a0;
+            EXPECT_FALSE(r.reversed) << "v0 " << v0 << " a0 " << a0;
+            EXPECT_LT(r.time, 5.0) << "v0 " << v0 << " a0 " << a0;
+        }
+    }
+}
+
+TEST(StopProfile, LatchAndRelease)
+{
+    StopProfile profile(A_MAX, J_MAX);
+    EXPECT_FALSE(profile.active());
+    profile.start(0.6, 0.0);
+    EXPECT_TRUE(profile.active());
+    for (int i = 0; i < 10; i++)
+    {
+        profile.update(DT);
+    }
+    double v = profile.speed();
+    EXPECT_LT(v, 0.6);
+    EXPECT_GT(v, 0.0);
+    EXPECT_LT(profile.accel(), 0.0);
+    // released mid-stop, the caller picks up from the profile's speed and accel
+    profile.release();
+    EXPECT_FALSE(profile.active());
+    EXPECT_DOUBLE_EQ(v, profile.speed());
+    // at rest, it stays at rest
+    profile.start(0.0, 0.0);
+    EXPECT_DOUBLE_EQ(0.0, profile.update(DT));
+    EXPECT_DOUBLE_EQ(0.0, profile.accel());
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
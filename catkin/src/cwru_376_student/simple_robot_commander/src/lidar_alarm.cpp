@@ -5,6 +5,8 @@
 #include <std_msgs/Float32.h>
 // boolean message time
 #include <std_msgs/Bool.h>
+// precomputed per-ping cos/sin tables
+#include <planar_geometry/scan_geometry.h>
 // we need to be able to math!
 #include <math.h>
 
@@ -28,6 +30,7 @@ double range_min_ = 0.0;
 double range_max_ = 0.0;
 double points_per_degree = -1;
 bool laser_alarm_ = false;
+planar_geometry::ScanGeometry scan_geometry_; // cos/sin of every ping angle; rebuilt only if the scan layout changes
 
 double pi = 3.14159653;
 
@@ -44,21 +47,15 @@ double deg_to_rad(float deg)
 	return deg / 180 * pi;
 }
 
-double index_to_deg_off_x(int index)
-{
-	return (index - ping_index_) / points_per_degree;
-}
-
-double index_to_rad_off_x(int index)
-{
-	return deg_to_rad(index_to_deg_off_x(index));
-}
-
 void laserCallback(const sensor_msgs::LaserScan &laser_scan)
 {
-    if (ping_index_ < 0)
+    if (laser_scan.ranges.empty())
+    {
+        return;
+    }
+    if (scan_geometry_.update(laser_scan.angle_min, laser_scan.angle_increment, laser_scan.ranges.size()))
     {
-        //for first message received, set up the desired index of LIDAR range to eval
+        //for first message received (or if the scan layout changes), set up the angle tables and the indices of LIDAR ranges to eval
         angle_min_ = laser_scan.angle_min;
         angle_max_ = laser_scan.angle_max;
         angle_increment_ = laser_scan.angle_increment;
@@ -67,11 +64,10 @@ void laserCallback(const sensor_msgs::LaserScan &laser_scan)
         // what is the index of the ping that is straight ahead?
         // BETTER would be to use transforms, which would reference how the LIDAR is mounted;
         // but this will do for simple illustration
-        ping_index_ = (int)((angle_max_ - angle_min_) / angle_increment_) / 2;
-        points_per_degree = ((ping_index_ * 2) / rad_to_deg(angle_max_ - angle_min_));
-        int consider_pings_one_side = points_per_degree * (FIELD_OF_VIEW / 2);
-        ping_low_limit_index_ = ping_index_ - consider_pings_one_side;
-        ping_high_limit_index_ = ping_index_ + consider_pings_one_side;
+        ping_index_ = scan_geometry_.index_of(0.0);
+        points_per_degree = 1.0 / rad_to_deg(angle_increment_);
+        ping_low_limit_index_ = scan_geometry_.index_of(deg_to_rad(-FIELD_OF_VIEW / 2));
+        ping_high_limit_index_ = scan_geometry_.index_of(deg_to_rad(FIELD_OF_VIEW / 2));
 
         // Print out some debug info
         ROS_INFO("LIDAR setup: ping_index = %d", ping_index_);
@@ -82,30 +78,16 @@ void laserCallback(const sensor_msgs::LaserScan &laser_scan)
         ROS_INFO("LIDAR setup: checking indicies %d through %d", ping_low_limit_index_, ping_high_limit_index_);
     }
 
-    ping_dist_in_front_ = laser_scan.ranges[ping_index_];
-    int too_close_count = 0;
-    for (int i = ping_low_limit_index_; i < ping_high_limit_index_; i++)
+    // count the pings in the field of view that are closer than MIN_SAFE_DISTANCE in x;
+    // a single branch-free pass over the ranges, with the cosines looked up rather than computed
+    const float *ranges = &laser_scan.ranges[0];
+    const float *cos_table = scan_geometry_.cos_table();
+    int too_close_count = planar_geometry::count_closer_in_x(ranges, cos_table, ping_low_limit_index_, ping_high_limit_index_, MIN_SAFE_DISTANCE);
+    laser_alarm_ = (too_close_count > ALLOWABLE_CLOSE_PINGS);
+    if (laser_alarm_)
     {
-    	double ping_dist_in_front_ = laser_scan.ranges[i];
-    	double cos_distance = ping_dist_in_front_ * std::cos(index_to_rad_off_x(i));
-    	if (!std::isinf(ping_dist_in_front_))
-    	{
-		    //ROS_INFO("ping dist %lf at angle %lfdeg", ping_dist_in_front_, index_to_deg_off_x(i));
-    	}
-        if (cos_distance < MIN_SAFE_DISTANCE)
-        {
-            ROS_WARN("There appears to be something in front of us, %lfdeg off center, %lfm away in x", index_to_deg_off_x(i), cos_distance);
-            if (++too_close_count > ALLOWABLE_CLOSE_PINGS)
-            {
-                ROS_WARN("DANGER, WILL ROBINSON!!");
-                laser_alarm_ = true;
-                break;
-            }
-        }
-        else
-        {
-            laser_alarm_ = false;
-        }
+        ROS_WARN("DANGER, WILL ROBINSON!! %d pings in front are closer than %lfm; nearest is %lfm away in x", too_close_count, MIN_SAFE_DISTANCE,
+                 planar_geometry::min_x(ranges, cos_table, ping_low_limit_index_, ping_high_limit_index_, range_max_));
     }
     ping_dist_in_front_ = laser_scan.ranges[ping_index_];
     std_msgs::Bool lidar_alarm_msg;
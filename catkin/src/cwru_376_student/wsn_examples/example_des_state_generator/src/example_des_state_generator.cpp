@@ -224,34 +224,22 @@ bool DesStateGenerator::appendPathCallback(cwru_srv::path_service_messageRequest
 
 //some conversion utilities:
 double DesStateGenerator::convertPlanarQuat2Phi(geometry_msgs::Quaternion quaternion) {
-    double quat_z = quaternion.z;
-    double quat_w = quaternion.w;
-    double phi = 2.0 * atan2(quat_z, quat_w); // cheap conversion from quaternion to heading for planar motion
-    return phi;
+    return planar_geometry::convertPlanarQuat2Phi(quaternion); // cheap conversion from quaternion to heading for planar motion
 }
 
 geometry_msgs::Quaternion  DesStateGenerator::convertPlanarPhi2Quaternion(double phi) {
-    geometry_msgs::Quaternion quaternion;
-    quaternion.x = 0.0;
-    quaternion.y = 0.0;
-    quaternion.z = sin(phi / 2.0);
-    quaternion.w = cos(phi / 2.0);
-    return quaternion;
+    return planar_geometry::convertPlanarPhi2Quaternion(phi);
 }
 
 //utility fnc to compute min dang, accounting for periodicity
 double DesStateGenerator::min_dang(double dang) {
-    if (dang > M_PI) dang -= 2.0 * M_PI;
-    if (dang<-M_PI) dang += 2.0 * M_PI;
-    return dang;
+    return planar_geometry::min_dang(dang); // wraps any multiple of 2pi, no loop
 }
 
 
 //given points v1 and v2 in a plane, compute the corresponding heading from v1 to v2
 double DesStateGenerator::compute_heading_from_v1_v2(Eigen::Vector2d v1, Eigen::Vector2d v2)  {
-        Eigen::Vector2d dv = v2 - v1; //vector from v1 to v2 
-        double heading_v1_to_v2 = atan2(dv(1), dv(0)); //heading from v1 to v2= target heading; head here incrementally  
-        return (heading_v1_to_v2); 
+    return planar_geometry::compute_heading_from_v1_v2(v1, v2); //heading from v1 to v2
 }
 
 //DUMMY...
@@ -26,6 +26,7 @@ const bool DEBUG_MODE=false; // change this for display/break-points
 
 
 #include <ros/ros.h> //ALWAYS need to include this
+#include <planar_geometry/planar_geometry.h> // shared sgn/sat/min_dang/quaternion utilities
 
 //message types used in this example code;  include more message types, as needed
 #include <std_msgs/Bool.h> 
@@ -103,10 +104,7 @@ public:
 
     // some utilities:
     //signum function: define this one in-line
-    double sgn(double x) { if (x>0.0) {return 1.0; }
-    else if (x<0.0) {return -1.0;}
-    else {return 0.0;}
-    }
+    double sgn(double x) { return planar_geometry::sgn(x); }
     
     bool get_waiting_for_vertex() { return waiting_for_vertex_; }  
     bool get_current_path_seg_done() { return current_path_seg_done_; }     
@@ -33,6 +33,7 @@ therefore, theta = 2*atan2(qz,qw)
 #include <std_msgs/Float64.h>
 #include <geometry_msgs/Twist.h>
 #include <nav_msgs/Odometry.h>
+#include <planar_geometry/planar_geometry.h>
 #include <math.h>
 
 
@@ -79,9 +80,7 @@ void odomCallback(const nav_msgs::Odometry& odom_rcvd) {
     odom_y_ = odom_rcvd.pose.pose.position.y;
     //odom publishes orientation as a quaternion.  Convert this to a simple heading
     // see notes above for conversion for simple planar motion
-    double quat_z = odom_rcvd.pose.pose.orientation.z;
-    double quat_w = odom_rcvd.pose.pose.orientation.w;
-    odom_phi_ = 2.0*atan2(quat_z, quat_w); // cheap conversion from quaternion to heading for planar motion
+    odom_phi_ = planar_geometry::convertPlanarQuat2Phi(odom_rcvd.pose.pose.orientation); // cheap conversion from quaternion to heading for planar motion
 
     // the output below could get annoying; may comment this out, but useful initially for debugging
     ROS_INFO("odom CB: x = %f, y= %f, phi = %f, v = %f, omega = %f", odom_x_, odom_y_, odom_phi_, odom_vel_, odom_omega_);
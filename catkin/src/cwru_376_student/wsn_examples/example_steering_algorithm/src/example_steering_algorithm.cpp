@@ -138,29 +138,18 @@ void SteeringController::desStateCallback(const nav_msgs::Odometry& des_state_rc
 
 //utility fnc to compute min dang, accounting for periodicity
 double SteeringController::min_dang(double dang) {
-    while (dang > M_PI) dang -= 2.0 * M_PI;
-    while (dang < -M_PI) dang += 2.0 * M_PI;
-    return dang;
+    return planar_geometry::min_dang(dang); // wraps any multiple of 2pi, no loop
 }
 
 
 // saturation function, values -1 to 1
 double SteeringController::sat(double x) {
-    if (x>1.0) {
-        return 1.0;
-    }
-    if (x< -1.0) {
-        return -1.0;
-    }
-    return x;
+    return planar_geometry::sat(x);
 }
 
 //some conversion utilities:
 double SteeringController::convertPlanarQuat2Phi(geometry_msgs::Quaternion quaternion) {
-    double quat_z = quaternion.z;
-    double quat_w = quaternion.w;
-    double phi = 2.0 * atan2(quat_z, quat_w); // cheap conversion from quaternion to heading for planar motion
-    return phi;
+    return planar_geometry::convertPlanarQuat2Phi(quaternion); // cheap conversion from quaternion to heading for planar motion
 }
 
 //member function implementation for a service callback function
@@ -12,6 +12,7 @@
 #include <vector>
 
 #include <ros/ros.h> //ALWAYS need to include this
+#include <planar_geometry/planar_geometry.h> // shared sgn/sat/min_dang/quaternion utilities
 
 //message types used in this example code;  include more message types, as needed
 #include <std_msgs/Bool.h> 
@@ -57,10 +58,7 @@ public:
 
     // some utilities:
     //signum function: define this one in-line
-    double sgn(double x) { if (x>0.0) {return 1.0; }
-    else if (x<0.0) {return -1.0;}
-    else {return 0.0;}
-    }
+    double sgn(double x) { return planar_geometry::sgn(x); }
 
 private:
     // put private member data here;  "private" data will only be available to member functions of this class;
@@ -12,6 +12,7 @@
 #include <vector>
 
 #include <ros/ros.h> //ALWAYS need to include this
+#include <planar_geometry/planar_geometry.h> // shared sgn/sat/min_dang/quaternion utilities
 
 #include <geometry_msgs/Twist.h>
 #include <geometry_msgs/TwistStamped.h>
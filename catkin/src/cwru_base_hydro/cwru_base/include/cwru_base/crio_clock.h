@@ -0,0 +1,105 @@
+/*
+ * File:   crio_clock.h
+ *
+ * CrioClock: estimates when the cRIO actually sent a packet, in host time, from the cRIO's own time for it
+ * (e.g. a sequence number times the nominal packet period) and the host's receive time.
+ *
+ * Receive time = send time + network/stack delay + queueing, and the delay is never negative, so the packets
+ * that arrived fastest trace a lower envelope of (cRIO time, receive time) that runs parallel to the true clock
+ * mapping. The model is
+ *     host = host0 + offset + (crio - crio0) * (1 + drift)
+ * fit to that envelope: a packet below the line pulls the offset down right away; once per window, the line is
+ * refit through the lowest points of the last two windows, which tracks drift between the two clocks
+ * (including the difference between the nominal and true cRIO packet period).
+ * The estimate still includes the smallest delay ever seen, which is constant and can't be separated from the
+ * clock offset with one-way timing.
+ */
+
+#ifndef _CRIO_CLOCK_H
+#define	_CRIO_CLOCK_H
+
+#include <math.h>
+
+namespace cwru_base {
+  class CrioClock {
+    public:
+      // window: sec of cRIO time per drift update; drift_gain: filter gain for each update, 0..1;
+      // reset_threshold: sec; a packet further than this off the model (e.g. the cRIO rebooted) restarts the fit
+      CrioClock(double window, double drift_gain, double reset_threshold) :
+        window_(window), drift_gain_(drift_gain), reset_threshold_(reset_threshold) {
+        reset();
+      }
+
+      void reset() {
+        n_packets_ = 0;
+        offset_ = 0.0;
+        drift_ = 0.0;
+        window_start_ = 0.0;
+        have_prev_min_ = false;
+        window_min_x_ = 0.0;
+        window_min_y_ = 0.0;
+        window_min_r_ = INFINITY;
+      }
+
+      // fold in one packet; returns the estimated host time at which the cRIO sent it
+      double update(double crio_time, double host_time) {
+        if (n_packets_ == 0) {
+          crio0_ = crio_time;
+          host0_ = host_time;
+          window_start_ = 0.0;
+        }
+        double x = crio_time - crio0_;
+        double y = host_time - host0_;
+        double r = y - (offset_ + x * (1.0 + drift_)); // delay beyond the envelope
+        if (n_packets_ > 0 && fabs(r) > reset_threshold_) {
+          reset();
+          return update(crio_time, host_time);
+        }
+        n_packets_++;
+        if (r < 0.0) {
+          offset_ += r; // faster than anything so far: the envelope is lower than we thought
+        }
+        // lowest point of this window, independent of the current offset
+        double r_drift = y - x * (1.0 + drift_);
+        if (r_drift < window_min_r_) {
+          window_min_r_ = r_drift;
+          window_min_x_ = x;
+          window_min_y_ = y;
+        }
+        if (x - window_start_ >= window_) {
+          if (have_prev_min_ && window_min_x_ > prev_min_x_) {
+            double slope = (window_min_y_ - prev_min_y_) / (window_min_x_ - prev_min_x_);
+            drift_ += drift_gain_ * ((slope - 1.0) - drift_);
+            offset_ = window_min_y_ - window_min_x_ * (1.0 + drift_);
+          }
+          prev_min_x_ = window_min_x_;
+          prev_min_y_ = window_min_y_;
+          have_prev_min_ = true;
+          window_min_r_ = INFINITY;
+          window_start_ = x;
+        }
+        return host0_ + offset_ + x * (1.0 + drift_);
+      }
+
+      bool synced() const { return have_prev_min_; } // at least one full window seen
+      double drift() const { return drift_; } // host sec per cRIO sec, minus 1
+      double offset() const { return offset_; } // sec, relative to the first packet's receive time
+      long packets() const { return n_packets_; }
+
+    private:
+      double window_;
+      double drift_gain_;
+      double reset_threshold_;
+      long n_packets_;
+      double crio0_;
+      double host0_;
+      double offset_;
+      double drift_;
+      double window_start_;
+      bool have_prev_min_;
+      double prev_min_x_, prev_min_y_;
+      double window_min_x_, window_min_y_, window_min_r_;
+  };
+};
+
+#endif	/* _CRIO_CLOCK_H */
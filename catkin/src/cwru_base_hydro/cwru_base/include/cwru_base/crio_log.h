@@ -0,0 +1,57 @@
+/*
+ * File:   crio_log.h
+ *
+ * Binary log of raw cRIO datagrams, for capture (crio_receiver ~capture_file), replay (~replay_file) and
+ * crio_log_sender. The file starts with the 8-byte magic "CRIOLOG1"; each datagram follows as a
+ * CrioLogRecord header and then its bytes exactly as received (big-endian, not decoded).
+ * The header fields are in host byte order, since logs are made and replayed on the same kind of machine.
+ */
+
+#ifndef _CRIO_LOG_H
+#define	_CRIO_LOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <ros/ros.h>
+
+namespace cwru_base {
+  const char CRIO_LOG_MAGIC[8] = { 'C', 'R', 'I', 'O', 'L', 'O', 'G', '1' };
+
+  struct CrioLogRecord {
+    uint32_t sec; // kernel receive time, wall clock
+    uint32_t nsec;
+    uint32_t length; // datagram bytes that follow
+  };
+
+  class CrioLogWriter {
+    public:
+      CrioLogWriter();
+      ~CrioLogWriter();
+      // appends to path (writing the magic if the file is new); false if it can't be opened
+      bool open(const std::string& path);
+      void close();
+      bool isOpen() const { return file_ != NULL; }
+      // buffered; call flush() now and then so a crash loses little
+      bool write(const ros::WallTime& receive_time, const void* data, size_t length);
+      void flush();
+    private:
+      FILE* file_;
+  };
+
+  class CrioLogReader {
+    public:
+      CrioLogReader();
+      ~CrioLogReader();
+      // false if path can't be opened or isn't a cRIO log
+      bool open(const std::string& path);
+      void close();
+      // reads the next datagram into data (at most max_length bytes; the rest of a longer one is skipped, and
+      // length is its full size); false at the end of the log or on a cut-off record
+      bool next(ros::WallTime& receive_time, void* data, size_t max_length, size_t& length);
+    private:
+      FILE* file_;
+  };
+};
+
+#endif	/* _CRIO_LOG_H */
@@ -0,0 +1,189 @@
+/*
+ * File:   crio_receiver.h
+ *
+ * CrioReceiver: turns the UDP packets from the cRIO into ROS messages.
+ * Shared by the crio_receiver node and the CrioReceiverNodelet, so both run exactly the same receive loop.
+ */
+
+#ifndef _CRIO_RECEIVER_H
+#define	_CRIO_RECEIVER_H
+
+#include <sys/socket.h>
+#include <time.h>
+#include <ros/ros.h>
+#include <cwru_base/packets.h>
+#include <cwru_base/packet_decoder.h>
+#include <cwru_base/crio_clock.h>
+#include <cwru_base/crio_log.h>
+#include <cwru_base/estop_flag.h>
+#include <cwru_msgs/Pose.h>
+#include <cwru_msgs/PowerState.h>
+#include <cwru_msgs/Sonar.h>
+#include <cwru_msgs/SonarArray.h>
+#include <cwru_msgs/cRIOSensors.h>
+#include <cwru_msgs/NavSatFix.h>
+#include <std_msgs/Bool.h>
+#include <diagnostic_updater/diagnostic_updater.h>
+#include <diagnostic_updater/publisher.h>
+
+namespace cwru_base {
+  const int CRIO_PORT = 50000;
+  const int RECV_BATCH_SIZE = 32; // most datagrams taken from the socket per recvmmsg() call
+  const double DIAGNOSTICS_INTERVAL = 0.5; // sec between updater_.update() calls (it publishes at its own ~diagnostic_period)
+  // cRIO clock sync (param ~pose_sequence_in_padding): see crio_clock.h
+  const double CLOCK_SYNC_WINDOW = 5.0; // sec per drift update
+  const double CLOCK_DRIFT_GAIN = 0.5;
+  const double CLOCK_RESET_THRESHOLD = 1.0; // sec
+
+  // one received datagram, with the kernel's receive time (SO_TIMESTAMPNS)
+  struct ReceivedPacket {
+    CRIOPacket packet; // decoded in place
+    size_t length;
+    ros::WallTime receive_time;
+  };
+
+  // publishes every decimation-th update of a topic, and counts what was published and skipped
+  struct TopicDecimator {
+    TopicDecimator() : decimation(1), countdown(1), n_published(0), n_skipped(0) {}
+    bool due() {
+      if (--countdown > 0) {
+        n_skipped++;
+        return false;
+      }
+      countdown = decimation;
+      n_published++;
+      return true;
+    }
+    int decimation;
+    int countdown;
+    long n_published; // since the last diagnostics update
+    long n_skipped;
+  };
+
+  class CrioReceiver {
+    public:
+      // nh: where the topics go; priv_nh: where the parameters are read from
+      CrioReceiver(ros::NodeHandle nh, ros::NodeHandle priv_nh);
+      ~CrioReceiver();
+      // receive and dispatch packets until nh shuts down or stop() is called (noticed within DIAGNOSTICS_INTERVAL);
+      // each wakeup drains every datagram waiting on the socket, RECV_BATCH_SIZE at a time, and dispatches them in order.
+      // With ~replay_file set, dispatches the packets of that log instead, and returns at its end
+      void run();
+      void stop();
+      // receive_stamp: kernel receive time of the packet, in ROS time
+      // decodes rx.packet in place
+      void dispatchReceivedPacket(ReceivedPacket& rx, const ros::Time& receive_stamp);
+      // the handlers take packets already in host byte order
+      void handlePosePacket(CRIOPosePacket& swapped_packet, const ros::Time& receive_stamp);
+      void handleDiagnosticsPacket(const CRIODiagnosticsPacket& swapped_packet, const ros::Time& receive_stamp);
+      void handleGPSPacket(const CRIOGPSPacket& swapped_packet, const ros::Time& receive_stamp);
+      void updateDiagnostics();
+    private:
+      void checkEncoderTicks(diagnostic_updater::DiagnosticStatusWrapper &stat);
+      void checkYawSensor(diagnostic_updater::DiagnosticStatusWrapper &stat);
+      void checkVoltageLevels(diagnostic_updater::DiagnosticStatusWrapper &stat);
+      void checkGPSValues(diagnostic_updater::DiagnosticStatusWrapper &stat);
+      void checkReceiveStats(diagnostic_updater::DiagnosticStatusWrapper &stat);
+      void checkPublishStats(diagnostic_updater::DiagnosticStatusWrapper &stat);
+      void checkEstop(diagnostic_updater::DiagnosticStatusWrapper &stat);
+      void handleEstop(const ReceivedPacket& rx);
+      void addPublishStats(diagnostic_updater::DiagnosticStatusWrapper &stat, const std::string& topic, TopicDecimator& decimator);
+      void readDecimation(const std::string& param, TopicDecimator& decimator);
+      void receiveLoop();
+      void replayLoop();
+      int drainSocket(int fd);
+      void dispatchBatch(int n_packets);
+      ros::Time poseStamp(const CRIOPosePacket& packet, const ros::Time& receive_stamp);
+      void handleSonarPings(const ros::Time& stamp, const CRIOPosePacket& packet);
+      void handleSonarPing(const ros::Time& stamp, const float ping_value, const std::string& frame_id, ros::Publisher& sonar_pub);
+      void setupDiagnostics();
+      ros::NodeHandle nh_;
+      ros::NodeHandle priv_nh_;
+      ros::Publisher estop_pub_;
+      ros::Publisher flipped_pose_pub_;
+      ros::Publisher sonar1_pub_;
+      ros::Publisher sonar2_pub_;
+      ros::Publisher sonar3_pub_;
+      ros::Publisher sonar4_pub_;
+      ros::Publisher sonar5_pub_;
+      ros::Publisher gps_pub_;
+      ros::Publisher power_pub_;
+      ros::Publisher sonar_array_pub_;
+      diagnostic_updater::Updater updater_;
+      diagnostic_updater::DiagnosedPublisher<cwru_msgs::Pose> pose_pub_;
+      diagnostic_updater::DiagnosedPublisher<cwru_msgs::cRIOSensors> sensor_pub_;
+      double desired_pose_freq_;
+      // output rates: ~<topic>_decimation publishes every Nth packet (pose covers flipped_pose too, sonar covers
+      // the sonar_N topics and sonar_array); the diagnosed publishers expect desired_pose_freq_ / decimation
+      TopicDecimator pose_decimator_;
+      TopicDecimator sonar_decimator_;
+      TopicDecimator power_decimator_;
+      TopicDecimator sensors_decimator_;
+      TopicDecimator gps_decimator_;
+      double pose_pub_freq_;
+      double sensors_pub_freq_;
+      // ~sonar_output: "individual" (sonar_1..sonar_5), "array" (one cwru_msgs/SonarArray on sonar_array) or "both"
+      bool publish_sonar_individual_;
+      bool publish_sonar_array_;
+      // e-stop fast path: before a batch is dispatched, its diagnostics packets are checked for eStopTriggered,
+      // and the state goes straight to estop_flag_ (shared memory, name ~estop_flag, "" for none) and, when it
+      // changes, to motors_enabled. motors_enabled is latched, so it's otherwise only republished every
+      // ~estop_republish_interval sec (0: every packet) as a heartbeat.
+      // ~realtime_priority (1-99, 0 for none) runs the receive thread SCHED_FIFO, ahead of everything else
+      double estop_republish_interval_;
+      int realtime_priority_;
+      std::string estop_flag_name_;
+      EstopFlag estop_flag_;
+      bool have_motors_enabled_;
+      bool last_motors_enabled_;
+      ros::WallTime last_estop_publish_time_;
+      long n_estop_published_;
+      long n_estop_skipped_;
+      // kernel receive time to the e-stop state being out: worst over the whole run, not reset by diagnostics
+      long n_estop_changes_;
+      double last_estop_change_latency_;
+      double max_estop_change_latency_;
+      double max_estop_latency_; // any diagnostics packet, changed or not
+      double lenc_high_warn_, lenc_low_warn_, lenc_high_err_, lenc_low_err_;
+      double renc_high_warn_, renc_low_warn_, renc_high_err_, renc_low_err_;
+      bool push_casters_;
+      int socket_timeout_;
+      volatile bool stop_requested_;
+      // capture/replay (see crio_log.h): ~capture_file appends every received datagram to a log;
+      // ~replay_file reads datagrams from a log instead of the socket, at ~replay_rate times the recorded
+      // speed (0: as fast as possible)
+      std::string capture_file_;
+      std::string replay_file_;
+      double replay_rate_;
+      CrioLogWriter capture_log_;
+      // receive batch, preallocated: recvmmsg() fills rx_batch_[i] through rx_msgs_[i]/rx_iov_[i], and the
+      // kernel receive time arrives as a control message in rx_control_[i]
+      ReceivedPacket rx_batch_[RECV_BATCH_SIZE];
+      struct mmsghdr rx_msgs_[RECV_BATCH_SIZE];
+      struct iovec rx_iov_[RECV_BATCH_SIZE];
+      char rx_control_[RECV_BATCH_SIZE][CMSG_SPACE(sizeof(struct timespec))];
+      // receive stats, reset each time the diagnostics are published
+      long n_packets_received_;
+      long n_wakeups_;
+      int max_batch_;
+      long n_truncated_;
+      long n_short_packets_;
+      long n_receive_errors_;
+      double sum_dispatch_delay_;
+      double max_dispatch_delay_;
+      // clock sync: with pose_sequence_in_padding_, the cRIO puts a 24-bit pose packet counter, big-endian, in the
+      // pose packet's padding bytes (data1..data3); counter * nominal period (1/expected_pose_freq) is the cRIO's
+      // time for the packet, and crio_clock_ maps it to host time
+      bool pose_sequence_in_padding_;
+      CrioClock crio_clock_;
+      bool have_pose_sequence_;
+      uint32_t last_pose_sequence_;
+      long pose_sequence_; // unwrapped
+      long n_pose_packets_dropped_;
+      CRIODiagnosticsPacket diagnostics_info_;
+      CRIOPosePacket pose_packet_;
+      CRIOGPSPacket gps_packet_;
+  };
+};
+
+#endif	/* _CRIO_RECEIVER_H */
@@ -0,0 +1,130 @@
+/*
+ * File:   estop_flag.h
+ *
+ * EstopFlag: the motors_enabled state in a shared-memory page (/dev/shm/<name>), written by crio_receiver as
+ * soon as a diagnostics packet arrives, and readable by any process on the robot PC with a couple of memory
+ * loads: no topic, no callback, no spin.
+ * The writer refreshes the stamp on every diagnostics packet, so a reader can tell a live flag from one left
+ * behind by a dead receiver (compare the receive time read() returns against ESTOP_FLAG_TIMEOUT, and fall back
+ * on the motors_enabled topic).
+ * Updates are guarded by a sequence count (odd while a write is in progress), so a reader never sees half of one.
+ * Header-only, so other packages need only cwru_base's include path.
+ */
+
+#ifndef _ESTOP_FLAG_H
+#define	_ESTOP_FLAG_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <string>
+#include <ros/ros.h>
+
+namespace cwru_base {
+  const char DEFAULT_ESTOP_FLAG[] = "cwru_motors_enabled";
+  const double ESTOP_FLAG_TIMEOUT = 0.5; // sec; the cRIO sends diagnostics much faster than this
+  const uint32_t ESTOP_FLAG_MAGIC = 0x45535430; // "EST0"
+  const int ESTOP_FLAG_READ_TRIES = 1000; // a writer that died mid-update leaves the count odd for good
+
+  struct EstopFlagData {
+    volatile uint32_t magic; // set once the first state is written
+    volatile uint32_t sequence;
+    volatile uint32_t motors_enabled;
+    volatile uint32_t changes; // number of motors_enabled changes seen
+    volatile int64_t receive_ns; // wall-clock receive time of the packet that last wrote the flag
+  };
+
+  class EstopFlag {
+    public:
+      EstopFlag() : data_(NULL) {}
+      ~EstopFlag() {
+        close();
+      }
+
+      // writer creates the page if needed; false (and the flag stays closed) if it can't be mapped
+      bool open(const std::string& name, bool writer) {
+        close();
+        std::string path = "/dev/shm/" + name;
+        int fd = ::open(path.c_str(), writer ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+        if (fd < 0) {
+          return false;
+        }
+        if (writer && ftruncate(fd, sizeof(EstopFlagData)) < 0) {
+          ::close(fd);
+          return false;
+        }
+        void* mapped = mmap(NULL, sizeof(EstopFlagData), writer ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+          return false;
+        }
+        data_ = (EstopFlagData*) mapped;
+        if (writer && (data_->sequence & 1)) {
+          data_->sequence++; // the last writer died mid-update
+        }
+        return true;
+      }
+
+      void close() {
+        if (data_ != NULL) {
+          munmap((void*) data_, sizeof(EstopFlagData));
+          data_ = NULL;
+        }
+      }
+
+      bool isOpen() const { return data_ != NULL; }
+
+      void write(bool motors_enabled, const ros::WallTime& receive_time) {
+        if (data_ == NULL) {
+          return;
+        }
+        data_->sequence++;
+        __sync_synchronize();
+        if (data_->magic == ESTOP_FLAG_MAGIC && data_->motors_enabled != (uint32_t) motors_enabled) {
+          data_->changes++;
+        }
+        data_->motors_enabled = motors_enabled;
+        data_->receive_ns = (int64_t) receive_time.sec * 1000000000LL + receive_time.nsec;
+        data_->magic = ESTOP_FLAG_MAGIC;
+        __sync_synchronize();
+        data_->sequence++;
+      }
+
+      // false if the flag isn't open, has never been written, or is stuck mid-write
+      bool read(bool& motors_enabled, ros::WallTime& receive_time, uint32_t& changes) const {
+        if (data_ == NULL) {
+          return false;
+        }
+        for (int tries = 0; tries < ESTOP_FLAG_READ_TRIES; tries++) {
+          uint32_t sequence = data_->sequence;
+          if (sequence & 1) {
+            continue; // mid-write
+          }
+          __sync_synchronize();
+          uint32_t magic = data_->magic;
+          uint32_t enabled = data_->motors_enabled;
+          uint32_t n_changes = data_->changes;
+          int64_t receive_ns = data_->receive_ns;
+          __sync_synchronize();
+          if (data_->sequence != sequence) {
+            continue;
+          }
+          if (magic != ESTOP_FLAG_MAGIC) {
+            return false;
+          }
+          motors_enabled = (enabled != 0);
+          receive_time = ros::WallTime(receive_ns / 1000000000LL, receive_ns % 1000000000LL);
+          changes = n_changes;
+          return true;
+        }
+        return false;
+      }
+
+    private:
+      EstopFlagData* data_;
+  };
+};
+
+#endif	/* _ESTOP_FLAG_H */
@@ -0,0 +1,161 @@
+/*
+ * File:   packet_decoder.h
+ *
+ * Table-driven decoding of the cRIO's big-endian packets, in place in the receive buffer.
+ * Each packet type has a layout: the shortest valid length, and the list of multi-byte fields to byte-swap
+ * (offset and size, taken from the packet structs at compile time). Single-byte fields need no swapping and
+ * aren't listed. Decoding a packet is one length check and one pass over its field list; nothing is copied.
+ */
+
+#ifndef _PACKET_DECODER_H
+#define	_PACKET_DECODER_H
+
+#include <endian.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <cwru_base/packets.h>
+
+namespace cwru_base {
+  // a receive buffer, viewable as any of the packets; the union also aligns it for the widest field
+  union CRIOPacket {
+    CRIOCommand command;
+    CRIOPosePacket pose;
+    CRIODiagnosticsPacket diagnostics;
+    CRIOGPSPacket gps;
+  };
+
+  struct FieldSwap {
+    uint16_t offset;
+    uint8_t size; // 2, 4 or 8 bytes
+  };
+
+  struct PacketLayout {
+    int8_t type;
+    size_t min_length; // bytes up to the end of the last field; shorter datagrams are rejected
+    const FieldSwap* fields;
+    int n_fields;
+  };
+
+#define CRIO_FIELD(packet, field) { offsetof(packet, field), sizeof(((packet*) 0)->field) }
+#define CRIO_PACKET_END(packet, last_field) (offsetof(packet, last_field) + sizeof(((packet*) 0)->last_field))
+
+  const FieldSwap POSE_FIELDS[] = {
+    CRIO_FIELD(CRIOPosePacket, x),
+    CRIO_FIELD(CRIOPosePacket, y),
+    CRIO_FIELD(CRIOPosePacket, theta),
+    CRIO_FIELD(CRIOPosePacket, vel),
+    CRIO_FIELD(CRIOPosePacket, omega),
+    CRIO_FIELD(CRIOPosePacket, yaw_bias),
+    CRIO_FIELD(CRIOPosePacket, x_variance),
+    CRIO_FIELD(CRIOPosePacket, y_variance),
+    CRIO_FIELD(CRIOPosePacket, theta_variance),
+    CRIO_FIELD(CRIOPosePacket, vel_variance),
+    CRIO_FIELD(CRIOPosePacket, omega_variance),
+    CRIO_FIELD(CRIOPosePacket, yaw_bias_variance),
+    CRIO_FIELD(CRIOPosePacket, sonar_ping_1),
+    CRIO_FIELD(CRIOPosePacket, sonar_ping_2),
+    CRIO_FIELD(CRIOPosePacket, sonar_ping_3),
+    CRIO_FIELD(CRIOPosePacket, sonar_ping_4),
+    CRIO_FIELD(CRIOPosePacket, sonar_ping_5),
+  };
+
+  const FieldSwap DIAGNOSTICS_FIELDS[] = {
+    CRIO_FIELD(CRIODiagnosticsPacket, FPGAVersion),
+    CRIO_FIELD(CRIODiagnosticsPacket, VMonitor_cRIO_mV),
+    CRIO_FIELD(CRIODiagnosticsPacket, LWheelTicks),
+    CRIO_FIELD(CRIODiagnosticsPacket, RWheelTicks),
+    CRIO_FIELD(CRIODiagnosticsPacket, LMotorTicks),
+    CRIO_FIELD(CRIODiagnosticsPacket, RMotorTicks),
+    CRIO_FIELD(CRIODiagnosticsPacket, VMonitor_24V_mV),
+    CRIO_FIELD(CRIODiagnosticsPacket, VMonitor_13V_mV),
+    CRIO_FIELD(CRIODiagnosticsPacket, VMonitor_5V_mV),
+    CRIO_FIELD(CRIODiagnosticsPacket, VMonitor_eStop_mV),
+    CRIO_FIELD(CRIODiagnosticsPacket, YawRate_mV),
+    CRIO_FIELD(CRIODiagnosticsPacket, YawSwing_mV),
+    CRIO_FIELD(CRIODiagnosticsPacket, YawTemp_mV),
+    CRIO_FIELD(CRIODiagnosticsPacket, YawRef_mV),
+    CRIO_FIELD(CRIODiagnosticsPacket, C1Steering),
+    CRIO_FIELD(CRIODiagnosticsPacket, C2Throttle),
+    CRIO_FIELD(CRIODiagnosticsPacket, C3Mode),
+  };
+
+  const FieldSwap GPS_FIELDS[] = {
+    CRIO_FIELD(CRIOGPSPacket, latitude),
+    CRIO_FIELD(CRIOGPSPacket, longitude),
+    CRIO_FIELD(CRIOGPSPacket, lat_std_dev),
+    CRIO_FIELD(CRIOGPSPacket, long_std_dev),
+    CRIO_FIELD(CRIOGPSPacket, solution_status),
+    CRIO_FIELD(CRIOGPSPacket, position_type),
+    CRIO_FIELD(CRIOGPSPacket, differential_age),
+    CRIO_FIELD(CRIOGPSPacket, solution_age),
+  };
+
+#define CRIO_N_FIELDS(fields) ((int) (sizeof(fields) / sizeof(fields[0])))
+
+  const PacketLayout PACKET_LAYOUTS[] = {
+    { POSE_t, CRIO_PACKET_END(CRIOPosePacket, sonar_ping_5), POSE_FIELDS, CRIO_N_FIELDS(POSE_FIELDS) },
+    { DIAGNOSTICS_t, CRIO_PACKET_END(CRIODiagnosticsPacket, RCeStop), DIAGNOSTICS_FIELDS, CRIO_N_FIELDS(DIAGNOSTICS_FIELDS) },
+    { GPS_t, CRIO_PACKET_END(CRIOGPSPacket, solution_age), GPS_FIELDS, CRIO_N_FIELDS(GPS_FIELDS) },
+  };
+  const int N_PACKET_LAYOUTS = CRIO_N_FIELDS(PACKET_LAYOUTS);
+
+  // layout for a packet type; NULL if we don't handle that type
+  inline const PacketLayout* findPacketLayout(int8_t type) {
+    for (int i = 0; i < N_PACKET_LAYOUTS; i++) {
+      if (PACKET_LAYOUTS[i].type == type) {
+        return &PACKET_LAYOUTS[i];
+      }
+    }
+    return NULL;
+  }
+
+  // big-endian to host order, in place, for every field in the layout
+  // (memcpy in and out, so float and double fields are swapped as raw bits, with no aliasing games)
+  inline void swapFieldsInPlace(void* packet, const PacketLayout& layout) {
+    uint8_t* bytes = (uint8_t*) packet;
+    for (int i = 0; i < layout.n_fields; i++) {
+      uint8_t* field = bytes + layout.fields[i].offset;
+      if (layout.fields[i].size == 2) {
+        uint16_t v;
+        memcpy(&v, field, 2);
+        v = be16toh(v);
+        memcpy(field, &v, 2);
+      } else if (layout.fields[i].size == 4) {
+        uint32_t v;
+        memcpy(&v, field, 4);
+        v = be32toh(v);
+        memcpy(field, &v, 4);
+      } else {
+        uint64_t v;
+        memcpy(&v, field, 8);
+        v = be64toh(v);
+        memcpy(field, &v, 8);
+      }
+    }
+  }
+
+  enum DecodeStatus {
+    DECODED,
+    UNKNOWN_TYPE, // a type we don't handle; left as received
+    SHORT_PACKET, // too short for its type (or empty); left as received
+  };
+
+  // a received datagram of "length" bytes, checked against its type's layout and swapped to host order in place
+  inline DecodeStatus decodePacketInPlace(CRIOPacket& packet, size_t length) {
+    if (length < 1) {
+      return SHORT_PACKET; // not even a type byte
+    }
+    const PacketLayout* layout = findPacketLayout(packet.command.type);
+    if (layout == NULL) {
+      return UNKNOWN_TYPE;
+    }
+    if (length < layout->min_length) {
+      return SHORT_PACKET;
+    }
+    swapFieldsInPlace(&packet, *layout);
+    return DECODED;
+  }
+};
+
+#endif	/* _PACKET_DECODER_H */
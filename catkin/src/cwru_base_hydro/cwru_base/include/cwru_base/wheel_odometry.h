@@ -0,0 +1,93 @@
+/*
+ * File:   wheel_odometry.h
+ *
+ * WheelOdometry: differential-drive dead reckoning from the encoder counts in crio_sensors, published as
+ * nav_msgs/Odometry on wheel_odom (and optionally as tf) once per cRIO diagnostics packet.
+ * Between packets it can republish the last state extrapolated with the current velocity, so a controller
+ * running faster than the cRIO still sees fresh state. It also cross-checks the distance and heading change
+ * against the cRIO's own pose estimate, and reports the ratio in diagnostics (use it to calibrate
+ * ~meters_per_tick, or to spot wheel slip).
+ * Shared by the wheel_odometry node and the WheelOdometryNodelet.
+ */
+
+#ifndef _WHEEL_ODOMETRY_H
+#define	_WHEEL_ODOMETRY_H
+
+#include <stdint.h>
+#include <ros/ros.h>
+#include <nav_msgs/Odometry.h>
+#include <tf/transform_broadcaster.h>
+#include <cwru_msgs/cRIOSensors.h>
+#include <cwru_msgs/Pose.h>
+#include <diagnostic_updater/diagnostic_updater.h>
+
+namespace cwru_base {
+  // placeholders until calibrated against the "cRIO Distance Ratio" diagnostic
+  const double DEFAULT_METERS_PER_TICK = 0.0005;
+  const double DEFAULT_TRACK_WIDTH = 0.56; // m between the wheel contact points
+  const double MAX_WHEEL_SPEED = 5.0; // m/s; bigger jumps between packets are encoder glitches or resets, not motion
+  const double CROSS_CHECK_DISTANCE = 1.0; // m of cRIO travel per distance/heading comparison
+
+  // ticks moved between two readings of an encoder_bits-wide counter, across rollover
+  inline int32_t tickDelta(int32_t now, int32_t prev, int encoder_bits) {
+    uint32_t delta = (uint32_t) now - (uint32_t) prev;
+    if (encoder_bits >= 32) {
+      return (int32_t) delta;
+    }
+    uint32_t mask = (1u << encoder_bits) - 1;
+    delta &= mask;
+    if (delta & (1u << (encoder_bits - 1))) {
+      delta |= ~mask; // sign-extend: the counter went backward
+    }
+    return (int32_t) delta;
+  }
+
+  class WheelOdometry {
+    public:
+      WheelOdometry(ros::NodeHandle nh, ros::NodeHandle priv_nh);
+    private:
+      void sensorsCallback(const cwru_msgs::cRIOSensors::ConstPtr& sensors);
+      void poseCallback(const cwru_msgs::Pose::ConstPtr& pose);
+      void extrapolationCallback(const ros::TimerEvent& event);
+      void diagnosticsCallback(const ros::TimerEvent& event);
+      void checkCrossCheck(diagnostic_updater::DiagnosticStatusWrapper &stat);
+      void publish(const ros::Time& stamp, double x, double y, double theta);
+      ros::NodeHandle nh_;
+      ros::NodeHandle priv_nh_;
+      ros::Subscriber sensors_sub_;
+      ros::Subscriber pose_sub_;
+      ros::Publisher odom_pub_;
+      tf::TransformBroadcaster tf_broadcaster_;
+      ros::Timer extrapolation_timer_;
+      ros::Timer diagnostics_timer_;
+      diagnostic_updater::Updater updater_;
+      // params
+      double left_meters_per_tick_;
+      double right_meters_per_tick_;
+      double track_width_;
+      bool use_motor_ticks_; // count motor ticks (geared) instead of wheel ticks
+      int encoder_bits_;
+      std::string odom_frame_;
+      std::string base_frame_;
+      bool publish_tf_;
+      double max_extrapolation_; // sec past the last packet that extrapolated state is still published
+      // state, in odom_frame_
+      bool have_ticks_;
+      int32_t last_left_ticks_;
+      int32_t last_right_ticks_;
+      ros::Time last_stamp_;
+      double x_, y_, theta_;
+      double vel_, omega_;
+      long n_glitches_;
+      // cross-check: path length and heading change over the same stretch, from the encoders and from the cRIO
+      bool have_crio_pose_;
+      double last_crio_x_, last_crio_y_, last_crio_theta_;
+      double encoder_distance_, encoder_turn_;
+      double crio_distance_, crio_turn_;
+      double distance_ratio_; // encoder / cRIO, over the last CROSS_CHECK_DISTANCE
+      double turn_error_; // encoder - cRIO, rad
+      bool have_cross_check_;
+  };
+};
+
+#endif	/* _WHEEL_ODOMETRY_H */
@@ -0,0 +1,107 @@
+/*
+ * CrioLogWriter/CrioLogReader: the cRIO datagram log; format in crio_log.h.
+ */
+
+#include <string.h>
+#include <cwru_base/crio_log.h>
+
+namespace cwru_base {
+  CrioLogWriter::CrioLogWriter() : file_(NULL) {
+  }
+
+  CrioLogWriter::~CrioLogWriter() {
+    close();
+  }
+
+  bool CrioLogWriter::open(const std::string& path) {
+    close();
+    file_ = fopen(path.c_str(), "ab");
+    if (file_ == NULL) {
+      return false;
+    }
+    if (ftell(file_) == 0 && fwrite(CRIO_LOG_MAGIC, sizeof(CRIO_LOG_MAGIC), 1, file_) != 1) {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void CrioLogWriter::close() {
+    if (file_ != NULL) {
+      fclose(file_);
+      file_ = NULL;
+    }
+  }
+
+  bool CrioLogWriter::write(const ros::WallTime& receive_time, const void* data, size_t length) {
+    if (file_ == NULL) {
+      return false;
+    }
+    CrioLogRecord record;
+    record.sec = receive_time.sec;
+    record.nsec = receive_time.nsec;
+    record.length = length;
+    return fwrite(&record, sizeof(record), 1, file_) == 1 && fwrite(data, 1, length, file_) == length;
+  }
+
+  void CrioLogWriter::flush() {
+    if (file_ != NULL) {
+      fflush(file_);
+    }
+  }
+
+  CrioLogReader::CrioLogReader() : file_(NULL) {
+  }
+
+  CrioLogReader::~CrioLogReader() {
+    close();
+  }
+
+  bool CrioLogReader::open(const std::string& path) {
+    close();
+    file_ = fopen(path.c_str(), "rb");
+    if (file_ == NULL) {
+      return false;
+    }
+    char magic[sizeof(CRIO_LOG_MAGIC)];
+    if (fread(magic, sizeof(magic), 1, file_) != 1 || memcmp(magic, CRIO_LOG_MAGIC, sizeof(magic)) != 0) {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void CrioLogReader::close() {
+    if (file_ != NULL) {
+      fclose(file_);
+      file_ = NULL;
+    }
+  }
+
+  bool CrioLogReader::next(ros::WallTime& receive_time, void* data, size_t max_length, size_t& length) {
+    if (file_ == NULL) {
+      return false;
+    }
+    CrioLogRecord record;
+    if (fread(&record, sizeof(record), 1, file_) != 1) {
+      return false;
+    }
+    size_t n_read = record.length < max_length ? record.length : max_length;
+    if (fread(data, 1, n_read, file_) != n_read) {
+      return false;
+    }
+    // skip the rest by reading it, not with fseek, which happily goes past the end of a cut-off log
+    size_t to_skip = record.length - n_read;
+    while (to_skip > 0) {
+      char scratch[256];
+      size_t n = to_skip < sizeof(scratch) ? to_skip : sizeof(scratch);
+      if (fread(scratch, 1, n, file_) != n) {
+        return false;
+      }
+      to_skip -= n;
+    }
+    receive_time = ros::WallTime(record.sec, record.nsec);
+    length = record.length;
+    return true;
+  }
+};
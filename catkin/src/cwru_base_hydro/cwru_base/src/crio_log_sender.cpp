@@ -0,0 +1,80 @@
+/*
+ * crio_log_sender: stands in for the cRIO by sending the datagrams of a captured log (see crio_log.h) to a
+ * crio_receiver over UDP, with the recorded spacing, so the whole live receive path can be run without the robot.
+ *
+ * usage: crio_log_sender <log file> [host, default 127.0.0.1] [rate, default 1; 0 = as fast as possible] [loops, default 1]
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <cwru_base/crio_log.h>
+#include <cwru_base/crio_receiver.h>
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <log file> [host] [rate] [loops]\n", argv[0]);
+    return 1;
+  }
+  const char* host = argc > 2 ? argv[2] : "127.0.0.1";
+  double rate = argc > 3 ? atof(argv[3]) : 1.0;
+  int n_loops = argc > 4 ? atoi(argv[4]) : 1;
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    fprintf(stderr, "could not open a UDP socket: %s\n", strerror(errno));
+    return 1;
+  }
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(cwru_base::CRIO_PORT);
+  if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+    fprintf(stderr, "not an IPv4 address: %s\n", host);
+    return 1;
+  }
+
+  char datagram[sizeof(cwru_base::CRIOPacket)];
+  long n_sent = 0;
+  for (int loop = 0; loop < n_loops; loop++) {
+    cwru_base::CrioLogReader log;
+    if (!log.open(argv[1])) {
+      fprintf(stderr, "could not open %s as a cRIO log\n", argv[1]);
+      return 1;
+    }
+    ros::WallTime recorded_time;
+    ros::WallTime first_recorded_time;
+    ros::WallTime start = ros::WallTime::now();
+    size_t length;
+    bool first = true;
+    while (log.next(recorded_time, datagram, sizeof(datagram), length)) {
+      if (first) {
+        first_recorded_time = recorded_time;
+        first = false;
+      }
+      if (rate > 0.0) {
+        ros::WallTime due = start + ros::WallDuration((recorded_time - first_recorded_time).toSec() / rate);
+        ros::WallDuration wait = due - ros::WallTime::now();
+        if (wait.toSec() > 0.0) {
+          wait.sleep();
+        }
+      }
+      if (length > sizeof(datagram)) {
+        length = sizeof(datagram);
+      }
+      if (sendto(fd, datagram, length, 0, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "sendto failed: %s\n", strerror(errno));
+      } else {
+        n_sent++;
+      }
+    }
+  }
+  printf("sent %ld packets to %s:%d\n", n_sent, host, cwru_base::CRIO_PORT);
+  close(fd);
+  return 0;
+}
@@ -15,84 +15,91 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <endian.h>
-#include <ros/ros.h>
-#include <boost/array.hpp>
-#include <boost/asio.hpp>
-#include <boost/asio/deadline_timer.hpp>
-#include <boost/bind.hpp>
-#include <boost/date_time/posix_time/posix_time_types.hpp>
-#include <cwru_base/packets.h>
-#include <cwru_msgs/Pose.h>
-#include <cwru_msgs/PowerState.h>
-#include <cwru_msgs/Sonar.h>
-#include <cwru_msgs/cRIOSensors.h>
-#include <cwru_msgs/NavSatFix.h>
-#include <std_msgs/Bool.h>
-#include <diagnostic_updater/diagnostic_updater.h>
-#include <diagnostic_updater/publisher.h>
-
-using boost::asio::ip::udp;
-using boost::asio::deadline_timer;
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <netinet/in.h>
+#include <cwru_base/crio_receiver.h>
 
 namespace cwru_base {
-  class CrioReceiver {
-    public:
-      CrioReceiver();
-      ~CrioReceiver();
-      void dispatchReceivedPacket(CRIOCommand packet);
-      void handlePosePacket(CRIOPosePacket packet);
-      void handleDiagnosticsPacket(CRIODiagnosticsPacket packet);
-      void handleGPSPacket(CRIOGPSPacket packet);
-      void updateDiagnostics();
-    private:
-      CRIOPosePacket swapPosePacket(CRIOPosePacket& packet);
-      CRIODiagnosticsPacket swapDiagnosticsPacket(CRIODiagnosticsPacket& packet);
-      CRIOGPSPacket swapGPSPacket(CRIOGPSPacket& packet);
-      void checkEncoderTicks(diagnostic_updater::DiagnosticStatusWrapper &stat);
-      void checkYawSensor(diagnostic_updater::DiagnosticStatusWrapper &stat);
-      void checkVoltageLevels(diagnostic_updater::DiagnosticStatusWrapper &stat);
-      void checkGPSValues(diagnostic_updater::DiagnosticStatusWrapper &stat);
-      void handleSonarPing(cwru_msgs::Sonar& ping, const float ping_value, const std::string frame_id, ros::Publisher& sonar_pub);
-      float swap_float(float in);
-      double swap_double(double in);
-      void setupDiagnostics();
-      ros::NodeHandle nh_;
-      ros::NodeHandle priv_nh_;
-      ros::Publisher estop_pub_;
-      ros::Publisher flipped_pose_pub_;
-      ros::Publisher sonar1_pub_;
-      ros::Publisher sonar2_pub_;
-      ros::Publisher sonar3_pub_;
-      ros::Publisher sonar4_pub_;
-      ros::Publisher sonar5_pub_;
-      ros::Publisher gps_pub_;
-      ros::Publisher power_pub_;
-      diagnostic_updater::Updater updater_;
-      diagnostic_updater::DiagnosedPublisher<cwru_msgs::Pose> pose_pub_;
-      diagnostic_updater::DiagnosedPublisher<cwru_msgs::cRIOSensors> sensor_pub_;
-      double desired_pose_freq_;
-      double lenc_high_warn_, lenc_low_warn_, lenc_high_err_, lenc_low_err_;
-      double renc_high_warn_, renc_low_warn_, renc_high_err_, renc_low_err_;
-      bool push_casters_;
-      CRIODiagnosticsPacket diagnostics_info_;
-      CRIOPosePacket pose_packet_;
-      CRIOGPSPacket gps_packet_;
-  };
-
-  CrioReceiver::CrioReceiver(): 
-    priv_nh_("~"),
+  CrioReceiver::CrioReceiver(ros::NodeHandle nh, ros::NodeHandle priv_nh):
+    nh_(nh),
+    priv_nh_(priv_nh),
+    updater_(nh, priv_nh),
     pose_pub_(nh_.advertise<cwru_msgs::Pose>("pose",1),
         updater_,
-        diagnostic_updater::FrequencyStatusParam(&desired_pose_freq_, &desired_pose_freq_, 3.0, 5),
+        diagnostic_updater::FrequencyStatusParam(&pose_pub_freq_, &pose_pub_freq_, 3.0, 5),
         diagnostic_updater::TimeStampStatusParam()),
     sensor_pub_(nh_.advertise<cwru_msgs::cRIOSensors>("crio_sensors",1),
         updater_,
-        diagnostic_updater::FrequencyStatusParam(&desired_pose_freq_, &desired_pose_freq_, 3.0, 5),
-        diagnostic_updater::TimeStampStatusParam())
+        diagnostic_updater::FrequencyStatusParam(&sensors_pub_freq_, &sensors_pub_freq_, 3.0, 5),
+        diagnostic_updater::TimeStampStatusParam()),
+    crio_clock_(CLOCK_SYNC_WINDOW, CLOCK_DRIFT_GAIN, CLOCK_RESET_THRESHOLD)
   {
     priv_nh_.param("expected_pose_freq", desired_pose_freq_, 50.0);
     priv_nh_.param("push_casters", push_casters_, false);
+    priv_nh_.param("socket_timeout", socket_timeout_, 10);
+    priv_nh_.param("pose_sequence_in_padding", pose_sequence_in_padding_, false);
+    priv_nh_.param("capture_file", capture_file_, std::string(""));
+    priv_nh_.param("replay_file", replay_file_, std::string(""));
+    priv_nh_.param("replay_rate", replay_rate_, 1.0);
+    readDecimation("pose_decimation", pose_decimator_);
+    readDecimation("sonar_decimation", sonar_decimator_);
+    readDecimation("power_state_decimation", power_decimator_);
+    readDecimation("crio_sensors_decimation", sensors_decimator_);
+    readDecimation("gps_fix_decimation", gps_decimator_);
+    pose_pub_freq_ = desired_pose_freq_ / pose_decimator_.decimation;
+    sensors_pub_freq_ = desired_pose_freq_ / sensors_decimator_.decimation;
+    std::string sonar_output;
+    priv_nh_.param("sonar_output", sonar_output, std::string("individual"));
+    publish_sonar_individual_ = (sonar_output != "array");
+    publish_sonar_array_ = (sonar_output == "array" || sonar_output == "both");
+    if (sonar_output != "individual" && sonar_output != "array" && sonar_output != "both") {
+      ROS_WARN("cRIO receiver: unknown sonar_output \"%s\"; publishing the individual sonar topics", sonar_output.c_str());
+    }
+    priv_nh_.param("estop_republish_interval", estop_republish_interval_, 1.0);
+    priv_nh_.param("realtime_priority", realtime_priority_, 0);
+    // not when replaying: recorded packets would re-enable the motors for the des state generator, and fight the
+    // live receiver's writes to the same flag. Set ~estop_flag explicitly to test the flag from a log
+    priv_nh_.param("estop_flag", estop_flag_name_, replay_file_.empty() ? std::string(DEFAULT_ESTOP_FLAG) : std::string(""));
+    have_motors_enabled_ = false;
+    last_motors_enabled_ = false;
+    n_estop_published_ = 0;
+    n_estop_skipped_ = 0;
+    n_estop_changes_ = 0;
+    last_estop_change_latency_ = 0.0;
+    max_estop_change_latency_ = 0.0;
+    max_estop_latency_ = 0.0;
+    if (!estop_flag_name_.empty() && !estop_flag_.open(estop_flag_name_, true)) {
+      ROS_WARN("cRIO receiver: could not map /dev/shm/%s for the e-stop flag: %s", estop_flag_name_.c_str(), strerror(errno));
+    }
+    have_pose_sequence_ = false;
+    last_pose_sequence_ = 0;
+    pose_sequence_ = 0;
+    n_pose_packets_dropped_ = 0;
+    stop_requested_ = false;
+    for (int i = 0; i < RECV_BATCH_SIZE; i++) {
+      rx_iov_[i].iov_base = &rx_batch_[i].packet;
+      rx_iov_[i].iov_len = sizeof(rx_batch_[i].packet);
+      memset(&rx_msgs_[i], 0, sizeof(rx_msgs_[i]));
+      rx_msgs_[i].msg_hdr.msg_iov = &rx_iov_[i];
+      rx_msgs_[i].msg_hdr.msg_iovlen = 1;
+      rx_msgs_[i].msg_hdr.msg_control = rx_control_[i];
+    }
+    n_packets_received_ = 0;
+    n_wakeups_ = 0;
+    max_batch_ = 0;
+    n_truncated_ = 0;
+    n_short_packets_ = 0;
+    n_receive_errors_ = 0;
+    sum_dispatch_delay_ = 0.0;
+    max_dispatch_delay_ = 0.0;
     ros::NodeHandle encoders_nh_(priv_nh_, "encoders");
     encoders_nh_.param("lenc_high_warn", lenc_high_warn_, 15.1);
     encoders_nh_.param("lenc_low_warn", lenc_low_warn_, 14.9);
@@ -104,11 +111,16 @@ namespace cwru_base {
     encoders_nh_.param("renc_low_err", renc_low_err_, 14.);
     flipped_pose_pub_ = nh_.advertise<cwru_msgs::Pose>("flipped_pose",1);
     estop_pub_ = nh_.advertise<std_msgs::Bool>("motors_enabled",1,true);
-    sonar1_pub_ = nh_.advertise<cwru_msgs::Sonar>("sonar_1",1);
-    sonar2_pub_ = nh_.advertise<cwru_msgs::Sonar>("sonar_2",1);
-    sonar3_pub_ = nh_.advertise<cwru_msgs::Sonar>("sonar_3",1);
-    sonar4_pub_ = nh_.advertise<cwru_msgs::Sonar>("sonar_4",1);
-    sonar5_pub_ = nh_.advertise<cwru_msgs::Sonar>("sonar_5",1);
+    if (publish_sonar_individual_) {
+      sonar1_pub_ = nh_.advertise<cwru_msgs::Sonar>("sonar_1",1);
+      sonar2_pub_ = nh_.advertise<cwru_msgs::Sonar>("sonar_2",1);
+      sonar3_pub_ = nh_.advertise<cwru_msgs::Sonar>("sonar_3",1);
+      sonar4_pub_ = nh_.advertise<cwru_msgs::Sonar>("sonar_4",1);
+      sonar5_pub_ = nh_.advertise<cwru_msgs::Sonar>("sonar_5",1);
+    }
+    if (publish_sonar_array_) {
+      sonar_array_pub_ = nh_.advertise<cwru_msgs::SonarArray>("sonar_array",1);
+    }
     gps_pub_ = nh_.advertise<cwru_msgs::NavSatFix>("gps_fix",1);
     power_pub_ = nh_.advertise<cwru_msgs::PowerState>("power_state",1);
     setupDiagnostics();
@@ -121,6 +133,18 @@ namespace cwru_base {
     updater_.add("Yaw Sensor", this, &CrioReceiver::checkYawSensor);
     updater_.add("Voltages", this, &CrioReceiver::checkVoltageLevels);
     updater_.add("GPS", this, &CrioReceiver::checkGPSValues);
+    updater_.add("Receive", this, &CrioReceiver::checkReceiveStats);
+    updater_.add("Publishing", this, &CrioReceiver::checkPublishStats);
+    updater_.add("E-Stop", this, &CrioReceiver::checkEstop);
+  }
+
+  void CrioReceiver::readDecimation(const std::string& param, TopicDecimator& decimator) {
+    priv_nh_.param(param, decimator.decimation, 1);
+    if (decimator.decimation < 1) {
+      ROS_WARN("cRIO receiver: %s must be at least 1; using 1", param.c_str());
+      decimator.decimation = 1;
+    }
+    decimator.countdown = 1; // publish the first packet
   }
 
   void CrioReceiver::updateDiagnostics() {
@@ -301,93 +325,168 @@ namespace cwru_base {
     stat.summary(status_lvl, status_msg);
   }
 
-  CrioReceiver::~CrioReceiver() {
+  void CrioReceiver::checkReceiveStats(diagnostic_updater::DiagnosticStatusWrapper &stat) {
+    stat.add("Packets", n_packets_received_);
+    stat.add("Wakeups", n_wakeups_);
+    stat.add("Max Packets Per Wakeup", max_batch_);
+    stat.add("Truncated Packets", n_truncated_);
+    stat.add("Short Packets", n_short_packets_);
+    stat.add("Receive Errors", n_receive_errors_);
+    // kernel receive time to dispatch: socket queueing plus the time spent on the packets ahead in the batch
+    stat.add("Mean Dispatch Delay", n_packets_received_ > 0 ? sum_dispatch_delay_ / n_packets_received_ : 0.0);
+    stat.add("Max Dispatch Delay", max_dispatch_delay_);
+    if (pose_sequence_in_padding_) {
+      stat.add("Pose Packets Dropped", n_pose_packets_dropped_);
+      stat.add("cRIO Clock Synced", crio_clock_.synced());
+      stat.add("cRIO Clock Drift (ppm)", crio_clock_.drift() * 1e6);
+    }
+    if (n_receive_errors_ > 0 || n_truncated_ > 0 || n_short_packets_ > 0) {
+      stat.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Receive errors, truncated or short packets since the last update");
+    } else {
+      stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "Receiving");
+    }
+    n_packets_received_ = 0;
+    n_wakeups_ = 0;
+    max_batch_ = 0;
+    n_truncated_ = 0;
+    n_short_packets_ = 0;
+    n_receive_errors_ = 0;
+    sum_dispatch_delay_ = 0.0;
+    max_dispatch_delay_ = 0.0;
   }
 
-  void CrioReceiver::dispatchReceivedPacket(CRIOCommand packet) {
-    if (packet.type == POSE_t) {
-      handlePosePacket(*((CRIOPosePacket*) &packet));
-    } else if (packet.type == DIAGNOSTICS_t) {
-      handleDiagnosticsPacket(*((CRIODiagnosticsPacket*) &packet));
-    } else if (packet.type == GPS_t) {
-      handleGPSPacket(*((CRIOGPSPacket*) &packet));
-    } else {
-      ROS_WARN("Unhandled packet type received: %d", packet.type);
-    }	
+  void CrioReceiver::addPublishStats(diagnostic_updater::DiagnosticStatusWrapper &stat, const std::string& topic, TopicDecimator& decimator) {
+    stat.add(topic + " Published", decimator.n_published);
+    stat.add(topic + " Skipped", decimator.n_skipped);
+    decimator.n_published = 0;
+    decimator.n_skipped = 0;
   }
 
-  float CrioReceiver::swap_float(float in) {
-    uint32_t temp = *((uint32_t *)&in); 
-    temp = ntohl(temp);
-    return *((float *) &temp);
+  // messages published and held back per topic since the last update
+  void CrioReceiver::checkPublishStats(diagnostic_updater::DiagnosticStatusWrapper &stat) {
+    addPublishStats(stat, "pose", pose_decimator_);
+    addPublishStats(stat, "sonar", sonar_decimator_);
+    addPublishStats(stat, "power_state", power_decimator_);
+    addPublishStats(stat, "crio_sensors", sensors_decimator_);
+    addPublishStats(stat, "gps_fix", gps_decimator_);
+    stat.add("motors_enabled Published", n_estop_published_);
+    stat.add("motors_enabled Skipped", n_estop_skipped_);
+    n_estop_published_ = 0;
+    n_estop_skipped_ = 0;
+    stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "Publishing");
   }
 
-  double CrioReceiver::swap_double(double in) {
-    uint64_t temp = *((uint64_t *)&in);
-    temp = be64toh(temp);
-    return *((double *) &temp);
+  void CrioReceiver::checkEstop(diagnostic_updater::DiagnosticStatusWrapper &stat) {
+    stat.add("Motors Enabled", last_motors_enabled_);
+    stat.add("Shared Memory Flag", estop_flag_.isOpen() ? "/dev/shm/" + estop_flag_name_ : std::string("none"));
+    stat.add("Changes", n_estop_changes_);
+    stat.add("Last Change Latency", last_estop_change_latency_);
+    stat.add("Worst Change Latency", max_estop_change_latency_);
+    stat.add("Worst Check Latency", max_estop_latency_);
+    if (!have_motors_enabled_) {
+      stat.summary(diagnostic_msgs::DiagnosticStatus::WARN, "No diagnostics packet yet");
+    } else if (!last_motors_enabled_) {
+      stat.summary(diagnostic_msgs::DiagnosticStatus::WARN, "E-stop triggered");
+    } else {
+      stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "Motors enabled");
+    }
   }
 
-  CRIOPosePacket CrioReceiver::swapPosePacket(CRIOPosePacket& packet) {
-    CRIOPosePacket swapped_packet = packet;
-    swapped_packet.x = swap_float(packet.x);
-    swapped_packet.y = swap_float(packet.y);
-    swapped_packet.theta = swap_float(packet.theta);
-    swapped_packet.vel = swap_float(packet.vel);
-    swapped_packet.omega = swap_float(packet.omega);
-    swapped_packet.yaw_bias = swap_float(packet.yaw_bias);
-    swapped_packet.x_variance = swap_float(packet.x_variance);
-    swapped_packet.y_variance = swap_float(packet.y_variance);
-    swapped_packet.theta_variance = swap_float(packet.theta_variance);
-    swapped_packet.omega_variance = swap_float(packet.omega_variance);
-    swapped_packet.vel_variance = swap_float(packet.vel_variance);
-    swapped_packet.yaw_bias_variance = swap_float(packet.yaw_bias_variance);
-    swapped_packet.sonar_ping_1 = swap_float(packet.sonar_ping_1);
-    swapped_packet.sonar_ping_2 = swap_float(packet.sonar_ping_2);
-    swapped_packet.sonar_ping_3 = swap_float(packet.sonar_ping_3);
-    swapped_packet.sonar_ping_4 = swap_float(packet.sonar_ping_4);
-    swapped_packet.sonar_ping_5 = swap_float(packet.sonar_ping_5);
-    return swapped_packet;
+  // the e-stop state of a diagnostics packet, out to the shared flag and motors_enabled before anything else
+  // in its batch is handled; only eStopTriggered is read, and it's a single byte, so no decoding is needed
+  void CrioReceiver::handleEstop(const ReceivedPacket& rx) {
+    if (rx.packet.command.type != DIAGNOSTICS_t
+        || rx.length < offsetof(CRIODiagnosticsPacket, eStopTriggered) + sizeof(rx.packet.diagnostics.eStopTriggered)) {
+      return;
+    }
+    bool motors_enabled = !rx.packet.diagnostics.eStopTriggered;
+    estop_flag_.write(motors_enabled, rx.receive_time);
+    bool changed = have_motors_enabled_ && motors_enabled != last_motors_enabled_;
+    ros::WallTime now = ros::WallTime::now();
+    if (!have_motors_enabled_ || changed || (now - last_estop_publish_time_).toSec() >= estop_republish_interval_) {
+      std_msgs::Bool msg;
+      msg.data = motors_enabled;
+      estop_pub_.publish(msg);
+      last_estop_publish_time_ = now;
+      n_estop_published_++;
+    } else {
+      n_estop_skipped_++;
+    }
+    if (changed) {
+      ROS_WARN("cRIO receiver: motors %s", motors_enabled ? "enabled" : "disabled (e-stop)");
+    }
+    have_motors_enabled_ = true;
+    last_motors_enabled_ = motors_enabled;
+
+    double latency = (ros::WallTime::now() - rx.receive_time).toSec();
+    if (latency > max_estop_latency_) {
+      max_estop_latency_ = latency;
+    }
+    if (changed) {
+      n_estop_changes_++;
+      last_estop_change_latency_ = latency;
+      if (latency > max_estop_change_latency_) {
+        max_estop_change_latency_ = latency;
+      }
+    }
   }
 
-  CRIODiagnosticsPacket CrioReceiver::swapDiagnosticsPacket(CRIODiagnosticsPacket& packet) {
-    CRIODiagnosticsPacket swapped_packet = packet;
-    swapped_packet.FPGAVersion = be16toh(packet.FPGAVersion);
-    swapped_packet.VMonitor_cRIO_mV = be16toh(packet.VMonitor_cRIO_mV);
-    swapped_packet.LWheelTicks = be32toh(packet.LWheelTicks);
-    swapped_packet.RWheelTicks = be32toh(packet.RWheelTicks);
-    swapped_packet.LMotorTicks = be32toh(packet.LMotorTicks);
-    swapped_packet.RMotorTicks = be32toh(packet.RMotorTicks);
-    swapped_packet.VMonitor_24V_mV = be16toh(packet.VMonitor_24V_mV);
-    swapped_packet.VMonitor_13V_mV = be16toh(packet.VMonitor_13V_mV);
-    swapped_packet.VMonitor_5V_mV = be16toh(packet.VMonitor_5V_mV);
-    swapped_packet.VMonitor_eStop_mV = be16toh(packet.VMonitor_eStop_mV);
-    swapped_packet.YawRate_mV = be16toh(packet.YawRate_mV);
-    swapped_packet.YawSwing_mV = be16toh(packet.YawSwing_mV);
-    swapped_packet.YawTemp_mV = be16toh(packet.YawTemp_mV);
-    swapped_packet.YawRef_mV = be16toh(packet.YawRef_mV);
-    swapped_packet.C1Steering = be16toh(packet.C1Steering);
-    swapped_packet.C2Throttle = be16toh(packet.C2Throttle);
-    swapped_packet.C3Mode = be16toh(packet.C3Mode);
-    return swapped_packet;
+  CrioReceiver::~CrioReceiver() {
   }
 
-  CRIOGPSPacket CrioReceiver::swapGPSPacket(CRIOGPSPacket& packet) {
-    CRIOGPSPacket swapped_packet = packet;
-    swapped_packet.latitude = swap_double(packet.latitude);
-    swapped_packet.longitude = swap_double(packet.longitude);
-    swapped_packet.lat_std_dev = swap_float(packet.lat_std_dev);
-    swapped_packet.long_std_dev = swap_float(packet.long_std_dev);
-    swapped_packet.solution_status = be32toh(packet.solution_status);
-    swapped_packet.position_type = be32toh(packet.position_type);
-    swapped_packet.differential_age = swap_float(packet.differential_age);
-    swapped_packet.solution_age = swap_float(packet.solution_age);
-    return swapped_packet;
+  // check the length for the packet's type, byte-swap it in place, and hand it to its handler
+  void CrioReceiver::dispatchReceivedPacket(ReceivedPacket& rx, const ros::Time& receive_stamp) {
+    int8_t type = rx.packet.command.type;
+    DecodeStatus status = decodePacketInPlace(rx.packet, rx.length);
+    if (status == UNKNOWN_TYPE) {
+      ROS_WARN("Unhandled packet type received: %d", type);
+      return;
+    }
+    if (status == SHORT_PACKET) {
+      n_short_packets_++;
+      const PacketLayout* layout = findPacketLayout(type);
+      ROS_WARN("Dropped a short packet of type %d: %d bytes, expected at least %d", type, (int) rx.length,
+          layout ? (int) layout->min_length : 1);
+      return;
+    }
+    if (type == POSE_t) {
+      handlePosePacket(rx.packet.pose, receive_stamp);
+    } else if (type == DIAGNOSTICS_t) {
+      handleDiagnosticsPacket(rx.packet.diagnostics, receive_stamp);
+    } else if (type == GPS_t) {
+      handleGPSPacket(rx.packet.gps, receive_stamp);
+    }
+  }
+
+  // best estimate of when the cRIO sent this pose packet: the receive time, or with a packet counter, the
+  // clock-synced send time (which leaves out queueing and network jitter)
+  ros::Time CrioReceiver::poseStamp(const CRIOPosePacket& packet, const ros::Time& receive_stamp) {
+    if (!pose_sequence_in_padding_) {
+      return receive_stamp;
+    }
+    uint32_t sequence = ((uint32_t) (uint8_t) packet.data1 << 16) | ((uint32_t) (uint8_t) packet.data2 << 8) | (uint8_t) packet.data3;
+    if (have_pose_sequence_) {
+      uint32_t step = (sequence - last_pose_sequence_) & 0xffffff;
+      if (step == 0 || step > 0x800000) {
+        // repeated or from the past: out of order, or the cRIO restarted its counter
+        ROS_WARN("cRIO pose packet counter went from %u to %u; restarting clock sync", last_pose_sequence_, sequence);
+        crio_clock_.reset();
+        step = 1;
+      }
+      n_pose_packets_dropped_ += step - 1;
+      pose_sequence_ += step;
+    }
+    have_pose_sequence_ = true;
+    last_pose_sequence_ = sequence;
+    double send_time = crio_clock_.update(pose_sequence_ / desired_pose_freq_, receive_stamp.toSec());
+    if (!crio_clock_.synced()) {
+      return receive_stamp;
+    }
+    return ros::Time(send_time);
   }
 
-  void CrioReceiver::handlePosePacket(CRIOPosePacket packet) {
-    ros::Time current_time = ros::Time::now();
-    CRIOPosePacket swapped_packet = swapPosePacket(packet);
+  void CrioReceiver::handlePosePacket(CRIOPosePacket& swapped_packet, const ros::Time& receive_stamp) {
+    ros::Time current_time = poseStamp(swapped_packet, receive_stamp);
     if (push_casters_) {
       swapped_packet.x = -swapped_packet.x;
       swapped_packet.y = -swapped_packet.y;
@@ -395,62 +494,89 @@ namespace cwru_base {
       swapped_packet.vel = -swapped_packet.vel;
     }
     pose_packet_ = swapped_packet;
-    cwru_msgs::Pose p, p2;
-    p.x = swapped_packet.x;
-    p.y = swapped_packet.y;
-    p.theta = swapped_packet.theta;
-    p.vel = swapped_packet.vel;
-    p.omega = swapped_packet.omega;
+    if (sonar_decimator_.due()) {
+      handleSonarPings(current_time, swapped_packet);
+    }
+    if (!pose_decimator_.due()) {
+      return;
+    }
+    // published as shared pointers: subscribers loaded in the same nodelet manager get these without serialization,
+    // so each message is freshly allocated and never touched again after publishing
+    cwru_msgs::PosePtr p(new cwru_msgs::Pose);
+    p->x = swapped_packet.x;
+    p->y = swapped_packet.y;
+    p->theta = swapped_packet.theta;
+    p->vel = swapped_packet.vel;
+    p->omega = swapped_packet.omega;
     ROS_DEBUG("Yaw bias: %f", swapped_packet.yaw_bias);
-    p.x_var = swapped_packet.x_variance;
-    p.y_var = swapped_packet.y_variance;
-    p.theta_var = swapped_packet.theta_variance;
-    p.vel_var = swapped_packet.vel_variance;
-    p.omega_var = swapped_packet.omega_variance;
+    p->x_var = swapped_packet.x_variance;
+    p->y_var = swapped_packet.y_variance;
+    p->theta_var = swapped_packet.theta_variance;
+    p->vel_var = swapped_packet.vel_variance;
+    p->omega_var = swapped_packet.omega_variance;
     ROS_DEBUG("Yaw bias variance: %f", swapped_packet.yaw_bias_variance);
-    p.header.frame_id = "crio";
-    p.header.stamp = current_time;
-    p2 = p;
-    p2.y = -p2.y;
-    p2.theta = -p2.theta;
-    p2.omega = -p2.omega;
-    p2.header.frame_id = "flipped_crio";
+    p->header.frame_id = "crio";
+    p->header.stamp = current_time;
+    cwru_msgs::PosePtr p2(new cwru_msgs::Pose(*p));
+    p2->y = -p2->y;
+    p2->theta = -p2->theta;
+    p2->omega = -p2->omega;
+    p2->header.frame_id = "flipped_crio";
     pose_pub_.publish(p);
     flipped_pose_pub_.publish(p2);
-
-    cwru_msgs::Sonar ping;
-    ping.header.stamp = current_time;
-    handleSonarPing(ping, swapped_packet.sonar_ping_1, std::string("sonar_1_link"), sonar1_pub_);
-    handleSonarPing(ping, swapped_packet.sonar_ping_2, std::string("sonar_2_link"), sonar2_pub_);
-    handleSonarPing(ping, swapped_packet.sonar_ping_3, std::string("sonar_3_link"), sonar3_pub_);
-    handleSonarPing(ping, swapped_packet.sonar_ping_4, std::string("sonar_4_link"), sonar4_pub_);
-    handleSonarPing(ping, swapped_packet.sonar_ping_5, std::string("sonar_5_link"), sonar5_pub_);
     ROS_DEBUG("Handled a Pose Packet");
   }
 
-  void CrioReceiver::handleSonarPing(cwru_msgs::Sonar& ping, const float ping_value, const std::string frame_id, ros::Publisher& sonar_pub) {
-    ping.header.frame_id = frame_id;
-    ping.dist = ping_value;
+  void CrioReceiver::handleSonarPings(const ros::Time& stamp, const CRIOPosePacket& packet) {
+    if (publish_sonar_individual_) {
+      handleSonarPing(stamp, packet.sonar_ping_1, std::string("sonar_1_link"), sonar1_pub_);
+      handleSonarPing(stamp, packet.sonar_ping_2, std::string("sonar_2_link"), sonar2_pub_);
+      handleSonarPing(stamp, packet.sonar_ping_3, std::string("sonar_3_link"), sonar3_pub_);
+      handleSonarPing(stamp, packet.sonar_ping_4, std::string("sonar_4_link"), sonar4_pub_);
+      handleSonarPing(stamp, packet.sonar_ping_5, std::string("sonar_5_link"), sonar5_pub_);
+    }
+    if (publish_sonar_array_) {
+      // one message for all five, instead of five headers and five serializations
+      cwru_msgs::SonarArrayPtr pings(new cwru_msgs::SonarArray);
+      pings->header.stamp = stamp;
+      pings->header.frame_id = ""; // no single frame: dist[i] is from sonar_<i+1>_link, as SonarArray.msg says
+      pings->dist.resize(5);
+      pings->dist[0] = packet.sonar_ping_1;
+      pings->dist[1] = packet.sonar_ping_2;
+      pings->dist[2] = packet.sonar_ping_3;
+      pings->dist[3] = packet.sonar_ping_4;
+      pings->dist[4] = packet.sonar_ping_5;
+      sonar_array_pub_.publish(pings);
+    }
+  }
+
+  void CrioReceiver::handleSonarPing(const ros::Time& stamp, const float ping_value, const std::string& frame_id, ros::Publisher& sonar_pub) {
+    cwru_msgs::SonarPtr ping(new cwru_msgs::Sonar);
+    ping->header.stamp = stamp;
+    ping->header.frame_id = frame_id;
+    ping->dist = ping_value;
     sonar_pub.publish(ping);
   }
 
-  void CrioReceiver::handleDiagnosticsPacket(CRIODiagnosticsPacket packet) {
-    ros::Time current_time = ros::Time::now();
-    CRIODiagnosticsPacket swapped_packet = swapDiagnosticsPacket(packet);
+  void CrioReceiver::handleDiagnosticsPacket(const CRIODiagnosticsPacket& swapped_packet, const ros::Time& receive_stamp) {
+    ros::Time current_time = receive_stamp;
     diagnostics_info_ = swapped_packet;
-    std_msgs::Bool msg;
-    msg.data = !diagnostics_info_.eStopTriggered;
-    estop_pub_.publish(msg);
-	
-	cwru_msgs::PowerState power_msg;
-	power_msg.header.stamp = current_time;
-	power_msg.header.frame_id = "crio";
-	power_msg.battery_voltage = diagnostics_info_.VMonitor_24V_mV / 1000.0;
-	power_msg.v13_8_voltage = diagnostics_info_.VMonitor_13V_mV / 1000.0;
-	power_msg.motor_voltage = diagnostics_info_.VMonitor_eStop_mV / 1000.0;
-	power_msg.cRIO_voltage = diagnostics_info_.VMonitor_cRIO_mV / 1000.0;
-	power_pub_.publish(power_msg);
-	
+    // motors_enabled already went out from handleEstop()
+
+    if (power_decimator_.due()) {
+      cwru_msgs::PowerState power_msg;
+      power_msg.header.stamp = current_time;
+      power_msg.header.frame_id = "crio";
+      power_msg.battery_voltage = diagnostics_info_.VMonitor_24V_mV / 1000.0;
+      power_msg.v13_8_voltage = diagnostics_info_.VMonitor_13V_mV / 1000.0;
+      power_msg.motor_voltage = diagnostics_info_.VMonitor_eStop_mV / 1000.0;
+      power_msg.cRIO_voltage = diagnostics_info_.VMonitor_cRIO_mV / 1000.0;
+      power_pub_.publish(power_msg);
+    }
+
+    if (!sensors_decimator_.due()) {
+      return;
+    }
     cwru_msgs::cRIOSensors sensor_msg;
     sensor_msg.header.stamp = current_time;
     sensor_msg.header.frame_id = "crio";
@@ -464,11 +590,13 @@ namespace cwru_base {
     sensor_pub_.publish(sensor_msg);
   }
 
-  void CrioReceiver::handleGPSPacket(CRIOGPSPacket packet) {
+  void CrioReceiver::handleGPSPacket(const CRIOGPSPacket& swapped_packet, const ros::Time& receive_stamp) {
     ROS_DEBUG("Got a GPS Packet. Now broadcasting as a ROS topic");
-    ros::Time current_time = ros::Time::now();
-    CRIOGPSPacket swapped_packet = swapGPSPacket(packet);
+    ros::Time current_time = receive_stamp;
     gps_packet_ = swapped_packet;
+    if (!gps_decimator_.due()) {
+      return;
+    }
 
     cwru_msgs::NavSatFix fix_msg;
     fix_msg.header.stamp = current_time;
@@ -504,65 +632,209 @@ namespace cwru_base {
 
     gps_pub_.publish(fix_msg);
   }
-};
 
-void check_deadline(deadline_timer& deadline, udp::socket& socket) {
-  if (deadline.expires_at() <= deadline_timer::traits_type::now()) {
-    socket.cancel();
-    deadline.expires_at(boost::posix_time::pos_infin);
+  void CrioReceiver::stop() {
+    stop_requested_ = true;
   }
-  deadline.async_wait(boost::bind(&check_deadline, boost::ref(deadline), boost::ref(socket)));
-}
-
-static void handle_receive(const boost::system::error_code& input_ec, std::size_t input_len,
-    boost::system::error_code* output_ec, std::size_t* output_len) {
-  *output_ec = input_ec;
-  *output_len = input_len;
-}
-
-int main(int argc, char *argv[]) {
-  ros::init(argc, argv, "crio_receiver");
-  ros::NodeHandle nh;
-  ros::NodeHandle priv_nh("~");
-  int timeout_val;
-  priv_nh.param("socket_timeout", timeout_val, 10);
-  cwru_base::CrioReceiver from_crio;
-  boost::asio::io_service io_service;
-  udp::socket socket(io_service, udp::endpoint(udp::v4(), 50000));
-  deadline_timer deadline(io_service);
-  deadline.expires_at(boost::posix_time::pos_infin);
-  check_deadline(deadline, socket);
-  boost::posix_time::seconds timeout(timeout_val);
-  while (nh.ok()) {
-    try {
-      boost::array<cwru_base::CRIOCommand, 1> recv_buf;
-      udp::endpoint remote_endpoint;
-
-      deadline.expires_from_now(timeout);
-
-      boost::system::error_code error = boost::asio::error::would_block;
-      std::size_t length = 0;
-
-      socket.async_receive_from(boost::asio::buffer(recv_buf), remote_endpoint, 
-          boost::bind(&handle_receive, _1, _2, &error, &length));
-
-      do {
-        io_service.run_one();
-      } while (error == boost::asio::error::would_block);
-
-      if (error) {
-        if (error == boost::asio::error::operation_aborted) {
-          ROS_WARN("Socket receive timed out. Are you sure you are connected to the cRIO?");
-          from_crio.updateDiagnostics();
-        } else {
-          throw boost::system::system_error(error);
+
+  // take every datagram waiting on the socket, RECV_BATCH_SIZE per syscall, and dispatch each batch;
+  // returns the number of datagrams received
+  int CrioReceiver::drainSocket(int fd) {
+    int n_total = 0;
+    while (true) {
+      for (int i = 0; i < RECV_BATCH_SIZE; i++) {
+        rx_msgs_[i].msg_hdr.msg_controllen = sizeof(rx_control_[i]); // recvmmsg() overwrites it with the length used
+        rx_msgs_[i].msg_hdr.msg_flags = 0;
+      }
+      int n = recvmmsg(fd, rx_msgs_, RECV_BATCH_SIZE, MSG_DONTWAIT, NULL);
+      if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+          n_receive_errors_++;
+          ROS_ERROR("cRIO receiver: recvmmsg failed: %s", strerror(errno));
+        }
+        break;
+      }
+      ros::WallTime now = ros::WallTime::now();
+      for (int i = 0; i < n; i++) {
+        ReceivedPacket& rx = rx_batch_[i];
+        rx.length = rx_msgs_[i].msg_len;
+        if (rx_msgs_[i].msg_hdr.msg_flags & MSG_TRUNC) {
+          n_truncated_++;
+        }
+        rx.receive_time = now; // in case the kernel didn't stamp it
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&rx_msgs_[i].msg_hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(&rx_msgs_[i].msg_hdr, cmsg)) {
+          if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            rx.receive_time = ros::WallTime(ts.tv_sec, ts.tv_nsec);
+          }
         }
+        // raw, before dispatch decodes it in place
+        if (capture_log_.isOpen()) {
+          capture_log_.write(rx.receive_time, &rx.packet, std::min(rx.length, sizeof(rx.packet)));
+        }
+      }
+      dispatchBatch(n);
+      n_total += n;
+      if (n > max_batch_) {
+        max_batch_ = n;
+      }
+      if (n < RECV_BATCH_SIZE) {
+        break; // that was everything
+      }
+    }
+    return n_total;
+  }
+
+  void CrioReceiver::dispatchBatch(int n_packets) {
+    for (int i = 0; i < n_packets; i++) {
+      handleEstop(rx_batch_[i]);
+    }
+    for (int i = 0; i < n_packets; i++) {
+      // the kernel stamps with the wall clock; carry the packet's age over to ROS time, which may be simulated
+      double delay = (ros::WallTime::now() - rx_batch_[i].receive_time).toSec();
+      ros::Time receive_stamp = ros::Time::now() - ros::Duration(delay);
+      sum_dispatch_delay_ += delay;
+      if (delay > max_dispatch_delay_) {
+        max_dispatch_delay_ = delay;
+      }
+      n_packets_received_++;
+      try {
+        dispatchReceivedPacket(rx_batch_[i], receive_stamp);
+      } catch (std::exception& e) {
+        ROS_ERROR_STREAM("cRIO receiver threw an exception: " << e.what());
+      }
+    }
+  }
+
+  void CrioReceiver::run() {
+    if (realtime_priority_ > 0) {
+      struct sched_param param;
+      memset(&param, 0, sizeof(param));
+      param.sched_priority = realtime_priority_;
+      int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+      if (error != 0) {
+        ROS_WARN("cRIO receiver: could not run at SCHED_FIFO priority %d (%s); check rtprio in /etc/security/limits.conf",
+            realtime_priority_, strerror(error));
+      }
+    }
+    if (!replay_file_.empty()) {
+      replayLoop();
+      return;
+    }
+    if (!capture_file_.empty()) {
+      if (capture_log_.open(capture_file_)) {
+        ROS_INFO("cRIO receiver: capturing packets to %s", capture_file_.c_str());
       } else {
-        from_crio.dispatchReceivedPacket(recv_buf[0]);
-        from_crio.updateDiagnostics();
+        ROS_ERROR("cRIO receiver: could not open capture file %s: %s", capture_file_.c_str(), strerror(errno));
       }
-    } catch (std::exception& e) {
-      ROS_ERROR_STREAM("cRIO receiver threw an exception: " << e.what());
     }
+    receiveLoop();
+    capture_log_.close();
   }
-}
+
+  void CrioReceiver::receiveLoop() {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+      ROS_ERROR("cRIO receiver: could not open a UDP socket: %s", strerror(errno));
+      return;
+    }
+    int on = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) < 0) {
+      ROS_WARN("cRIO receiver: no kernel receive timestamps (%s); using the time packets are read", strerror(errno));
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(CRIO_PORT);
+    if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+      ROS_ERROR("cRIO receiver: could not bind UDP port %d: %s", CRIO_PORT, strerror(errno));
+      close(fd);
+      return;
+    }
+
+    // sleep in poll() until a datagram arrives or the diagnostics are due, whichever is first
+    ros::WallTime last_packet_time = ros::WallTime::now();
+    ros::WallTime next_diagnostics_time = last_packet_time;
+    while (nh_.ok() && !stop_requested_) {
+      ros::WallTime now = ros::WallTime::now();
+      if (now >= next_diagnostics_time) {
+        updateDiagnostics();
+        capture_log_.flush();
+        next_diagnostics_time = now + ros::WallDuration(DIAGNOSTICS_INTERVAL);
+      }
+      if ((now - last_packet_time).toSec() > socket_timeout_) {
+        ROS_WARN("Socket receive timed out. Are you sure you are connected to the cRIO?");
+        last_packet_time = now;
+      }
+      struct pollfd pfd;
+      pfd.fd = fd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      int timeout_ms = (int) ceil((next_diagnostics_time - now).toSec() * 1000.0);
+      int ready = poll(&pfd, 1, timeout_ms > 0 ? timeout_ms : 0);
+      if (ready < 0 && errno != EINTR) {
+        n_receive_errors_++;
+        ROS_ERROR("cRIO receiver: poll failed: %s", strerror(errno));
+      }
+      if (ready > 0) {
+        n_wakeups_++;
+        if (drainSocket(fd) > 0) {
+          last_packet_time = ros::WallTime::now();
+        }
+      }
+    }
+    close(fd);
+  }
+
+  // feed a captured log through the same dispatch path as live packets: one packet per batch, released at the
+  // recorded spacing divided by replay_rate_ (or at once, for 0). Packets are stamped with the time they are
+  // dispatched, so downstream sees current stamps; clock sync only makes sense at a rate of 1
+  void CrioReceiver::replayLoop() {
+    CrioLogReader log;
+    if (!log.open(replay_file_)) {
+      ROS_ERROR("cRIO receiver: could not open %s as a cRIO log", replay_file_.c_str());
+      return;
+    }
+    ROS_INFO("cRIO receiver: replaying %s at %.1fx", replay_file_.c_str(), replay_rate_);
+    ReceivedPacket& rx = rx_batch_[0];
+    ros::WallTime recorded_time;
+    ros::WallTime first_recorded_time;
+    ros::WallTime replay_start = ros::WallTime::now();
+    ros::WallTime next_diagnostics_time = replay_start;
+    long n_replayed = 0;
+    while (nh_.ok() && !stop_requested_ && log.next(recorded_time, &rx.packet, sizeof(rx.packet), rx.length)) {
+      if (n_replayed == 0) {
+        first_recorded_time = recorded_time;
+      }
+      if (rx.length > sizeof(rx.packet)) {
+        n_truncated_++;
+        rx.length = sizeof(rx.packet);
+      }
+      if (replay_rate_ > 0.0) {
+        ros::WallTime due = replay_start + ros::WallDuration((recorded_time - first_recorded_time).toSec() / replay_rate_);
+        ros::WallDuration wait = due - ros::WallTime::now();
+        if (wait.toSec() > 0.0) {
+          wait.sleep();
+        }
+      }
+      rx.receive_time = ros::WallTime::now();
+      n_wakeups_++;
+      if (max_batch_ < 1) {
+        max_batch_ = 1;
+      }
+      dispatchBatch(1);
+      n_replayed++;
+      if (rx.receive_time >= next_diagnostics_time) {
+        updateDiagnostics();
+        next_diagnostics_time = rx.receive_time + ros::WallDuration(DIAGNOSTICS_INTERVAL);
+      }
+    }
+    double elapsed = (ros::WallTime::now() - replay_start).toSec();
+    double recorded = n_replayed > 0 ? (recorded_time - first_recorded_time).toSec() : 0.0;
+    ROS_INFO("cRIO receiver: replayed %ld packets (%.1f s recorded) in %.3f s: %.0f packets/s, %.1fx real time",
+        n_replayed, recorded, elapsed, elapsed > 0.0 ? n_replayed / elapsed : 0.0, elapsed > 0.0 ? recorded / elapsed : 0.0);
+    updateDiagnostics();
+  }
+};
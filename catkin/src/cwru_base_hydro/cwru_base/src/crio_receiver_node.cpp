@@ -0,0 +1,27 @@
+/* Copyright (c) 2010, Eric Perko, edits made by Luc Bettaieb (2015)
+ * All rights reserved
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cwru_base/crio_receiver.h>
+
+int main(int argc, char *argv[]) {
+  ros::init(argc, argv, "crio_receiver");
+  ros::NodeHandle nh;
+  ros::NodeHandle priv_nh("~");
+  cwru_base::CrioReceiver from_crio(nh, priv_nh);
+  from_crio.run();
+  return 0;
+}
@@ -0,0 +1,32 @@
+/*
+ * CrioReceiverNodelet: the crio_receiver node, loadable into a nodelet manager.
+ * Pose and sonar messages are published as shared pointers, so subscribers in the same manager (e.g. the
+ * proximity_safety nodelet) get them with no serialization. The blocking receive loop runs in its own thread.
+ */
+
+#include <boost/thread.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <cwru_base/crio_receiver.h>
+
+namespace cwru_base {
+  class CrioReceiverNodelet : public nodelet::Nodelet {
+    public:
+      ~CrioReceiverNodelet() {
+        if (from_crio_) {
+          from_crio_->stop();
+          receive_thread_.join();
+        }
+      }
+    private:
+      virtual void onInit() {
+        from_crio_.reset(new CrioReceiver(getNodeHandle(), getPrivateNodeHandle()));
+        receive_thread_ = boost::thread(boost::bind(&CrioReceiver::run, from_crio_.get()));
+      }
+      boost::scoped_ptr<CrioReceiver> from_crio_;
+      boost::thread receive_thread_;
+  };
+};
+
+PLUGINLIB_EXPORT_CLASS(cwru_base::CrioReceiverNodelet, nodelet::Nodelet)
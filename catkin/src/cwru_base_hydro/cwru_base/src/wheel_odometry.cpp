@@ -0,0 +1,188 @@
+/*
+ * WheelOdometry: encoder dead reckoning; see wheel_odometry.h.
+ */
+
+#include <math.h>
+#include <geometry_msgs/TransformStamped.h>
+#include <cwru_base/wheel_odometry.h>
+
+namespace cwru_base {
+  static double normalizeAngle(double angle) {
+    while (angle > M_PI) angle -= 2.0 * M_PI;
+    while (angle < -M_PI) angle += 2.0 * M_PI;
+    return angle;
+  }
+
+  WheelOdometry::WheelOdometry(ros::NodeHandle nh, ros::NodeHandle priv_nh) :
+    nh_(nh),
+    priv_nh_(priv_nh),
+    updater_(nh, priv_nh)
+  {
+    double meters_per_tick;
+    priv_nh_.param("meters_per_tick", meters_per_tick, DEFAULT_METERS_PER_TICK);
+    priv_nh_.param("left_meters_per_tick", left_meters_per_tick_, meters_per_tick);
+    priv_nh_.param("right_meters_per_tick", right_meters_per_tick_, meters_per_tick);
+    priv_nh_.param("track_width", track_width_, DEFAULT_TRACK_WIDTH);
+    priv_nh_.param("use_motor_ticks", use_motor_ticks_, false);
+    priv_nh_.param("encoder_bits", encoder_bits_, 32);
+    if (encoder_bits_ < 2 || encoder_bits_ > 32) {
+      ROS_WARN("wheel odometry: encoder_bits must be 2..32; using 32");
+      encoder_bits_ = 32;
+    }
+    priv_nh_.param("odom_frame", odom_frame_, std::string("odom"));
+    priv_nh_.param("base_frame", base_frame_, std::string("base_link"));
+    // off by default: odom_translator already broadcasts odom -> base_link from the cRIO pose
+    priv_nh_.param("publish_tf", publish_tf_, false);
+    double extrapolation_rate;
+    priv_nh_.param("extrapolation_rate", extrapolation_rate, 0.0);
+    priv_nh_.param("max_extrapolation", max_extrapolation_, 0.1);
+
+    have_ticks_ = false;
+    last_left_ticks_ = 0;
+    last_right_ticks_ = 0;
+    x_ = y_ = theta_ = 0.0;
+    vel_ = omega_ = 0.0;
+    n_glitches_ = 0;
+    have_crio_pose_ = false;
+    last_crio_x_ = last_crio_y_ = last_crio_theta_ = 0.0;
+    encoder_distance_ = encoder_turn_ = 0.0;
+    crio_distance_ = crio_turn_ = 0.0;
+    distance_ratio_ = 0.0;
+    turn_error_ = 0.0;
+    have_cross_check_ = false;
+
+    odom_pub_ = nh_.advertise<nav_msgs::Odometry>("wheel_odom", 1);
+    sensors_sub_ = nh_.subscribe("crio_sensors", 10, &WheelOdometry::sensorsCallback, this);
+    pose_sub_ = nh_.subscribe("pose", 10, &WheelOdometry::poseCallback, this);
+    if (extrapolation_rate > 0.0) {
+      extrapolation_timer_ = nh_.createTimer(ros::Duration(1.0 / extrapolation_rate), &WheelOdometry::extrapolationCallback, this);
+    }
+    updater_.setHardwareID("CRIO-192.168.0.100");
+    updater_.add("Wheel Odometry", this, &WheelOdometry::checkCrossCheck);
+    diagnostics_timer_ = nh_.createTimer(ros::Duration(1.0), &WheelOdometry::diagnosticsCallback, this);
+  }
+
+  void WheelOdometry::sensorsCallback(const cwru_msgs::cRIOSensors::ConstPtr& sensors) {
+    int32_t left_ticks = use_motor_ticks_ ? sensors->left_motor_encoder : sensors->left_wheel_encoder;
+    int32_t right_ticks = use_motor_ticks_ ? sensors->right_motor_encoder : sensors->right_wheel_encoder;
+    if (!have_ticks_) {
+      // the counters start wherever the cRIO left them: the first packet only sets the reference
+      have_ticks_ = true;
+      last_left_ticks_ = left_ticks;
+      last_right_ticks_ = right_ticks;
+      last_stamp_ = sensors->header.stamp;
+      publish(last_stamp_, x_, y_, theta_);
+      return;
+    }
+    double dt = (sensors->header.stamp - last_stamp_).toSec();
+    double dl = tickDelta(left_ticks, last_left_ticks_, encoder_bits_) * left_meters_per_tick_;
+    double dr = tickDelta(right_ticks, last_right_ticks_, encoder_bits_) * right_meters_per_tick_;
+    last_left_ticks_ = left_ticks;
+    last_right_ticks_ = right_ticks;
+    double max_step = MAX_WHEEL_SPEED * (dt > 0.1 ? dt : 0.1);
+    if (fabs(dl) > max_step || fabs(dr) > max_step) {
+      n_glitches_++;
+      ROS_WARN_THROTTLE(1.0, "wheel odometry: ignoring an encoder jump of %f/%f m in %f s", dl, dr, dt);
+      last_stamp_ = sensors->header.stamp;
+      return;
+    }
+
+    // straight-line step along the mean heading over the step (second-order accurate on an arc)
+    double ds = 0.5 * (dl + dr);
+    double dtheta = (dr - dl) / track_width_;
+    x_ += ds * cos(theta_ + 0.5 * dtheta);
+    y_ += ds * sin(theta_ + 0.5 * dtheta);
+    theta_ = normalizeAngle(theta_ + dtheta);
+    if (dt > 0.0) {
+      vel_ = ds / dt;
+      omega_ = dtheta / dt;
+    }
+    last_stamp_ = sensors->header.stamp;
+    encoder_distance_ += fabs(ds);
+    encoder_turn_ += dtheta;
+    publish(last_stamp_, x_, y_, theta_);
+  }
+
+  // the last packet's state carried forward at constant velocity and turn rate
+  void WheelOdometry::extrapolationCallback(const ros::TimerEvent& event) {
+    if (!have_ticks_) {
+      return;
+    }
+    ros::Time now = ros::Time::now();
+    double age = (now - last_stamp_).toSec();
+    if (age <= 0.0 || age > max_extrapolation_) {
+      return; // a packet just came in, or they've stopped coming: don't make up motion
+    }
+    double dtheta = omega_ * age;
+    double ds = vel_ * age;
+    publish(now, x_ + ds * cos(theta_ + 0.5 * dtheta), y_ + ds * sin(theta_ + 0.5 * dtheta), normalizeAngle(theta_ + dtheta));
+  }
+
+  void WheelOdometry::publish(const ros::Time& stamp, double x, double y, double theta) {
+    geometry_msgs::Quaternion orientation = tf::createQuaternionMsgFromYaw(theta);
+    // published as a shared pointer: a steering nodelet in the same manager gets it without serialization
+    nav_msgs::OdometryPtr odom(new nav_msgs::Odometry);
+    odom->header.stamp = stamp;
+    odom->header.frame_id = odom_frame_;
+    odom->child_frame_id = base_frame_;
+    odom->pose.pose.position.x = x;
+    odom->pose.pose.position.y = y;
+    odom->pose.pose.orientation = orientation;
+    odom->twist.twist.linear.x = vel_;
+    odom->twist.twist.angular.z = omega_;
+    odom_pub_.publish(odom);
+    if (publish_tf_) {
+      geometry_msgs::TransformStamped transform;
+      transform.header.stamp = stamp;
+      transform.header.frame_id = odom_frame_;
+      transform.child_frame_id = base_frame_;
+      transform.transform.translation.x = x;
+      transform.transform.translation.y = y;
+      transform.transform.rotation = orientation;
+      tf_broadcaster_.sendTransform(transform);
+    }
+  }
+
+  // the cRIO pose is mirrored (y and theta flipped, as in odom_translator), so its turns count negated
+  void WheelOdometry::poseCallback(const cwru_msgs::Pose::ConstPtr& pose) {
+    if (have_crio_pose_) {
+      double dx = pose->x - last_crio_x_;
+      double dy = pose->y - last_crio_y_;
+      crio_distance_ += sqrt(dx * dx + dy * dy);
+      crio_turn_ -= normalizeAngle(pose->theta - last_crio_theta_);
+    }
+    have_crio_pose_ = true;
+    last_crio_x_ = pose->x;
+    last_crio_y_ = pose->y;
+    last_crio_theta_ = pose->theta;
+    if (crio_distance_ >= CROSS_CHECK_DISTANCE) {
+      distance_ratio_ = encoder_distance_ / crio_distance_;
+      turn_error_ = encoder_turn_ - crio_turn_;
+      have_cross_check_ = true;
+      encoder_distance_ = encoder_turn_ = 0.0;
+      crio_distance_ = crio_turn_ = 0.0;
+    }
+  }
+
+  void WheelOdometry::diagnosticsCallback(const ros::TimerEvent& event) {
+    updater_.update();
+  }
+
+  void WheelOdometry::checkCrossCheck(diagnostic_updater::DiagnosticStatusWrapper &stat) {
+    stat.add("Velocity", vel_);
+    stat.add("Turn Rate", omega_);
+    stat.add("Encoder Glitches", n_glitches_);
+    if (!have_cross_check_) {
+      stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "Not enough travel yet to compare with the cRIO pose");
+      return;
+    }
+    stat.add("cRIO Distance Ratio", distance_ratio_);
+    stat.add("cRIO Heading Error", turn_error_);
+    // per CROSS_CHECK_DISTANCE of travel
+    if (fabs(distance_ratio_ - 1.0) > 0.1 || fabs(turn_error_) > 0.2) {
+      stat.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Encoder odometry disagrees with the cRIO pose: slip, or meters_per_tick/track_width need calibrating");
+    } else {
+      stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "Encoder odometry agrees with the cRIO pose");
+    }
+  }
+};
@@ -0,0 +1,14 @@
+/*
+ * wheel_odometry: encoder dead-reckoning odometry from crio_sensors; see wheel_odometry.h.
+ */
+
+#include <cwru_base/wheel_odometry.h>
+
+int main(int argc, char *argv[]) {
+  ros::init(argc, argv, "wheel_odometry");
+  ros::NodeHandle nh;
+  ros::NodeHandle priv_nh("~");
+  cwru_base::WheelOdometry odometry(nh, priv_nh);
+  ros::spin();
+  return 0;
+}
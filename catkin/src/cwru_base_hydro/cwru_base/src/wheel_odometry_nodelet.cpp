@@ -0,0 +1,22 @@
+/*
+ * WheelOdometryNodelet: the wheel_odometry node, loadable into a nodelet manager. Loaded alongside
+ * CrioReceiverNodelet and the steering controller, crio_sensors and wheel_odom pass between them without
+ * serialization. All its work is in callbacks, so it needs no thread of its own.
+ */
+
+#include <boost/scoped_ptr.hpp>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <cwru_base/wheel_odometry.h>
+
+namespace cwru_base {
+  class WheelOdometryNodelet : public nodelet::Nodelet {
+    private:
+      virtual void onInit() {
+        odometry_.reset(new WheelOdometry(getNodeHandle(), getPrivateNodeHandle()));
+      }
+      boost::scoped_ptr<WheelOdometry> odometry_;
+  };
+};
+
+PLUGINLIB_EXPORT_CLASS(cwru_base::WheelOdometryNodelet, nodelet::Nodelet)
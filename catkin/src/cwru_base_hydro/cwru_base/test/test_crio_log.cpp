@@ -0,0 +1,175 @@
+// round-trips datagrams through CrioLogWriter/CrioLogReader (src/crio_log.cpp): the magic, receive times, lengths
+// and bytes survive; records longer than the reader's buffer are skipped to the next record; a log cut off
+// mid-record ends with next() returning false
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <cwru_base/crio_log.h>
+#include <cwru_base/packets.h>
+
+using namespace cwru_base;
+
+class CrioLogTest : public testing::Test {
+  protected:
+    virtual void SetUp() {
+      char path[] = "/tmp/crio_log_testXXXXXX";
+      int fd = mkstemp(path);
+      ASSERT_GE(fd, 0);
+      ::close(fd);
+      unlink(path); // the writer creates it, and writes the magic into a new file
+      path_ = path;
+    }
+
+    virtual void TearDown() {
+      unlink(path_.c_str());
+    }
+
+    // datagram i: length and contents vary with i
+    std::vector<uint8_t> datagram(int i) {
+      std::vector<uint8_t> bytes(1 + (i * 37) % 200);
+      for (size_t j = 0; j < bytes.size(); j++) {
+        bytes[j] = (uint8_t) (i * 31 + j * 7);
+      }
+      return bytes;
+    }
+
+    ros::WallTime stamp(int i) {
+      return ros::WallTime(1400000000 + i, (i * 123457) % 1000000000);
+    }
+
+    void writeLog(int n) {
+      CrioLogWriter writer;
+      ASSERT_TRUE(writer.open(path_));
+      for (int i = 0; i < n; i++) {
+        std::vector<uint8_t> bytes = datagram(i);
+        ASSERT_TRUE(writer.write(stamp(i), &bytes[0], bytes.size()));
+      }
+      writer.close();
+    }
+
+    long fileSize() {
+      FILE* file = fopen(path_.c_str(), "rb");
+      fseek(file, 0, SEEK_END);
+      long size = ftell(file);
+      fclose(file);
+      return size;
+    }
+
+    std::string path_;
+};
+
+TEST_F(CrioLogTest, RoundTrip) {
+  const int n = 50;
+  writeLog(n);
+
+  // the magic, then records
+  FILE* file = fopen(path_.c_str(), "rb");
+  char magic[8];
+  ASSERT_EQ(1u, fread(magic, 8, 1, file));
+  fclose(file);
+  EXPECT_EQ(0, memcmp(magic, "CRIOLOG1", 8));
+
+  CrioLogReader reader;
+  ASSERT_TRUE(reader.open(path_));
+  uint8_t buffer[BUF_SIZE];
+  for (int i = 0; i < n; i++) {
+    ros::WallTime receive_time;
+    size_t length = 0;
+    ASSERT_TRUE(reader.next(receive_time, buffer, sizeof(buffer), length)) << "record " << i;
+    std::vector<uint8_t> expected = datagram(i);
+    EXPECT_EQ(stamp(i).sec, receive_time.sec) << "record " << i;
+    EXPECT_EQ(stamp(i).nsec, receive_time.nsec) << "record " << i;
+    ASSERT_EQ(expected.size(), length) << "record " << i;
+    EXPECT_EQ(0, memcmp(&expected[0], buffer, length)) << "record " << i;
+  }
+  ros::WallTime receive_time;
+  size_t length = 0;
+  EXPECT_FALSE(reader.next(receive_time, buffer, sizeof(buffer), length)); // end of the log
+}
+
+// reopening a log appends to it, without a second magic
+TEST_F(CrioLogTest, Append) {
+  writeLog(3);
+  long size = fileSize();
+  {
+    CrioLogWriter writer;
+    ASSERT_TRUE(writer.open(path_));
+    uint8_t byte = 42;
+    ASSERT_TRUE(writer.write(stamp(99), &byte, 1));
+  }
+  EXPECT_EQ(size + (long) sizeof(CrioLogRecord) + 1, fileSize());
+
+  CrioLogReader reader;
+  ASSERT_TRUE(reader.open(path_));
+  uint8_t buffer[BUF_SIZE];
+  ros::WallTime receive_time;
+  size_t length;
+  for (int i = 0; i < 3; i++) {
+    ASSERT_TRUE(reader.next(receive_time, buffer, sizeof(buffer), length));
+  }
+  ASSERT_TRUE(reader.next(receive_time, buffer, sizeof(buffer), length));
+  EXPECT_EQ(1u, length);
+  EXPECT_EQ(42, buffer[0]);
+  EXPECT_EQ(stamp(99).sec, receive_time.sec);
+}
+
+// a record longer than the buffer: the start of it is returned, with its full length, and the next record is intact
+TEST_F(CrioLogTest, OversizedRecordSkipped) {
+  writeLog(10);
+  CrioLogReader reader;
+  ASSERT_TRUE(reader.open(path_));
+  uint8_t buffer[16];
+  for (int i = 0; i < 10; i++) {
+    ros::WallTime receive_time;
+    size_t length = 0;
+    ASSERT_TRUE(reader.next(receive_time, buffer, sizeof(buffer), length)) << "record " << i;
+    std::vector<uint8_t> expected = datagram(i);
+    ASSERT_EQ(expected.size(), length) << "record " << i;
+    EXPECT_EQ(stamp(i).sec, receive_time.sec) << "record " << i;
+    size_t n = length < sizeof(buffer) ? length : sizeof(buffer);
+    EXPECT_EQ(0, memcmp(&expected[0], buffer, n)) << "record " << i;
+  }
+}
+
+// a log cut off inside the last record (as a crash mid-write leaves it): everything before it reads back, then
+// next() is false, wherever the cut is, and whether or not the record fits the buffer
+TEST_F(CrioLogTest, TruncatedTrailingRecord) {
+  const int n = 5;
+  writeLog(n);
+  long full_size = fileSize();
+  long last_record = full_size - (long) (sizeof(CrioLogRecord) + datagram(n - 1).size());
+  const size_t buffer_sizes[] = { BUF_SIZE, 16 };
+  for (long size = full_size - 1; size > last_record; size--) { // shrinking, so the cut-off bytes are really gone
+    ASSERT_EQ(0, truncate(path_.c_str(), size));
+    for (int b = 0; b < 2; b++) {
+      CrioLogReader reader;
+      ASSERT_TRUE(reader.open(path_));
+      uint8_t buffer[BUF_SIZE];
+      ros::WallTime receive_time;
+      size_t length;
+      for (int i = 0; i < n - 1; i++) {
+        ASSERT_TRUE(reader.next(receive_time, buffer, buffer_sizes[b], length)) << "size " << size << " record " << i;
+      }
+      EXPECT_FALSE(reader.next(receive_time, buffer, buffer_sizes[b], length)) << "size " << size << " buffer " << buffer_sizes[b];
+    }
+  }
+}
+
+TEST_F(CrioLogTest, NotALog) {
+  FILE* file = fopen(path_.c_str(), "wb");
+  fputs("not a cRIO log", file);
+  fclose(file);
+  CrioLogReader reader;
+  EXPECT_FALSE(reader.open(path_));
+  EXPECT_FALSE(reader.open(path_ + ".missing"));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,276 @@
+// checks the table-driven packet decoding (include/cwru_base/packet_decoder.h): known big-endian datagrams decode
+// to what the old per-field swap functions gave, short and unknown packets are rejected untouched, and random
+// datagrams of random length never get past the length check into bytes they don't have
+
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gtest/gtest.h>
+#include <cwru_base/packet_decoder.h>
+
+using namespace cwru_base;
+
+// the receiver's per-field swaps from before packet_decoder.h, as the reference
+float swap_float(float in) {
+  uint32_t temp;
+  memcpy(&temp, &in, 4);
+  temp = ntohl(temp);
+  float out;
+  memcpy(&out, &temp, 4);
+  return out;
+}
+
+double swap_double(double in) {
+  uint64_t temp;
+  memcpy(&temp, &in, 8);
+  temp = be64toh(temp);
+  double out;
+  memcpy(&out, &temp, 8);
+  return out;
+}
+
+// host-order values written big-endian, as the cRIO sends them
+template <typename T> void putBigEndian(CRIOPacket& packet, size_t offset, T value) {
+  uint8_t bytes[sizeof(T)];
+  memcpy(bytes, &value, sizeof(T));
+  uint8_t* dst = (uint8_t*) &packet + offset;
+  for (size_t i = 0; i < sizeof(T); i++) {
+    dst[i] = bytes[sizeof(T) - 1 - i];
+  }
+}
+
+#define PUT(packet, type, field, value) putBigEndian(packet, offsetof(type, field), value)
+
+// the wire sizes of the packets, up to their last field
+TEST(PacketDecoder, MinLengths) {
+  EXPECT_EQ(72u, findPacketLayout(POSE_t)->min_length);
+  EXPECT_EQ(47u, findPacketLayout(DIAGNOSTICS_t)->min_length);
+  EXPECT_EQ(48u, findPacketLayout(GPS_t)->min_length);
+}
+
+TEST(PacketDecoder, UnknownTypes) {
+  for (int type = -128; type < 128; type++) {
+    bool handled = (type == POSE_t || type == DIAGNOSTICS_t || type == GPS_t);
+    EXPECT_EQ(handled, findPacketLayout((int8_t) type) != NULL) << "type " << type;
+    if (!handled) {
+      CRIOPacket packet;
+      memset(&packet, 0x5a, sizeof(packet));
+      packet.command.type = (int8_t) type;
+      CRIOPacket before = packet;
+      EXPECT_EQ(UNKNOWN_TYPE, decodePacketInPlace(packet, sizeof(packet))) << "type " << type;
+      EXPECT_EQ(0, memcmp(&before, &packet, sizeof(packet))) << "type " << type;
+    }
+  }
+}
+
+TEST(PacketDecoder, Pose) {
+  CRIOPacket packet;
+  memset(&packet, 0, sizeof(packet));
+  packet.pose.type = POSE_t;
+  packet.pose.data1 = 1;
+  packet.pose.data2 = 2;
+  packet.pose.data3 = 3;
+  PUT(packet, CRIOPosePacket, x, 1.5f);
+  PUT(packet, CRIOPosePacket, y, -2.25f);
+  PUT(packet, CRIOPosePacket, theta, 3.0f);
+  PUT(packet, CRIOPosePacket, vel, 0.5f);
+  PUT(packet, CRIOPosePacket, omega, -0.125f);
+  PUT(packet, CRIOPosePacket, yaw_bias, 1e-3f);
+  PUT(packet, CRIOPosePacket, x_variance, 0.01f);
+  PUT(packet, CRIOPosePacket, y_variance, 0.02f);
+  PUT(packet, CRIOPosePacket, theta_variance, 0.03f);
+  PUT(packet, CRIOPosePacket, vel_variance, 0.04f);
+  PUT(packet, CRIOPosePacket, omega_variance, 0.05f);
+  PUT(packet, CRIOPosePacket, yaw_bias_variance, 0.06f);
+  PUT(packet, CRIOPosePacket, sonar_ping_1, 1.0f);
+  PUT(packet, CRIOPosePacket, sonar_ping_2, 2.0f);
+  PUT(packet, CRIOPosePacket, sonar_ping_3, 3.0f);
+  PUT(packet, CRIOPosePacket, sonar_ping_4, 4.0f);
+  PUT(packet, CRIOPosePacket, sonar_ping_5, 5.0f);
+  CRIOPosePacket raw = packet.pose;
+
+  ASSERT_EQ(DECODED, decodePacketInPlace(packet, 72));
+  const CRIOPosePacket& p = packet.pose;
+  EXPECT_EQ(1.5f, p.x);
+  EXPECT_EQ(-2.25f, p.y);
+  EXPECT_EQ(-0.125f, p.omega);
+  EXPECT_EQ(5.0f, p.sonar_ping_5);
+  EXPECT_EQ(1, p.data1); // single bytes stay as they are
+  EXPECT_EQ(3, p.data3);
+  // field by field, as the old decoder did it
+  EXPECT_EQ(swap_float(raw.x), p.x);
+  EXPECT_EQ(swap_float(raw.y), p.y);
+  EXPECT_EQ(swap_float(raw.theta), p.theta);
+  EXPECT_EQ(swap_float(raw.vel), p.vel);
+  EXPECT_EQ(swap_float(raw.omega), p.omega);
+  EXPECT_EQ(swap_float(raw.yaw_bias), p.yaw_bias);
+  EXPECT_EQ(swap_float(raw.x_variance), p.x_variance);
+  EXPECT_EQ(swap_float(raw.y_variance), p.y_variance);
+  EXPECT_EQ(swap_float(raw.theta_variance), p.theta_variance);
+  EXPECT_EQ(swap_float(raw.vel_variance), p.vel_variance);
+  EXPECT_EQ(swap_float(raw.omega_variance), p.omega_variance);
+  EXPECT_EQ(swap_float(raw.yaw_bias_variance), p.yaw_bias_variance);
+  EXPECT_EQ(swap_float(raw.sonar_ping_1), p.sonar_ping_1);
+  EXPECT_EQ(swap_float(raw.sonar_ping_2), p.sonar_ping_2);
+  EXPECT_EQ(swap_float(raw.sonar_ping_3), p.sonar_ping_3);
+  EXPECT_EQ(swap_float(raw.sonar_ping_4), p.sonar_ping_4);
+  EXPECT_EQ(swap_float(raw.sonar_ping_5), p.sonar_ping_5);
+}
+
+TEST(PacketDecoder, Diagnostics) {
+  CRIOPacket packet;
+  memset(&packet, 0, sizeof(packet));
+  packet.diagnostics.type = DIAGNOSTICS_t;
+  packet.diagnostics.status = 7;
+  packet.diagnostics.eStopTriggered = 1;
+  packet.diagnostics.RCOn = 0;
+  PUT(packet, CRIODiagnosticsPacket, FPGAVersion, (int16_t) 0x0102);
+  PUT(packet, CRIODiagnosticsPacket, VMonitor_cRIO_mV, (int16_t) 23500);
+  PUT(packet, CRIODiagnosticsPacket, LWheelTicks, (int32_t) 123456789);
+  PUT(packet, CRIODiagnosticsPacket, RWheelTicks, (int32_t) -987654321);
+  PUT(packet, CRIODiagnosticsPacket, LMotorTicks, (int32_t) 0x7fffffff);
+  PUT(packet, CRIODiagnosticsPacket, RMotorTicks, (int32_t) -1);
+  PUT(packet, CRIODiagnosticsPacket, VMonitor_24V_mV, (int16_t) 24100);
+  PUT(packet, CRIODiagnosticsPacket, VMonitor_13V_mV, (int16_t) 13200);
+  PUT(packet, CRIODiagnosticsPacket, VMonitor_5V_mV, (int16_t) 5010);
+  PUT(packet, CRIODiagnosticsPacket, VMonitor_eStop_mV, (int16_t) -5);
+  PUT(packet, CRIODiagnosticsPacket, YawRate_mV, (int16_t) 2500);
+  PUT(packet, CRIODiagnosticsPacket, YawSwing_mV, (int16_t) 2501);
+  PUT(packet, CRIODiagnosticsPacket, YawTemp_mV, (int16_t) 2502);
+  PUT(packet, CRIODiagnosticsPacket, YawRef_mV, (int16_t) 2503);
+  PUT(packet, CRIODiagnosticsPacket, C1Steering, (uint16_t) 1500);
+  PUT(packet, CRIODiagnosticsPacket, C2Throttle, (uint16_t) 1600);
+  PUT(packet, CRIODiagnosticsPacket, C3Mode, (uint16_t) 0xfffe);
+  packet.diagnostics.RCeStop = 1;
+  CRIODiagnosticsPacket raw = packet.diagnostics;
+
+  ASSERT_EQ(DECODED, decodePacketInPlace(packet, 47));
+  const CRIODiagnosticsPacket& p = packet.diagnostics;
+  EXPECT_EQ(7, p.status);
+  EXPECT_EQ(1, p.eStopTriggered);
+  EXPECT_EQ(1, p.RCeStop);
+  EXPECT_EQ(123456789, p.LWheelTicks);
+  EXPECT_EQ(-987654321, p.RWheelTicks);
+  EXPECT_EQ(-5, p.VMonitor_eStop_mV);
+  EXPECT_EQ(0xfffe, p.C3Mode);
+  EXPECT_EQ((int16_t) be16toh(raw.FPGAVersion), p.FPGAVersion);
+  EXPECT_EQ((int16_t) be16toh(raw.VMonitor_cRIO_mV), p.VMonitor_cRIO_mV);
+  EXPECT_EQ((int32_t) be32toh(raw.LWheelTicks), p.LWheelTicks);
+  EXPECT_EQ((int32_t) be32toh(raw.RWheelTicks), p.RWheelTicks);
+  EXPECT_EQ((int32_t) be32toh(raw.LMotorTicks), p.LMotorTicks);
+  EXPECT_EQ((int32_t) be32toh(raw.RMotorTicks), p.RMotorTicks);
+  EXPECT_EQ((int16_t) be16toh(raw.VMonitor_24V_mV), p.VMonitor_24V_mV);
+  EXPECT_EQ((int16_t) be16toh(raw.VMonitor_13V_mV), p.VMonitor_13V_mV);
+  EXPECT_EQ((int16_t) be16toh(raw.VMonitor_5V_mV), p.VMonitor_5V_mV);
+  EXPECT_EQ((int16_t) be16toh(raw.VMonitor_eStop_mV), p.VMonitor_eStop_mV);
+  EXPECT_EQ((int16_t) be16toh(raw.YawRate_mV), p.YawRate_mV);
+  EXPECT_EQ((int16_t) be16toh(raw.YawSwing_mV), p.YawSwing_mV);
+  EXPECT_EQ((int16_t) be16toh(raw.YawTemp_mV), p.YawTemp_mV);
+  EXPECT_EQ((int16_t) be16toh(raw.YawRef_mV), p.YawRef_mV);
+  EXPECT_EQ(be16toh(raw.C1Steering), p.C1Steering);
+  EXPECT_EQ(be16toh(raw.C2Throttle), p.C2Throttle);
+  EXPECT_EQ(be16toh(raw.C3Mode), p.C3Mode);
+}
+
+TEST(PacketDecoder, GPS) {
+  CRIOPacket packet;
+  memset(&packet, 0, sizeof(packet));
+  packet.gps.type = GPS_t;
+  packet.gps.satellites_computed = 9;
+  packet.gps.satellites_tracked = 11;
+  PUT(packet, CRIOGPSPacket, latitude, 41.5043);
+  PUT(packet, CRIOGPSPacket, longitude, -81.6084);
+  PUT(packet, CRIOGPSPacket, lat_std_dev, 0.75f);
+  PUT(packet, CRIOGPSPacket, long_std_dev, 0.5f);
+  PUT(packet, CRIOGPSPacket, solution_status, (uint32_t) 3);
+  PUT(packet, CRIOGPSPacket, position_type, (uint32_t) 0x01020304);
+  PUT(packet, CRIOGPSPacket, differential_age, 2.5f);
+  PUT(packet, CRIOGPSPacket, solution_age, 0.25f);
+  CRIOGPSPacket raw = packet.gps;
+
+  ASSERT_EQ(DECODED, decodePacketInPlace(packet, 48));
+  const CRIOGPSPacket& p = packet.gps;
+  EXPECT_EQ(41.5043, p.latitude);
+  EXPECT_EQ(-81.6084, p.longitude);
+  EXPECT_EQ(9, p.satellites_computed);
+  EXPECT_EQ(0x01020304u, p.position_type);
+  EXPECT_EQ(swap_double(raw.latitude), p.latitude);
+  EXPECT_EQ(swap_double(raw.longitude), p.longitude);
+  EXPECT_EQ(swap_float(raw.lat_std_dev), p.lat_std_dev);
+  EXPECT_EQ(swap_float(raw.long_std_dev), p.long_std_dev);
+  EXPECT_EQ(be32toh(raw.solution_status), p.solution_status);
+  EXPECT_EQ(be32toh(raw.position_type), p.position_type);
+  EXPECT_EQ(swap_float(raw.differential_age), p.differential_age);
+  EXPECT_EQ(swap_float(raw.solution_age), p.solution_age);
+}
+
+// one byte short of a whole packet is dropped, untouched; exactly whole is decoded
+TEST(PacketDecoder, ShortPackets) {
+  const int8_t types[] = { POSE_t, DIAGNOSTICS_t, GPS_t };
+  for (int t = 0; t < 3; t++) {
+    size_t min_length = findPacketLayout(types[t])->min_length;
+    CRIOPacket packet;
+    memset(&packet, 0xa5, sizeof(packet));
+    packet.command.type = types[t];
+    CRIOPacket before = packet;
+    EXPECT_EQ(SHORT_PACKET, decodePacketInPlace(packet, min_length - 1)) << "type " << (int) types[t];
+    EXPECT_EQ(0, memcmp(&before, &packet, sizeof(packet))) << "type " << (int) types[t];
+    EXPECT_EQ(SHORT_PACKET, decodePacketInPlace(packet, 0)) << "type " << (int) types[t];
+    EXPECT_EQ(DECODED, decodePacketInPlace(packet, min_length)) << "type " << (int) types[t];
+  }
+}
+
+// random bytes of random length, mostly with a handled type: a datagram is decoded exactly when its type is handled
+// and it is long enough, only the bytes of swapped fields change, and nothing past the packet's end is touched
+TEST(PacketDecoder, RandomDatagrams) {
+  unsigned int seed = 12345;
+  const int8_t types[] = { POSE_t, DIAGNOSTICS_t, GPS_t, SONARS_t, COMPASS_t, -1, 100 };
+  int n_decoded = 0, n_short = 0, n_unknown = 0;
+  for (int trial = 0; trial < 20000; trial++) {
+    CRIOPacket packet;
+    uint8_t* bytes = (uint8_t*) &packet;
+    for (size_t i = 0; i < sizeof(packet); i++) {
+      bytes[i] = (uint8_t) rand_r(&seed);
+    }
+    if (rand_r(&seed) % 8 != 0) {
+      packet.command.type = types[rand_r(&seed) % 7];
+    }
+    // lengths around the packet sizes, plus the occasional full buffer
+    size_t length = (rand_r(&seed) % 16 == 0) ? sizeof(packet) : (size_t) (rand_r(&seed) % 80);
+    CRIOPacket before = packet;
+
+    const PacketLayout* layout = findPacketLayout(packet.command.type);
+    DecodeStatus expected = (length < 1) ? SHORT_PACKET : (layout == NULL) ? UNKNOWN_TYPE :
+        (length < layout->min_length) ? SHORT_PACKET : DECODED;
+    DecodeStatus status = decodePacketInPlace(packet, length);
+    ASSERT_EQ(expected, status) << "trial " << trial << " type " << (int) before.command.type << " length " << length;
+
+    if (status != DECODED) {
+      n_short += (status == SHORT_PACKET);
+      n_unknown += (status == UNKNOWN_TYPE);
+      ASSERT_EQ(0, memcmp(&before, &packet, sizeof(packet))) << "trial " << trial;
+      continue;
+    }
+    n_decoded++;
+    // swap the fields back by hand: the packet must come back to what was received
+    uint8_t* before_bytes = (uint8_t*) &before;
+    for (int f = 0; f < layout->n_fields; f++) {
+      const FieldSwap& field = layout->fields[f];
+      ASSERT_LE(field.offset + field.size, layout->min_length);
+      for (int i = 0; i < field.size; i++) {
+        ASSERT_EQ(before_bytes[field.offset + i], bytes[field.offset + field.size - 1 - i]) << "trial " << trial;
+      }
+      memcpy(bytes + field.offset, before_bytes + field.offset, field.size);
+    }
+    ASSERT_EQ(0, memcmp(&before, &packet, sizeof(packet))) << "trial " << trial;
+  }
+  // every outcome was exercised
+  EXPECT_GT(n_decoded, 1000);
+  EXPECT_GT(n_short, 1000);
+  EXPECT_GT(n_unknown, 1000);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,4 +1,6 @@
 #include "sonar_clearing_filter.h"
+#include "fused_scan_filter.h"
+#include "temporal_clearing_filter.h"
 #include "sensor_msgs/LaserScan.h"
 #include "filters/filter_base.h"
 
@@ -6,3 +8,5 @@
 
 
 PLUGINLIB_REGISTER_CLASS(LaserScanSonarFilter, laser_filters::LaserScanSonarFilter, filters::FilterBase<sensor_msgs::LaserScan>)
+PLUGINLIB_REGISTER_CLASS(LaserScanFusedFilter, laser_filters::LaserScanFusedFilter, filters::FilterBase<sensor_msgs::LaserScan>)
+PLUGINLIB_REGISTER_CLASS(LaserScanTemporalClearingFilter, laser_filters::LaserScanTemporalClearingFilter, filters::FilterBase<sensor_msgs::LaserScan>)
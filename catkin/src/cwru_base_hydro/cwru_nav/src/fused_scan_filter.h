@@ -0,0 +1,103 @@
+/*
+ * LaserScanFusedFilter: several per-beam cwru_nav range filters as one filter, so a chain of them costs one
+ * pass over the scan instead of one copy and one pass per filter.
+ * The scan is processed in chunks small enough to stay in L1: the first stage reads the input chunk and writes
+ * the output chunk, and the later stages rewrite that output chunk in place.
+ *
+ * params:
+ *   stages: names, applied in this order
+ *     sonar_clear   max-range readings become range_max - alpha (as LaserScanSonarFilter)
+ *     range_bounds  readings outside [lower_threshold, upper_threshold] become range_max + 1, i.e. invalid
+ *   alpha, lower_threshold, upper_threshold: as above
+ */
+
+#ifndef LASER_SCAN_FUSED_FILTER_H
+#define LASER_SCAN_FUSED_FILTER_H
+
+#include <string>
+#include <vector>
+#include "filters/filter_base.h"
+#include "sensor_msgs/LaserScan.h"
+#include "scan_kernels.h"
+
+namespace laser_filters
+{
+
+class LaserScanFusedFilter : public filters::FilterBase<sensor_msgs::LaserScan>
+{
+public:
+  static const size_t CHUNK_SIZE = 256; // beams; 1 KB of ranges
+
+  enum StageType { SONAR_CLEAR, RANGE_BOUNDS };
+
+  bool configure()
+  {
+    alpha_ = 0.02;
+    lower_threshold_ = 0.0;
+    upper_threshold_ = 100000.0;
+    getParam("alpha", alpha_);
+    getParam("lower_threshold", lower_threshold_);
+    getParam("upper_threshold", upper_threshold_);
+    std::vector<std::string> stage_names;
+    if (!getParam("stages", stage_names) || stage_names.empty()) {
+      ROS_ERROR("LaserScanFusedFilter needs a list of stages");
+      return false;
+    }
+    stages_.clear();
+    for (size_t i = 0; i < stage_names.size(); i++) {
+      if (stage_names[i] == "sonar_clear") {
+        stages_.push_back(SONAR_CLEAR);
+      } else if (stage_names[i] == "range_bounds") {
+        stages_.push_back(RANGE_BOUNDS);
+      } else {
+        ROS_ERROR("LaserScanFusedFilter: unknown stage \"%s\"", stage_names[i].c_str());
+        return false;
+      }
+    }
+    return true;
+  }
+
+  virtual ~LaserScanFusedFilter()
+  {
+  }
+
+  bool update(const sensor_msgs::LaserScan& input_scan, sensor_msgs::LaserScan& filtered_scan)
+  {
+    if (&filtered_scan != &input_scan) {
+      copyScanMetadata(input_scan, filtered_scan);
+      filtered_scan.intensities = input_scan.intensities;
+      filtered_scan.ranges.resize(input_scan.ranges.size());
+    }
+    size_t n = input_scan.ranges.size();
+    if (n == 0) {
+      return true;
+    }
+    const float* in = &input_scan.ranges[0];
+    float* out = &filtered_scan.ranges[0];
+    float range_max = input_scan.range_max;
+    for (size_t start = 0; start < n; start += CHUNK_SIZE) {
+      size_t count = (n - start < CHUNK_SIZE) ? n - start : CHUNK_SIZE;
+      const float* src = in + start;
+      float* dst = out + start;
+      for (size_t s = 0; s < stages_.size(); s++) {
+        if (stages_[s] == SONAR_CLEAR) {
+          replaceAtOrAbove(src, dst, count, range_max, range_max - alpha_);
+        } else {
+          replaceOutside(src, dst, count, lower_threshold_, upper_threshold_, range_max + 1.0);
+        }
+        src = dst; // the rest run in place, on a chunk that's still in cache
+      }
+    }
+    return true;
+  }
+
+private:
+  std::vector<StageType> stages_;
+  double alpha_;
+  double lower_threshold_;
+  double upper_threshold_;
+};
+
+}
+
+#endif // LASER_SCAN_FUSED_FILTER_H
@@ -33,23 +33,93 @@
  *********************************************************************/
 #include <ros/ros.h>
 #include <sensor_msgs/PointCloud.h>
+#include <sensor_msgs/PointCloud2.h>
 #include <nav_msgs/OccupancyGrid.h>
 #include <geometry_msgs/Point32.h>
+#include <cwru_msgs/MapTiles.h>
 #include <tf/transform_listener.h>
+#include <math.h>
+#include <string.h>
 #include <string>
 #include <list>
+#include <vector>
 
 std::list<geometry_msgs::Point32> points;
 std::string frame_id;
 bool recieved_map;
 bool updated_map;
 
+//windowed mode: only the obstacles near the robot go out, found through a grid of square tiles built once per map.
+//tile_points holds every obstacle point, sorted by tile; tile t's are [tile_start[t], tile_start[t+1])
+bool windowed;
+double tile_size;
+double tile_meters;
+std::vector<geometry_msgs::Point32> tile_points;
+std::vector<unsigned int> tile_start;
+double tiles_origin_x, tiles_origin_y;
+int tiles_x, tiles_y;
+
+//delta mode: the same tiles, but a tile's points are only sent when it comes into the window (see cwru_msgs/MapTiles).
+//in_window flags the tiles sent last time, listed in last_window
+bool delta;
+unsigned int map_id;
+std::vector<unsigned char> in_window;
+std::vector<unsigned int> last_window;
+
+void buildTiles(const nav_msgs::OccupancyGrid& map)
+{
+	unsigned int width=map.info.width;
+	unsigned int height=map.info.height;
+	//tiles are whole numbers of cells, so every cell falls in exactly one
+	int cells_per_tile=(int)ceil(tile_size/map.info.resolution-1e-6);
+	if(cells_per_tile<1) cells_per_tile=1;
+	tiles_x=(width+cells_per_tile-1)/cells_per_tile;
+	tiles_y=(height+cells_per_tile-1)/cells_per_tile;
+	tiles_origin_x=map.info.origin.position.x;
+	tiles_origin_y=map.info.origin.position.y;
+	tile_meters=cells_per_tile*map.info.resolution;
+
+	//counting sort: count each tile's obstacles, turn the counts into start offsets, then drop the points in
+	tile_start.assign(tiles_x*tiles_y+1,0);
+	for(unsigned int m=0;m<height;m++){
+		for(unsigned int n=0;n<width;n++){
+			if(map.data[m*width+n]==100){
+				tile_start[(m/cells_per_tile)*tiles_x+n/cells_per_tile+1]++;
+			}
+		}
+	}
+	for(unsigned int t=1;t<tile_start.size();t++){
+		tile_start[t]+=tile_start[t-1];
+	}
+	tile_points.resize(tile_start.back());
+	std::vector<unsigned int> next(tile_start.begin(),tile_start.end()-1);
+	geometry_msgs::Point32 p;
+	for(unsigned int m=0;m<height;m++){
+		for(unsigned int n=0;n<width;n++){
+			if(map.data[m*width+n]==100){
+				p.x=n*map.info.resolution+map.info.origin.position.x;
+				p.y=m*map.info.resolution+map.info.origin.position.y;
+				tile_points[next[(m/cells_per_tile)*tiles_x+n/cells_per_tile]++]=p;
+			}
+		}
+	}
+	//a new map: nothing has been sent from it yet
+	in_window.assign(tiles_x*tiles_y,0);
+	last_window.clear();
+	map_id++;
+	ROS_INFO("map_as_sensor: %u obstacle points in %d x %d tiles of %.2f m",(unsigned int)tile_points.size(),tiles_x,tiles_y,tile_meters);
+}
+
 void mapOccupancyGridCallback(const  nav_msgs::OccupancyGrid::ConstPtr& msg)
 {
 	points.clear();
 	recieved_map=true;
 	updated_map=true;
 	frame_id=msg->header.frame_id;
+	if(windowed || delta){
+		buildTiles(*msg);
+		return;
+	}
 	geometry_msgs::Point32 p;
 	for(unsigned int m=0;m<msg->info.height;m++){
 		for(unsigned int n=0;n<msg->info.width;n++){
@@ -64,6 +134,109 @@ void mapOccupancyGridCallback(const  nav_msgs::OccupancyGrid::ConstPtr& msg)
 }
 
 
+//the obstacles within window_radius of the target frame origin, transformed into target frame and written into
+//cloud, whose buffers are reused from cycle to cycle
+void fillWindowCloud(const tf::StampedTransform& map_to_target, double window_radius, float z, float intensity, sensor_msgs::PointCloud2& cloud)
+{
+	//the target frame origin in the map frame
+	tf::Vector3 center=map_to_target.inverse()(tf::Vector3(0,0,0));
+	int tx_min=(int)floor((center.x()-window_radius-tiles_origin_x)/tile_meters);
+	int tx_max=(int)floor((center.x()+window_radius-tiles_origin_x)/tile_meters);
+	int ty_min=(int)floor((center.y()-window_radius-tiles_origin_y)/tile_meters);
+	int ty_max=(int)floor((center.y()+window_radius-tiles_origin_y)/tile_meters);
+	if(tx_min<0) tx_min=0;
+	if(ty_min<0) ty_min=0;
+	if(tx_max>=tiles_x) tx_max=tiles_x-1;
+	if(ty_max>=tiles_y) ty_max=tiles_y-1;
+
+	//worst case first, so the copy loop never grows the buffer; it only allocates when the window holds more than ever before
+	unsigned int candidates=0;
+	for(int ty=ty_min;ty<=ty_max;ty++){
+		if(tx_min<=tx_max) candidates+=tile_start[ty*tiles_x+tx_max+1]-tile_start[ty*tiles_x+tx_min];
+	}
+	cloud.data.resize(candidates*cloud.point_step);
+
+	double radius_sq=window_radius*window_radius;
+	unsigned int count=0;
+	float values[4];
+	values[2]=z;
+	values[3]=intensity;
+	for(int ty=ty_min;ty<=ty_max;ty++){
+		//a row of tiles is contiguous in tile_points
+		if(tx_min>tx_max) break;
+		unsigned int end=tile_start[ty*tiles_x+tx_max+1];
+		for(unsigned int i=tile_start[ty*tiles_x+tx_min];i<end;i++){
+			const geometry_msgs::Point32& p=tile_points[i];
+			double dx=p.x-center.x();
+			double dy=p.y-center.y();
+			if(dx*dx+dy*dy>radius_sq) continue;
+			tf::Vector3 out=map_to_target(tf::Vector3(p.x,p.y,0));
+			values[0]=out.x();
+			values[1]=out.y();
+			memcpy(&cloud.data[count*cloud.point_step],values,sizeof(values));
+			count++;
+		}
+	}
+	cloud.data.resize(count*cloud.point_step);
+	cloud.width=count;
+	cloud.row_step=count*cloud.point_step;
+}
+
+//fill msg with the tiles that came into the window around center (in the map frame) since the last call, or with
+//every tile in it if full (or the first call since a new map). false if the window's tiles haven't changed
+bool fillTileDelta(const tf::Vector3& center, double window_radius, float z, bool full, cwru_msgs::MapTiles& msg)
+{
+	//nothing sent from this map yet, so every tile in the window is new
+	if(last_window.empty()) full=true;
+	msg.map_id=map_id;
+	msg.full=full;
+	msg.window_tiles.clear();
+	msg.new_tiles.clear();
+	msg.tile_ends.clear();
+	msg.points.clear();
+
+	int tx_min=(int)floor((center.x()-window_radius-tiles_origin_x)/tile_meters);
+	int tx_max=(int)floor((center.x()+window_radius-tiles_origin_x)/tile_meters);
+	int ty_min=(int)floor((center.y()-window_radius-tiles_origin_y)/tile_meters);
+	int ty_max=(int)floor((center.y()+window_radius-tiles_origin_y)/tile_meters);
+	if(tx_min<0) tx_min=0;
+	if(ty_min<0) ty_min=0;
+	if(tx_max>=tiles_x) tx_max=tiles_x-1;
+	if(ty_max>=tiles_y) ty_max=tiles_y-1;
+	double radius_sq=window_radius*window_radius;
+	bool changed=full;
+	for(int ty=ty_min;ty<=ty_max;ty++){
+		for(int tx=tx_min;tx<=tx_max;tx++){
+			unsigned int t=ty*tiles_x+tx;
+			if(tile_start[t+1]==tile_start[t]) continue;
+			//nearest point of the tile to the center
+			double x0=tiles_origin_x+tx*tile_meters;
+			double y0=tiles_origin_y+ty*tile_meters;
+			double dx=center.x()<x0 ? x0-center.x() : (center.x()>x0+tile_meters ? center.x()-x0-tile_meters : 0.0);
+			double dy=center.y()<y0 ? y0-center.y() : (center.y()>y0+tile_meters ? center.y()-y0-tile_meters : 0.0);
+			if(dx*dx+dy*dy>radius_sq) continue;
+			msg.window_tiles.push_back(t);
+			if(full || !in_window[t]){
+				changed=true;
+				msg.new_tiles.push_back(t);
+				for(unsigned int i=tile_start[t];i<tile_start[t+1];i++){
+					msg.points.push_back(tile_points[i]);
+					msg.points.back().z=z;
+				}
+				msg.tile_ends.push_back(msg.points.size());
+			}
+		}
+	}
+	//fewer tiles carried over than were there last time: some have left
+	if(msg.window_tiles.size()-msg.new_tiles.size()<last_window.size()){
+		changed=true;
+	}
+	for(unsigned int i=0;i<last_window.size();i++) in_window[last_window[i]]=0;
+	for(unsigned int i=0;i<msg.window_tiles.size();i++) in_window[msg.window_tiles[i]]=1;
+	last_window=msg.window_tiles;
+	return changed;
+}
+
 int main(int argc, char *argv[]){
 	//boolean switch for if we have ever recieved a map
 	recieved_map=false;
@@ -94,10 +267,49 @@ int main(int argc, char *argv[]){
 	priv_nh_.param("channel_name",channel_name, std::string("intensity"));
 	priv_nh_.param("height",height, 1.9);
 	priv_nh_.param("target_frame", target_frame, std::string("base_link"));
+	//windowed: publish a PointCloud2 of only the obstacles within window_radius of the target frame, instead of the whole map every cycle.
+	//the default radius covers the local costmap's 12 x 12 m rolling window at any heading
+	double window_radius;
+	priv_nh_.param("windowed", windowed, false);
+	priv_nh_.param("window_radius", window_radius, 8.5);
+	priv_nh_.param("tile_size", tile_size, 2.0);
+	//delta: publish cwru_msgs/MapTiles on map_tiles instead, for cwru_nav's MapTileLayer; points go out once per tile entering
+	//the window. keepalive_interval bounds the time between messages when nothing changes
+	double keepalive_interval, full_refresh_interval;
+	priv_nh_.param("delta", delta, false);
+	priv_nh_.param("keepalive_interval", keepalive_interval, 1.0);
+	priv_nh_.param("full_refresh_interval", full_refresh_interval, 10.0);
+	map_id=0;
 
 	ros::Subscriber sub = n.subscribe("input_map", 1, &mapOccupancyGridCallback);
 
-	ros::Publisher cloud_pub = n.advertise<sensor_msgs::PointCloud>("map_cloud",1);
+	ros::Publisher cloud_pub;
+	if(delta){
+		cloud_pub = n.advertise<cwru_msgs::MapTiles>("map_tiles",1);
+	}else if(windowed){
+		cloud_pub = n.advertise<sensor_msgs::PointCloud2>("map_cloud",1);
+	}else{
+		cloud_pub = n.advertise<sensor_msgs::PointCloud>("map_cloud",1);
+	}
+
+	//x, y, z, intensity as float32
+	sensor_msgs::PointCloud2 window_cloud;
+	window_cloud.header.frame_id=target_frame;
+	window_cloud.height=1;
+	window_cloud.is_bigendian=false;
+	window_cloud.is_dense=true;
+	window_cloud.point_step=4*sizeof(float);
+	const char* field_names[4]={"x","y","z",channel_name.c_str()};
+	window_cloud.fields.resize(4);
+	for(int f=0;f<4;f++){
+		window_cloud.fields[f].name=field_names[f];
+		window_cloud.fields[f].offset=f*sizeof(float);
+		window_cloud.fields[f].datatype=sensor_msgs::PointField::FLOAT32;
+		window_cloud.fields[f].count=1;
+	}
+
+	cwru_msgs::MapTiles tiles_msg;
+	ros::Time last_tiles_time, last_full_time;
 
 	sensor_msgs::PointCloud * sensor_points=NULL;
 	//continuously publish the point cloud at a set rate
@@ -114,7 +326,39 @@ int main(int argc, char *argv[]){
 	sensor_msgs::PointCloud temp_out;
 
 	while(n.ok()){
-		if(recieved_map){
+		if(recieved_map && delta){
+			ros::Time latest_transform_time;
+			tf::StampedTransform target_in_map;
+			try{
+				listener.getLatestCommonTime(frame_id, target_frame, latest_transform_time, NULL);
+				listener.lookupTransform(frame_id, target_frame, latest_transform_time, target_in_map);
+				ros::Time now=ros::Time::now();
+				bool full=(now-last_full_time).toSec()>=full_refresh_interval;
+				bool changed=fillTileDelta(target_in_map(tf::Vector3(0,0,0)), window_radius, height, full, tiles_msg);
+				if(changed || (now-last_tiles_time).toSec()>=keepalive_interval){
+					tiles_msg.header.frame_id=frame_id;
+					tiles_msg.header.stamp=latest_transform_time;
+					cloud_pub.publish(tiles_msg);
+					last_tiles_time=now;
+					if(full) last_full_time=now;
+				}
+			}catch(tf::TransformException& ex){
+				ROS_WARN_THROTTLE(5.0, "map_as_sensor: %s", ex.what());
+			}
+		}else if(recieved_map && windowed){
+			ros::Time latest_transform_time;
+			tf::StampedTransform map_to_target;
+			try{
+				listener.getLatestCommonTime(frame_id, target_frame, latest_transform_time, NULL);
+				listener.lookupTransform(target_frame, frame_id, latest_transform_time, map_to_target);
+				fillWindowCloud(map_to_target, window_radius, height, intensity, window_cloud);
+				window_cloud.header.stamp=latest_transform_time;
+				//published by reference: serialized now, so the buffer is free to reuse next cycle
+				cloud_pub.publish(window_cloud);
+			}catch(tf::TransformException& ex){
+				ROS_WARN_THROTTLE(5.0, "map_as_sensor: %s", ex.what());
+			}
+		}else if(recieved_map){
 			if(updated_map){
 				updated_map=false;
 
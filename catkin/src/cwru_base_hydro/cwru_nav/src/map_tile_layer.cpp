@@ -0,0 +1,163 @@
+/*
+ * MapTileLayer: marks map_as_sensor's delta-mode map tiles in a costmap; see map_tile_layer.h.
+ */
+
+#include <algorithm>
+#include <pluginlib/class_list_macros.h>
+#include <costmap_2d/cost_values.h>
+#include <tf/transform_listener.h>
+#include "map_tile_layer.h"
+
+namespace cwru_nav
+{
+
+MapTileLayer::MapTileLayer() :
+  timeout_(5.0),
+  map_id_(0),
+  have_tiles_(false),
+  complete_(false),
+  last_seq_(0),
+  have_last_bounds_(false),
+  last_min_x_(0.0), last_min_y_(0.0), last_max_x_(0.0), last_max_y_(0.0)
+{
+}
+
+void MapTileLayer::onInitialize()
+{
+  ros::NodeHandle nh("~/" + name_);
+  std::string topic;
+  nh.param("topic", topic, std::string("map_tiles"));
+  nh.param("timeout", timeout_, 5.0);
+  nh.param("enabled", enabled_, true);
+  current_ = false;
+  ros::NodeHandle g_nh;
+  tiles_sub_ = g_nh.subscribe(topic, 10, &MapTileLayer::tilesCallback, this);
+}
+
+void MapTileLayer::tilesCallback(const cwru_msgs::MapTiles::ConstPtr& msg)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if (!have_tiles_ || msg->map_id != map_id_ || msg->header.frame_id != tiles_frame_) {
+    tiles_.clear();
+    complete_ = false;
+  }
+  if (msg->full) {
+    complete_ = true;
+  } else if (have_tiles_ && msg->header.seq != last_seq_ + 1 && complete_) {
+    // the tiles that came in with the missed message stay unmarked until the next full one
+    ROS_WARN("MapTileLayer: missed a map_tiles message; waiting for a full refresh");
+    complete_ = false;
+  }
+
+  // drop the tiles that have left the window (a few dozen listed, so a sorted copy is cheap)
+  std::vector<uint32_t> window(msg->window_tiles.begin(), msg->window_tiles.end());
+  std::sort(window.begin(), window.end());
+  std::map<unsigned int, std::vector<geometry_msgs::Point32> >::iterator it = tiles_.begin();
+  while (it != tiles_.end()) {
+    if (std::binary_search(window.begin(), window.end(), it->first)) {
+      ++it;
+    } else {
+      tiles_.erase(it++);
+    }
+  }
+
+  size_t start = 0;
+  for (size_t k = 0; k < msg->new_tiles.size() && k < msg->tile_ends.size(); k++) {
+    size_t end = std::min((size_t) msg->tile_ends[k], msg->points.size());
+    if (end < start) {
+      end = start;
+    }
+    tiles_[msg->new_tiles[k]].assign(msg->points.begin() + start, msg->points.begin() + end);
+    start = end;
+  }
+
+  tiles_frame_ = msg->header.frame_id;
+  map_id_ = msg->map_id;
+  last_seq_ = msg->header.seq;
+  last_msg_time_ = ros::Time::now();
+  have_tiles_ = true;
+}
+
+void MapTileLayer::updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x, double* min_y,
+                                double* max_x, double* max_y)
+{
+  if (!enabled_) {
+    return;
+  }
+  marked_xy_.clear();
+  double new_min_x = 1e30, new_min_y = 1e30, new_max_x = -1e30, new_max_y = -1e30;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    current_ = have_tiles_ && complete_ && (ros::Time::now() - last_msg_time_).toSec() < timeout_;
+    if (have_tiles_ && !tiles_.empty()) {
+      tf::StampedTransform transform;
+      try {
+        tf_->lookupTransform(layered_costmap_->getGlobalFrameID(), tiles_frame_, ros::Time(0), transform);
+      } catch (tf::TransformException& ex) {
+        ROS_WARN_THROTTLE(5.0, "MapTileLayer: %s", ex.what());
+        return;
+      }
+      std::map<unsigned int, std::vector<geometry_msgs::Point32> >::const_iterator it;
+      for (it = tiles_.begin(); it != tiles_.end(); ++it) {
+        const std::vector<geometry_msgs::Point32>& points = it->second;
+        for (size_t i = 0; i < points.size(); i++) {
+          tf::Vector3 p = transform(tf::Vector3(points[i].x, points[i].y, 0.0));
+          marked_xy_.push_back(p.x());
+          marked_xy_.push_back(p.y());
+          new_min_x = std::min(new_min_x, p.x());
+          new_min_y = std::min(new_min_y, p.y());
+          new_max_x = std::max(new_max_x, p.x());
+          new_max_y = std::max(new_max_y, p.y());
+        }
+      }
+    }
+  }
+
+  if (have_last_bounds_) {
+    *min_x = std::min(*min_x, last_min_x_);
+    *min_y = std::min(*min_y, last_min_y_);
+    *max_x = std::max(*max_x, last_max_x_);
+    *max_y = std::max(*max_y, last_max_y_);
+  }
+  have_last_bounds_ = !marked_xy_.empty();
+  if (have_last_bounds_) {
+    *min_x = std::min(*min_x, new_min_x);
+    *min_y = std::min(*min_y, new_min_y);
+    *max_x = std::max(*max_x, new_max_x);
+    *max_y = std::max(*max_y, new_max_y);
+    last_min_x_ = new_min_x;
+    last_min_y_ = new_min_y;
+    last_max_x_ = new_max_x;
+    last_max_y_ = new_max_y;
+  }
+}
+
+void MapTileLayer::updateCosts(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j)
+{
+  if (!enabled_) {
+    return;
+  }
+  unsigned int mx, my;
+  for (size_t i = 0; i + 1 < marked_xy_.size(); i += 2) {
+    if (!master_grid.worldToMap(marked_xy_[i], marked_xy_[i + 1], mx, my)) {
+      continue; // outside the rolling window
+    }
+    if ((int) mx < min_i || (int) mx >= max_i || (int) my < min_j || (int) my >= max_j) {
+      continue;
+    }
+    master_grid.setCost(mx, my, costmap_2d::LETHAL_OBSTACLE);
+  }
+}
+
+void MapTileLayer::reset()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  tiles_.clear();
+  have_tiles_ = false;
+  complete_ = false;
+  current_ = false;
+}
+
+}
+
+PLUGINLIB_EXPORT_CLASS(cwru_nav::MapTileLayer, costmap_2d::Layer)
@@ -0,0 +1,72 @@
+/*
+ * MapTileLayer: a costmap_2d layer that marks the static map obstacles map_as_sensor sends in delta mode
+ * (~delta, cwru_msgs/MapTiles on map_tiles), in place of an observation source on its whole-map point cloud.
+ * A tile's points arrive once, when it comes into the window, and are held (in the map frame) until a message
+ * no longer lists the tile. Each update they're transformed into the costmap frame and marked lethal: no
+ * observation buffer, no raytracing, and nothing on the wire while the robot stays among the same tiles.
+ *
+ * params (in the layer's namespace):
+ *   topic: default map_tiles
+ *   timeout: with no message (keepalive included) for this long, the layer reports not current (default 5 s)
+ *
+ * local_costmap:
+ *   plugins:
+ *     - {name: obstacle_layer, type: "costmap_2d::ObstacleLayer"}
+ *     - {name: map_tiles, type: "cwru_nav::MapTileLayer"}
+ *     - {name: inflation_layer, type: "costmap_2d::InflationLayer"}
+ */
+
+#ifndef CWRU_NAV_MAP_TILE_LAYER_H
+#define CWRU_NAV_MAP_TILE_LAYER_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <ros/ros.h>
+#include <costmap_2d/layer.h>
+#include <costmap_2d/layered_costmap.h>
+#include <cwru_msgs/MapTiles.h>
+#include <geometry_msgs/Point32.h>
+#include <boost/thread/mutex.hpp>
+
+namespace cwru_nav
+{
+
+class MapTileLayer : public costmap_2d::Layer
+{
+public:
+  MapTileLayer();
+  virtual ~MapTileLayer() {}
+
+  virtual void onInitialize();
+  virtual void updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x, double* min_y,
+                            double* max_x, double* max_y);
+  virtual void updateCosts(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j);
+  virtual void reset();
+
+private:
+  void tilesCallback(const cwru_msgs::MapTiles::ConstPtr& msg);
+
+  ros::Subscriber tiles_sub_;
+  double timeout_;
+
+  // written by the subscriber, read by the costmap update thread
+  boost::mutex mutex_;
+  std::map<unsigned int, std::vector<geometry_msgs::Point32> > tiles_;
+  std::string tiles_frame_;
+  unsigned int map_id_;
+  bool have_tiles_;
+  bool complete_; // every tile in the window is held: false after a missed message, until the next full one
+  uint32_t last_seq_;
+  ros::Time last_msg_time_;
+
+  // the held points in the costmap frame as of the last updateBounds, and the area they covered the time before,
+  // so cells of tiles that have since left are inside the bounds and get reset
+  std::vector<double> marked_xy_;
+  bool have_last_bounds_;
+  double last_min_x_, last_min_y_, last_max_x_, last_max_y_;
+};
+
+}
+
+#endif // CWRU_NAV_MAP_TILE_LAYER_H
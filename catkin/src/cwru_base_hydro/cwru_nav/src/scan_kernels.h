@@ -0,0 +1,75 @@
+/*
+ * scan_kernels.h: per-beam range kernels shared by the cwru_nav laser scan filters.
+ * Each one reads n ranges from in and writes n to out (in == out is fine). They don't branch per beam:
+ * with SSE2 (any x86-64) four beams go through a compare and a mask-select at a time; elsewhere the plain
+ * loop compiles to a conditional move. NaN ranges compare false everywhere, so they pass through unchanged.
+ */
+
+#ifndef CWRU_NAV_SCAN_KERNELS_H
+#define CWRU_NAV_SCAN_KERNELS_H
+
+#include <stddef.h>
+#include "sensor_msgs/LaserScan.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace laser_filters
+{
+
+// everything but the ranges and intensities; filters write those themselves, so a whole-message copy would
+// write every range twice
+inline void copyScanMetadata(const sensor_msgs::LaserScan& in, sensor_msgs::LaserScan& out)
+{
+  out.header = in.header;
+  out.angle_min = in.angle_min;
+  out.angle_max = in.angle_max;
+  out.angle_increment = in.angle_increment;
+  out.time_increment = in.time_increment;
+  out.scan_time = in.scan_time;
+  out.range_min = in.range_min;
+  out.range_max = in.range_max;
+}
+
+// r >= threshold ? replacement : r
+inline void replaceAtOrAbove(const float* in, float* out, size_t n, float threshold, float replacement)
+{
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128 t = _mm_set1_ps(threshold);
+  const __m128 v = _mm_set1_ps(replacement);
+  for (; i + 4 <= n; i += 4) {
+    __m128 r = _mm_loadu_ps(in + i);
+    __m128 mask = _mm_cmpge_ps(r, t);
+    _mm_storeu_ps(out + i, _mm_or_ps(_mm_and_ps(mask, v), _mm_andnot_ps(mask, r)));
+  }
+#endif
+  for (; i < n; i++) {
+    float r = in[i];
+    out[i] = (r >= threshold) ? replacement : r;
+  }
+}
+
+// r < lower || r > upper ? replacement : r
+inline void replaceOutside(const float* in, float* out, size_t n, float lower, float upper, float replacement)
+{
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128 lo = _mm_set1_ps(lower);
+  const __m128 hi = _mm_set1_ps(upper);
+  const __m128 v = _mm_set1_ps(replacement);
+  for (; i + 4 <= n; i += 4) {
+    __m128 r = _mm_loadu_ps(in + i);
+    __m128 mask = _mm_or_ps(_mm_cmplt_ps(r, lo), _mm_cmpgt_ps(r, hi));
+    _mm_storeu_ps(out + i, _mm_or_ps(_mm_and_ps(mask, v), _mm_andnot_ps(mask, r)));
+  }
+#endif
+  for (; i < n; i++) {
+    float r = in[i];
+    out[i] = (r < lower || r > upper) ? replacement : r;
+  }
+}
+
+}
+
+#endif // CWRU_NAV_SCAN_KERNELS_H
@@ -73,6 +73,7 @@
  
  #include "filters/filter_base.h"
  #include "sensor_msgs/LaserScan.h"
+ #include "scan_kernels.h"
  
  namespace laser_filters
  {
@@ -98,14 +99,16 @@
  
    bool update(const sensor_msgs::LaserScan& input_scan, sensor_msgs::LaserScan& filtered_scan)
    {
-//copy input scan to output scan
-     filtered_scan = input_scan ;
- // Need to check ever reading in the current scan
-     for (unsigned int i=0;i < input_scan.ranges.size();i++){
-//outside the range max?
-       if (filtered_scan.ranges[i] >= filtered_scan.range_max) {    
-         filtered_scan.ranges[i] = input_scan.range_max - alpha ;                         
-       }
+ // the chain reuses its buffers, so after the first scan none of this allocates; max-range readings become
+ // range_max - alpha in the same pass that copies the ranges (see scan_kernels.h)
+     if (&filtered_scan != &input_scan) {
+       copyScanMetadata(input_scan, filtered_scan);
+       filtered_scan.intensities = input_scan.intensities;
+       filtered_scan.ranges.resize(input_scan.ranges.size());
+     }
+     size_t n = input_scan.ranges.size();
+     if (n > 0) {
+       replaceAtOrAbove(&input_scan.ranges[0], &filtered_scan.ranges[0], n, input_scan.range_max, input_scan.range_max - alpha);
      }
      return true;
    }
@@ -0,0 +1,241 @@
+/*
+ * StaticWindowLayer: the static map painted straight into a costmap window; see static_window_layer.h.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <pluginlib/class_list_macros.h>
+#include <costmap_2d/cost_values.h>
+#include <tf/transform_listener.h>
+#include "static_window_layer.h"
+
+namespace cwru_nav
+{
+
+StaticWindowLayer::StaticWindowLayer() :
+  lethal_threshold_(100),
+  map_width_(0), map_height_(0),
+  map_resolution_(0.0), map_origin_x_(0.0), map_origin_y_(0.0),
+  have_map_(false),
+  repaint_all_(false),
+  have_dirty_(false),
+  dirty_min_x_(0), dirty_min_y_(0), dirty_max_x_(0), dirty_max_y_(0),
+  tf_x_(0.0), tf_y_(0.0), tf_yaw_(0.0),
+  painted_tf_x_(0.0), painted_tf_y_(0.0), painted_tf_yaw_(0.0),
+  painted_origin_x_(0.0), painted_origin_y_(0.0),
+  have_painted_(false)
+{
+}
+
+void StaticWindowLayer::onInitialize()
+{
+  ros::NodeHandle nh("~/" + name_);
+  std::string map_topic;
+  nh.param("map_topic", map_topic, std::string("map"));
+  nh.param("lethal_threshold", lethal_threshold_, 100);
+  nh.param("enabled", enabled_, true);
+  current_ = false;
+  ros::NodeHandle g_nh;
+  map_sub_ = g_nh.subscribe(map_topic, 1, &StaticWindowLayer::mapCallback, this);
+}
+
+void StaticWindowLayer::mapCallback(const nav_msgs::OccupancyGrid::ConstPtr& map)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  unsigned int width = map->info.width;
+  unsigned int height = map->info.height;
+  if (map->data.size() < (size_t) width * height) {
+    ROS_WARN("StaticWindowLayer: map has %u cells, expected %u x %u; ignoring it", (unsigned int) map->data.size(), width, height);
+    return;
+  }
+  bool same_geometry = have_map_ && width == map_width_ && height == map_height_ &&
+      map->info.resolution == map_resolution_ && map->info.origin.position.x == map_origin_x_ &&
+      map->info.origin.position.y == map_origin_y_ && map->header.frame_id == map_frame_;
+  if (!same_geometry) {
+    map_width_ = width;
+    map_height_ = height;
+    map_resolution_ = map->info.resolution;
+    map_origin_x_ = map->info.origin.position.x;
+    map_origin_y_ = map->info.origin.position.y;
+    map_frame_ = map->header.frame_id;
+    map_costs_.resize((size_t) width * height);
+    repaint_all_ = true;
+  }
+
+  // convert, and for the same map geometry note the rectangle that changed
+  const int8_t* data = &map->data[0];
+  unsigned char* costs = &map_costs_[0];
+  for (unsigned int y = 0; y < height; y++) {
+    bool row_changed = false;
+    unsigned int row_min_x = 0, row_max_x = 0;
+    for (unsigned int x = 0; x < width; x++) {
+      size_t i = (size_t) y * width + x;
+      unsigned char cost = (data[i] >= lethal_threshold_) ? costmap_2d::LETHAL_OBSTACLE : costmap_2d::FREE_SPACE;
+      if (same_geometry && costs[i] != cost) {
+        if (!row_changed) {
+          row_min_x = x;
+          row_changed = true;
+        }
+        row_max_x = x;
+      }
+      costs[i] = cost;
+    }
+    if (row_changed) {
+      if (!have_dirty_) {
+        dirty_min_x_ = row_min_x;
+        dirty_max_x_ = row_max_x;
+        dirty_min_y_ = dirty_max_y_ = y;
+        have_dirty_ = true;
+      } else {
+        dirty_min_x_ = std::min(dirty_min_x_, row_min_x);
+        dirty_max_x_ = std::max(dirty_max_x_, row_max_x);
+        dirty_min_y_ = std::min(dirty_min_y_, y);
+        dirty_max_y_ = std::max(dirty_max_y_, y);
+      }
+    }
+  }
+  have_map_ = true;
+}
+
+// a map-frame rectangle, as the costmap-frame box around its corners
+void StaticWindowLayer::expandBounds(double mx_min, double my_min, double mx_max, double my_max, double* min_x,
+                                     double* min_y, double* max_x, double* max_y)
+{
+  double c = cos(tf_yaw_), s = sin(tf_yaw_);
+  double xs[2] = {mx_min, mx_max};
+  double ys[2] = {my_min, my_max};
+  for (int a = 0; a < 2; a++) {
+    for (int b = 0; b < 2; b++) {
+      double wx = c * xs[a] - s * ys[b] + tf_x_;
+      double wy = s * xs[a] + c * ys[b] + tf_y_;
+      *min_x = std::min(*min_x, wx);
+      *min_y = std::min(*min_y, wy);
+      *max_x = std::max(*max_x, wx);
+      *max_y = std::max(*max_y, wy);
+    }
+  }
+}
+
+void StaticWindowLayer::updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x, double* min_y,
+                                     double* max_x, double* max_y)
+{
+  if (!enabled_) {
+    return;
+  }
+  boost::mutex::scoped_lock lock(mutex_);
+  if (!have_map_) {
+    return;
+  }
+  tf::StampedTransform transform;
+  try {
+    tf_->lookupTransform(layered_costmap_->getGlobalFrameID(), map_frame_, ros::Time(0), transform);
+  } catch (tf::TransformException& ex) {
+    ROS_WARN_THROTTLE(5.0, "StaticWindowLayer: %s", ex.what());
+    current_ = false;
+    return;
+  }
+  current_ = true;
+  tf_x_ = transform.getOrigin().x();
+  tf_y_ = transform.getOrigin().y();
+  tf_yaw_ = tf::getYaw(transform.getRotation());
+
+  // the window moves with the robot, and localization moves the map under it: either way, every cell may be stale
+  costmap_2d::Costmap2D* master = layered_costmap_->getCostmap();
+  double resolution = master->getResolution();
+  double window_size = std::max(master->getSizeInCellsX(), master->getSizeInCellsY()) * resolution;
+  bool moved = !have_painted_ || master->getOriginX() != painted_origin_x_ || master->getOriginY() != painted_origin_y_ ||
+      fabs(tf_x_ - painted_tf_x_) > 0.25 * resolution || fabs(tf_y_ - painted_tf_y_) > 0.25 * resolution ||
+      fabs(tf_yaw_ - painted_tf_yaw_) * window_size > 0.25 * resolution;
+  if (moved || repaint_all_) {
+    *min_x = std::min(*min_x, master->getOriginX());
+    *min_y = std::min(*min_y, master->getOriginY());
+    *max_x = std::max(*max_x, master->getOriginX() + master->getSizeInCellsX() * resolution);
+    *max_y = std::max(*max_y, master->getOriginY() + master->getSizeInCellsY() * resolution);
+    painted_origin_x_ = master->getOriginX();
+    painted_origin_y_ = master->getOriginY();
+    painted_tf_x_ = tf_x_;
+    painted_tf_y_ = tf_y_;
+    painted_tf_yaw_ = tf_yaw_;
+    have_painted_ = true;
+    repaint_all_ = false;
+    have_dirty_ = false;
+  } else if (have_dirty_) {
+    // paint with the transform the rest of the window was painted with, so unchanged cells don't shift
+    tf_x_ = painted_tf_x_;
+    tf_y_ = painted_tf_y_;
+    tf_yaw_ = painted_tf_yaw_;
+    expandBounds(map_origin_x_ + dirty_min_x_ * map_resolution_, map_origin_y_ + dirty_min_y_ * map_resolution_,
+                 map_origin_x_ + (dirty_max_x_ + 1) * map_resolution_, map_origin_y_ + (dirty_max_y_ + 1) * map_resolution_,
+                 min_x, min_y, max_x, max_y);
+    have_dirty_ = false;
+  } else {
+    tf_x_ = painted_tf_x_;
+    tf_y_ = painted_tf_y_;
+    tf_yaw_ = painted_tf_yaw_;
+  }
+}
+
+void StaticWindowLayer::updateCosts(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j)
+{
+  if (!enabled_) {
+    return;
+  }
+  boost::mutex::scoped_lock lock(mutex_);
+  if (!have_map_ || !have_painted_ || min_i >= max_i || min_j >= max_j) {
+    return;
+  }
+  unsigned char* master = master_grid.getCharMap();
+  double resolution = master_grid.getResolution();
+  // costmap cell (i, j)'s center, in the map frame: p_map = R(-yaw) (p_costmap - t)
+  double c = cos(tf_yaw_), s = sin(tf_yaw_);
+  double x0 = master_grid.getOriginX() + (min_i + 0.5) * resolution - tf_x_;
+  double y0 = master_grid.getOriginY() + (min_j + 0.5) * resolution - tf_y_;
+  double window_size = std::max(master_grid.getSizeInCellsX(), master_grid.getSizeInCellsY()) * resolution;
+  // rows start exactly; within a row, ignoring the rotation is off by at most yaw * window size
+  bool aligned = fabs(resolution - map_resolution_) < 1e-6 && fabs(tf_yaw_) * window_size < 0.5 * resolution;
+
+  for (int j = min_j; j < max_j; j++) {
+    double wx = x0;
+    double wy = y0 + (j - min_j) * resolution;
+    unsigned char* dst = master + master_grid.getIndex(min_i, j);
+    double mx = c * wx + s * wy - map_origin_x_;
+    double my = -s * wx + c * wy - map_origin_y_;
+    if (aligned) {
+      // the row lines up with a map row: one range of it, no per-cell arithmetic
+      int row = (int) floor(my / map_resolution_);
+      if (row < 0 || row >= (int) map_height_) {
+        continue;
+      }
+      int col = (int) floor(mx / map_resolution_);
+      int first = std::max(0, -col);
+      int last = std::min(max_i - min_i, (int) map_width_ - col);
+      const unsigned char* src = &map_costs_[(size_t) row * map_width_];
+      for (int i = first; i < last; i++) {
+        // costs are 0 or lethal, so this is max() that also paints over unknown
+        dst[i] = src[col + i] ? src[col + i] : dst[i];
+      }
+    } else {
+      double step_x = c * resolution, step_y = -s * resolution;
+      for (int i = 0; i < max_i - min_i; i++, mx += step_x, my += step_y) {
+        int col = (int) floor(mx / map_resolution_);
+        int row = (int) floor(my / map_resolution_);
+        if (col < 0 || row < 0 || col >= (int) map_width_ || row >= (int) map_height_) {
+          continue;
+        }
+        unsigned char cost = map_costs_[(size_t) row * map_width_ + col];
+        dst[i] = cost ? cost : dst[i];
+      }
+    }
+  }
+}
+
+void StaticWindowLayer::reset()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  have_painted_ = false;
+  repaint_all_ = true;
+}
+
+}
+
+PLUGINLIB_EXPORT_CLASS(cwru_nav::StaticWindowLayer, costmap_2d::Layer)
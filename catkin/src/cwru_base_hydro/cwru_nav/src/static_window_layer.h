@@ -0,0 +1,78 @@
+/*
+ * StaticWindowLayer: a costmap_2d layer that paints the static map's obstacles straight into a (rolling) costmap
+ * from the OccupancyGrid, so the local costmap no longer needs map_as_sensor's point cloud, its TF hop, or an
+ * observation buffer and raytracing to see the walls.
+ * The map is converted to costs once (cells at or above lethal_threshold are lethal, everything else free). Each
+ * update copies the part of it under the costmap window: a lethal-select over whole rows when the map and the
+ * costmap frame line up (same resolution, rotation under half a cell across the window), otherwise a nearest-cell
+ * lookup per costmap cell.
+ * The window is only repainted when the costmap moved or map -> costmap frame changed. A new map with the same
+ * size, resolution and origin (e.g. a map_server restart with an edited map) is diffed against the old one, and
+ * only the rectangle around the changed cells is repainted.
+ *
+ * params (in the layer's namespace):
+ *   map_topic: default map
+ *   lethal_threshold: occupancy (0-100) from which a cell is an obstacle (default 100, as map_as_sensor)
+ *
+ * local_costmap:
+ *   plugins:
+ *     - {name: static_window, type: "cwru_nav::StaticWindowLayer"}
+ *     - {name: obstacle_layer, type: "costmap_2d::ObstacleLayer"}
+ *     - {name: inflation_layer, type: "costmap_2d::InflationLayer"}
+ */
+
+#ifndef CWRU_NAV_STATIC_WINDOW_LAYER_H
+#define CWRU_NAV_STATIC_WINDOW_LAYER_H
+
+#include <string>
+#include <vector>
+#include <ros/ros.h>
+#include <costmap_2d/layer.h>
+#include <costmap_2d/layered_costmap.h>
+#include <nav_msgs/OccupancyGrid.h>
+#include <boost/thread/mutex.hpp>
+
+namespace cwru_nav
+{
+
+class StaticWindowLayer : public costmap_2d::Layer
+{
+public:
+  StaticWindowLayer();
+  virtual ~StaticWindowLayer() {}
+
+  virtual void onInitialize();
+  virtual void updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x, double* min_y,
+                            double* max_x, double* max_y);
+  virtual void updateCosts(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j);
+  virtual void reset();
+
+private:
+  void mapCallback(const nav_msgs::OccupancyGrid::ConstPtr& map);
+  void expandBounds(double mx_min, double my_min, double mx_max, double my_max, double* min_x, double* min_y,
+                    double* max_x, double* max_y);
+
+  ros::Subscriber map_sub_;
+  int lethal_threshold_;
+
+  // written by the map subscriber, read by the costmap update thread
+  boost::mutex mutex_;
+  std::vector<unsigned char> map_costs_; // row-major, LETHAL_OBSTACLE or FREE_SPACE
+  unsigned int map_width_, map_height_;
+  double map_resolution_, map_origin_x_, map_origin_y_;
+  std::string map_frame_;
+  bool have_map_;
+  bool repaint_all_;
+  bool have_dirty_; // map cells [dirty_min_x_, dirty_max_x_] x [dirty_min_y_, dirty_max_y_] changed
+  unsigned int dirty_min_x_, dirty_min_y_, dirty_max_x_, dirty_max_y_;
+
+  // map frame -> costmap frame (p_costmap = R(yaw) p_map + t) and costmap origin as of the last updateBounds
+  double tf_x_, tf_y_, tf_yaw_;
+  double painted_tf_x_, painted_tf_y_, painted_tf_yaw_;
+  double painted_origin_x_, painted_origin_y_;
+  bool have_painted_;
+};
+
+}
+
+#endif // CWRU_NAV_STATIC_WINDOW_LAYER_H
@@ -0,0 +1,95 @@
+/*
+ * LaserScanTemporalClearingFilter: like LaserScanSonarFilter, max-range readings become clearing rays
+ * (range_max - alpha), but only once a beam has read max range for clear_after_scans scans in a row.
+ * Until then they're pushed past range_max, so the costmap neither clears nor marks along them: a single
+ * dropped echo no longer wipes out an obstacle that the next scan puts back.
+ *
+ * Each beam keeps its last 32 max-range yes/no results as bits (newest in bit 0), so a scan updates a beam
+ * with a shift and a mask test. The history is resized and cleared when the beam count or angles change;
+ * otherwise nothing allocates after the first scan.
+ *
+ * params:
+ *   alpha: clearing rays end this far short of range_max (default 0.02)
+ *   clear_after_scans: consecutive max-range scans before a beam clears, 1..32 (default 3; 1 acts like
+ *     LaserScanSonarFilter)
+ */
+
+#ifndef LASER_SCAN_TEMPORAL_CLEARING_FILTER_H
+#define LASER_SCAN_TEMPORAL_CLEARING_FILTER_H
+
+#include <stdint.h>
+#include <vector>
+#include "filters/filter_base.h"
+#include "sensor_msgs/LaserScan.h"
+#include "scan_kernels.h"
+
+namespace laser_filters
+{
+
+class LaserScanTemporalClearingFilter : public filters::FilterBase<sensor_msgs::LaserScan>
+{
+public:
+  static const int MAX_HISTORY = 32; // bits per beam
+
+  bool configure()
+  {
+    alpha_ = 0.02;
+    int clear_after_scans = 3;
+    getParam("alpha", alpha_);
+    getParam("clear_after_scans", clear_after_scans);
+    if (clear_after_scans < 1 || clear_after_scans > MAX_HISTORY) {
+      ROS_ERROR("LaserScanTemporalClearingFilter: clear_after_scans must be 1..%d", MAX_HISTORY);
+      return false;
+    }
+    clear_mask_ = (clear_after_scans == MAX_HISTORY) ? 0xffffffffu : ((1u << clear_after_scans) - 1);
+    history_.clear();
+    angle_min_ = angle_increment_ = 0.0;
+    return true;
+  }
+
+  virtual ~LaserScanTemporalClearingFilter()
+  {
+  }
+
+  bool update(const sensor_msgs::LaserScan& input_scan, sensor_msgs::LaserScan& filtered_scan)
+  {
+    size_t n = input_scan.ranges.size();
+    if (n != history_.size() || input_scan.angle_min != angle_min_ || input_scan.angle_increment != angle_increment_) {
+      // a different scanner setup: old history doesn't line up with these beams
+      if (!history_.empty()) {
+        ROS_INFO("LaserScanTemporalClearingFilter: scan changed to %u beams; resetting beam history", (unsigned int) n);
+      }
+      history_.assign(n, 0);
+      angle_min_ = input_scan.angle_min;
+      angle_increment_ = input_scan.angle_increment;
+    }
+    if (&filtered_scan != &input_scan) {
+      copyScanMetadata(input_scan, filtered_scan);
+      filtered_scan.intensities = input_scan.intensities;
+      filtered_scan.ranges.resize(n);
+    }
+    const float range_max = input_scan.range_max;
+    const float clear_range = range_max - alpha_;
+    const float no_return = range_max + 1.0;
+    for (size_t i = 0; i < n; i++) {
+      float r = input_scan.ranges[i];
+      uint32_t at_max = (r >= range_max);
+      uint32_t history = (history_[i] << 1) | at_max;
+      history_[i] = history;
+      float max_range_out = ((history & clear_mask_) == clear_mask_) ? clear_range : no_return;
+      filtered_scan.ranges[i] = at_max ? max_range_out : r;
+    }
+    return true;
+  }
+
+private:
+  double alpha_;
+  uint32_t clear_mask_;
+  std::vector<uint32_t> history_;
+  float angle_min_;
+  float angle_increment_;
+};
+
+}
+
+#endif // LASER_SCAN_TEMPORAL_CLEARING_FILTER_H
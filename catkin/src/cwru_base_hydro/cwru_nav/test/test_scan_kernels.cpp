@@ -0,0 +1,190 @@
+// checks the per-beam range kernels (src/scan_kernels.h): the SSE2 path gives the same bits as the plain scalar
+// loop for every length that exercises the 4-wide loop and the tail, with NaN and +-inf ranges, in place and not;
+// and LaserScanFusedFilter with stages [sonar_clear] gives the same scans as LaserScanSonarFilter
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits>
+#include <vector>
+#include <gtest/gtest.h>
+#include "../src/sonar_clearing_filter.h"
+#include "../src/fused_scan_filter.h"
+
+using namespace laser_filters;
+
+typedef filters::FilterBase<sensor_msgs::LaserScan> ScanFilter;
+
+static const size_t MAX_N = 9; // two SSE2 blocks and a tail of 1
+static const float GUARD = -12345.0f;
+
+// the kernels as they were written before scan_kernels.h, as the reference
+void referenceAtOrAbove(const float* in, float* out, size_t n, float threshold, float replacement) {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = (in[i] >= threshold) ? replacement : in[i];
+  }
+}
+
+void referenceOutside(const float* in, float* out, size_t n, float lower, float upper, float replacement) {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = (in[i] < lower || in[i] > upper) ? replacement : in[i];
+  }
+}
+
+// bitwise, so a NaN has to come out as the same NaN
+::testing::AssertionResult sameBits(const float* expected, const float* actual, size_t n) {
+  if (memcmp(expected, actual, n * sizeof(float)) == 0) {
+    return ::testing::AssertionSuccess();
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (memcmp(expected + i, actual + i, sizeof(float)) != 0) {
+      return ::testing::AssertionFailure() << "beam " << i << " of " << n << ": expected " << expected[i]
+                                           << ", got " << actual[i];
+    }
+  }
+  return ::testing::AssertionFailure();
+}
+
+// ranges around a 4 m limit with the special values in every lane position
+std::vector<float> testRanges(unsigned int seed) {
+  const float special[] = {
+    std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::infinity(),
+    -std::numeric_limits<float>::infinity(), 4.0f, 0.1f, 0.0f, -0.0f, 3.9999998f, 4.0000005f
+  };
+  const size_t n_special = sizeof(special) / sizeof(special[0]);
+  srand(seed);
+  std::vector<float> ranges(MAX_N);
+  for (size_t i = 0; i < MAX_N; i++) {
+    ranges[i] = (rand() % 2) ? special[rand() % n_special] : (rand() % 1000) / 100.0f;
+  }
+  return ranges;
+}
+
+class ScanKernelTest : public ::testing::TestWithParam<unsigned int> {
+};
+
+TEST_P(ScanKernelTest, ReplaceAtOrAboveMatchesScalar) {
+  std::vector<float> ranges = testRanges(GetParam());
+  for (size_t n = 0; n <= MAX_N; n++) {
+    std::vector<float> expected(MAX_N + 1, GUARD), actual(MAX_N + 1, GUARD);
+    referenceAtOrAbove(&ranges[0], &expected[0], n, 4.0f, 3.98f);
+    replaceAtOrAbove(&ranges[0], &actual[0], n, 4.0f, 3.98f);
+    EXPECT_TRUE(sameBits(&expected[0], &actual[0], MAX_N + 1)) << "n = " << n; // nothing past n written
+
+    std::vector<float> in_place(ranges);
+    replaceAtOrAbove(&in_place[0], &in_place[0], n, 4.0f, 3.98f);
+    EXPECT_TRUE(sameBits(&expected[0], &in_place[0], n)) << "in place, n = " << n;
+    EXPECT_TRUE(sameBits(&ranges[n], &in_place[n], MAX_N - n)) << "in place, n = " << n;
+  }
+}
+
+TEST_P(ScanKernelTest, ReplaceOutsideMatchesScalar) {
+  std::vector<float> ranges = testRanges(GetParam());
+  for (size_t n = 0; n <= MAX_N; n++) {
+    std::vector<float> expected(MAX_N + 1, GUARD), actual(MAX_N + 1, GUARD);
+    referenceOutside(&ranges[0], &expected[0], n, 0.1f, 4.0f, 5.0f);
+    replaceOutside(&ranges[0], &actual[0], n, 0.1f, 4.0f, 5.0f);
+    EXPECT_TRUE(sameBits(&expected[0], &actual[0], MAX_N + 1)) << "n = " << n;
+
+    std::vector<float> in_place(ranges);
+    replaceOutside(&in_place[0], &in_place[0], n, 0.1f, 4.0f, 5.0f);
+    EXPECT_TRUE(sameBits(&expected[0], &in_place[0], n)) << "in place, n = " << n;
+    EXPECT_TRUE(sameBits(&ranges[n], &in_place[n], MAX_N - n)) << "in place, n = " << n;
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(RandomRanges, ScanKernelTest, ::testing::Range(0u, 50u));
+
+TEST(ScanKernels, UnalignedBuffers) {
+  // the scan's vector is only float-aligned, so neither pointer may be assumed 16-byte aligned
+  std::vector<float> ranges = testRanges(7);
+  std::vector<float> in(MAX_N + 3), expected(MAX_N), actual(MAX_N + 3);
+  for (size_t offset = 0; offset < 3; offset++) {
+    memcpy(&in[offset], &ranges[0], MAX_N * sizeof(float));
+    referenceAtOrAbove(&ranges[0], &expected[0], MAX_N, 4.0f, 3.98f);
+    replaceAtOrAbove(&in[offset], &actual[2 - offset], MAX_N, 4.0f, 3.98f);
+    EXPECT_TRUE(sameBits(&expected[0], &actual[2 - offset], MAX_N)) << "offset " << offset;
+    referenceOutside(&ranges[0], &expected[0], MAX_N, 0.1f, 4.0f, 5.0f);
+    replaceOutside(&in[offset], &actual[2 - offset], MAX_N, 0.1f, 4.0f, 5.0f);
+    EXPECT_TRUE(sameBits(&expected[0], &actual[2 - offset], MAX_N)) << "offset " << offset;
+  }
+}
+
+// the filter chain configures filters from the yaml as name/type/params; this does the same without a node
+bool configureFilter(ScanFilter& filter, const std::string& type, double alpha, const char* stage) {
+  XmlRpc::XmlRpcValue config;
+  config["name"] = std::string("under_test");
+  config["type"] = type;
+  config["params"]["alpha"] = alpha;
+  if (stage) {
+    config["params"]["stages"][0] = std::string(stage);
+  }
+  return filter.configure(config);
+}
+
+sensor_msgs::LaserScan testScan(size_t n, unsigned int seed) {
+  sensor_msgs::LaserScan scan;
+  scan.header.frame_id = "base_laser1_link";
+  scan.angle_min = -2.35619f;
+  scan.angle_max = 2.35619f;
+  scan.angle_increment = 0.00436f;
+  scan.range_min = 0.02f;
+  scan.range_max = 30.0f;
+  scan.ranges.resize(n);
+  scan.intensities.resize(n);
+  srand(seed);
+  for (size_t i = 0; i < n; i++) {
+    switch (rand() % 6) {
+      case 0: scan.ranges[i] = scan.range_max; break;
+      case 1: scan.ranges[i] = std::numeric_limits<float>::quiet_NaN(); break;
+      case 2: scan.ranges[i] = std::numeric_limits<float>::infinity(); break;
+      default: scan.ranges[i] = (rand() % 3200) / 100.0f; break;
+    }
+    scan.intensities[i] = (float) (rand() % 256);
+  }
+  return scan;
+}
+
+TEST(FusedScanFilter, SonarClearMatchesSonarFilter) {
+  LaserScanSonarFilter sonar;
+  LaserScanFusedFilter fused;
+  ASSERT_TRUE(configureFilter(sonar, "cwru_nav/LaserScanSonarFilter", 0.05, NULL));
+  ASSERT_TRUE(configureFilter(fused, "cwru_nav/LaserScanFusedFilter", 0.05, "sonar_clear"));
+
+  // lengths around the SSE2 block and the fused filter's chunk, and a full Hokuyo scan
+  const size_t lengths[] = {0, 1, 3, 4, 5, 9, 255, 256, 257, 1081};
+  for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+    sensor_msgs::LaserScan scan = testScan(lengths[l], l);
+    sensor_msgs::LaserScan from_sonar, from_fused;
+    ASSERT_TRUE(sonar.update(scan, from_sonar));
+    ASSERT_TRUE(fused.update(scan, from_fused));
+    ASSERT_EQ(scan.ranges.size(), from_fused.ranges.size());
+    if (!scan.ranges.empty()) {
+      EXPECT_TRUE(sameBits(&from_sonar.ranges[0], &from_fused.ranges[0], scan.ranges.size()))
+          << lengths[l] << " beams";
+    }
+    EXPECT_EQ(from_sonar.intensities, from_fused.intensities);
+    EXPECT_EQ(from_sonar.header.frame_id, from_fused.header.frame_id);
+    EXPECT_EQ(from_sonar.range_max, from_fused.range_max);
+    EXPECT_EQ(from_sonar.angle_increment, from_fused.angle_increment);
+
+    // update() also takes the same scan as input and output
+    sensor_msgs::LaserScan in_place = scan;
+    ASSERT_TRUE(fused.update(in_place, in_place));
+    if (!scan.ranges.empty()) {
+      EXPECT_TRUE(sameBits(&from_sonar.ranges[0], &in_place.ranges[0], scan.ranges.size()))
+          << "in place, " << lengths[l] << " beams";
+    }
+  }
+}
+
+TEST(FusedScanFilter, RejectsUnknownStage) {
+  LaserScanFusedFilter fused;
+  EXPECT_FALSE(configureFilter(fused, "cwru_nav/LaserScanFusedFilter", 0.05, "median"));
+  EXPECT_FALSE(configureFilter(fused, "cwru_nav/LaserScanFusedFilter", 0.05, NULL));
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}